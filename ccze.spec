@@ -41,9 +41,15 @@ rm -rf %{buildroot}
 %config %{_sysconfdir}/cczerc
 %{_bindir}/ccze
 %{_bindir}/ccze-cssdump
+%{_bindir}/ccze-render
+%{_bindir}/cczed
 %{_includedir}/ccze.h
+%{_includedir}/libccze.h
+%{_libdir}/libccze.so
 %{_mandir}/man1/ccze.1*
 %{_mandir}/man1/ccze-cssdump.1*
+%{_mandir}/man1/ccze-render.1*
+%{_mandir}/man1/cczed.1*
 %{_mandir}/man7/ccze-plugin.7*
 
 %changelog
@@ -0,0 +1,270 @@
+/* -*- mode: c; c-file-style: "gnu" -*-
+ * ccze-collapse.c -- Collapsing of repeated, near-identical lines
+ * Copyright (C) 2003 Gergely Nagy <algernon@bonehunter.rulez.org>
+ *
+ * This file is part of ccze.
+ *
+ * ccze is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ccze is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include <ccze.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ccze-private.h"
+
+/* One recently seen line. The first occurrence is output as usual;
+   further ones only bump COUNT, and the last of them is kept in TEXT
+   and RUNS, to be output with the counter when the entry expires.
+   KEY is what lines are compared by, HASH is its hash. */
+typedef struct
+{
+  unsigned long hash;
+  char *key;
+  size_t keylen, key_alloc;
+  unsigned long count;
+  time_t first;
+  unsigned long used;
+  char *text;
+  size_t len, text_alloc;
+  ccze_run_t *runs;
+  size_t nruns, runs_alloc;
+} ccze_collapse_entry_t;
+
+static ccze_collapse_entry_t *window;
+static size_t window_size, window_len;
+static time_t window_time;
+static unsigned long window_clock;
+static char *key;
+static size_t key_alloc;
+
+void
+ccze_collapse_init (size_t lines, int seconds)
+{
+  window_size = lines;
+  window_time = seconds;
+  window_len = 0;
+  window = (ccze_collapse_entry_t *)ccze_calloc
+    (lines, sizeof (ccze_collapse_entry_t));
+}
+
+/* Make the key of LINE into KEY, and return its length: the line with
+   the parts that usually differ between the lines of a flood -
+   numbers, addresses, dates and PIDs - masked out. The classifier
+   already found these, they are runs of their own color, and are
+   replaced by a NUL and the color, which no line has in it. */
+static size_t
+_ccze_collapse_key (const ccze_line_t *line)
+{
+  size_t i, len = 0, off = 0;
+
+  if (line->len + 2 * line->nruns > key_alloc)
+    {
+      key_alloc = line->len + 2 * line->nruns;
+      key = (char *)ccze_realloc (key, key_alloc);
+    }
+  for (i = 0; i < line->nruns; i++)
+    {
+      const ccze_run_t *r = &line->runs[i];
+
+      switch (r->color)
+	{
+	case CCZE_COLOR_NUMBERS:
+	case CCZE_COLOR_ADDRESS:
+	case CCZE_COLOR_DATE:
+	case CCZE_COLOR_PID:
+	  key[len++] = '\0';
+	  key[len++] = (char)r->color;
+	  break;
+	default:
+	  memcpy (key + len, line->text + off, r->len);
+	  len += r->len;
+	  break;
+	}
+      off += r->len;
+    }
+  return len;
+}
+
+static unsigned long
+_ccze_collapse_hash (size_t len)
+{
+  unsigned long h = 2166136261UL;
+  size_t i;
+
+  for (i = 0; i < len; i++)
+    h = (h ^ (unsigned char)key[i]) * 16777619UL;
+  return h;
+}
+
+static void
+_ccze_collapse_emit (ccze_collapse_entry_t *e)
+{
+  char counter[64];
+  size_t clen;
+
+  if (!e->count)
+    return;
+
+  clen = snprintf (counter, sizeof (counter), " [repeated %lu times]",
+		   e->count);
+  if (e->len + clen > e->text_alloc)
+    {
+      e->text_alloc = e->len + clen;
+      e->text = (char *)ccze_realloc (e->text, e->text_alloc);
+    }
+  if (e->nruns + 1 > e->runs_alloc)
+    {
+      e->runs_alloc = e->nruns + 1;
+      e->runs = (ccze_run_t *)ccze_realloc
+	(e->runs, e->runs_alloc * sizeof (ccze_run_t));
+    }
+  memcpy (e->text + e->len, counter, clen);
+  e->runs[e->nruns].color = CCZE_COLOR_REPEAT;
+  e->runs[e->nruns].flags = 0;
+  e->runs[e->nruns].len = (unsigned short)clen;
+
+  ccze_line_write (e->text, e->len + clen, e->runs, e->nruns + 1);
+  e->count = 0;
+}
+
+/* Output the counters of the entries whose time is up, or of all of
+   them if ALL is set. */
+void
+ccze_collapse_expire (int all)
+{
+  time_t now = time (NULL);
+  size_t i;
+
+  for (i = 0; i < window_len; i++)
+    if (window[i].count &&
+	(all || now - window[i].first >= window_time))
+      _ccze_collapse_emit (&window[i]);
+}
+
+/* Milliseconds until the next counter is due, -1 if none is. */
+int
+ccze_collapse_timeout (void)
+{
+  time_t now = time (NULL), due = 0;
+  size_t i;
+
+  for (i = 0; i < window_len; i++)
+    if (window[i].count &&
+	(!due || window[i].first + window_time < due))
+      due = window[i].first + window_time;
+
+  if (!due)
+    return -1;
+  return (due > now) ? (int)(due - now) * 1000 : 0;
+}
+
+static void
+_ccze_collapse_keep (ccze_collapse_entry_t *e, const ccze_line_t *line)
+{
+  if (line->len > e->text_alloc)
+    {
+      e->text_alloc = line->len;
+      e->text = (char *)ccze_realloc (e->text, e->text_alloc);
+    }
+  if (line->nruns > e->runs_alloc)
+    {
+      e->runs_alloc = line->nruns;
+      e->runs = (ccze_run_t *)ccze_realloc
+	(e->runs, e->runs_alloc * sizeof (ccze_run_t));
+    }
+  /* An empty line has nothing to copy, nor anywhere to copy it to. */
+  if (line->len)
+    memcpy (e->text, line->text, line->len);
+  if (line->nruns)
+    memcpy (e->runs, line->runs, line->nruns * sizeof (ccze_run_t));
+  e->len = line->len;
+  e->nruns = line->nruns;
+}
+
+/* See if LINE repeats one in the window. Returns non-zero if it does,
+   and so should not be output. */
+int
+ccze_collapse_line (const ccze_line_t *line)
+{
+  unsigned long h;
+  size_t i, len, lru = 0;
+  ccze_collapse_entry_t *e;
+
+  ccze_collapse_expire (0);
+
+  len = _ccze_collapse_key (line);
+  h = _ccze_collapse_hash (len);
+  window_clock++;
+  for (i = 0; i < window_len; i++)
+    {
+      if (window[i].hash == h && window[i].keylen == len &&
+	  (!len || !memcmp (window[i].key, key, len)))
+	{
+	  e = &window[i];
+	  if (!e->count)
+	    e->first = time (NULL);
+	  e->count++;
+	  e->used = window_clock;
+	  _ccze_collapse_keep (e, line);
+	  return 1;
+	}
+      if (window[i].used < window[lru].used)
+	lru = i;
+    }
+
+  /* A new line: it takes the place of the one not seen for the
+     longest time, whose counter is output first. */
+  if (window_len < window_size)
+    e = &window[window_len++];
+  else
+    {
+      e = &window[lru];
+      _ccze_collapse_emit (e);
+    }
+  if (len > e->key_alloc)
+    {
+      e->key_alloc = len;
+      e->key = (char *)ccze_realloc (e->key, e->key_alloc);
+    }
+  if (len)
+    memcpy (e->key, key, len);
+  e->keylen = len;
+  e->hash = h;
+  e->count = 0;
+  e->used = window_clock;
+  return 0;
+}
+
+void
+ccze_collapse_shutdown (void)
+{
+  size_t i;
+
+  for (i = 0; i < window_len; i++)
+    {
+      free (window[i].text);
+      free (window[i].runs);
+      free (window[i].key);
+    }
+  free (window);
+  free (key);
+  window = NULL;
+  key = NULL;
+  key_alloc = 0;
+  window_len = window_size = 0;
+}
@@ -66,6 +66,30 @@
 
 static int ccze_color_table [CCZE_COLOR_LAST + 1];
 
+/* Colors past the eight basic ones: colorN, an index into the 256
+   color palette, or #rrggbb, kept as CCZE_COLOR_RGB | 0xrrggbb. Once a
+   keyword uses one, both of its colors are kept here, the basic ones
+   as palette indexes too; the background is -1 if it is the default.
+   The foreground is -1 for keywords with basic colors only. */
+static int ccze_color_ext_fg [CCZE_COLOR_LAST + 1];
+static int ccze_color_ext_bg [CCZE_COLOR_LAST + 1];
+
+/* In ANSI mode, everything that goes before the text of a run, made
+   whenever the color of the keyword is set. */
+static char ccze_color_ansi_seq [CCZE_COLOR_LAST + 1][64];
+
+/* In curses mode, the keywords whose color pair is yet to be made. */
+static unsigned char ccze_color_pending [CCZE_COLOR_LAST + 1];
+
+/* ccze somehow swaped cyan and magenta */
+static int ccze_raw_ansi_color[] = {30, 31, 32, 33, 34, 36, 35, 37};
+
+/* The first sixteen colors of the palette, as xterm has them. */
+static const int ccze_color_basic_rgb[] = {
+  0x000000, 0xcd0000, 0x00cd00, 0xcdcd00, 0x0000ee, 0xcd00cd, 0x00cdcd,
+  0xe5e5e5, 0x7f7f7f, 0xff0000, 0x00ff00, 0xffff00, 0x5c5cff, 0xff00ff,
+  0x00ffff, 0xffffff };
+
 static char *ccze_csscolor_normal_map[] = {
   "black", "darkred", "#00C000", "brown", "blue", "darkcyan",
   "darkmagenta", "grey" };
@@ -261,7 +285,14 @@ ccze_color_to_css (ccze_color_t cidx)
   int my_color = ccze_color_strip_attrib (ccze_color (cidx));
   char *str, *tmp;
 
-  if (my_color < COLOR_PAIR (8))
+  if (ccze_color_ext_fg[cidx] >= 0 && ccze_color_ext_bg[cidx] >= 0)
+    asprintf (&tmp, "\tcolor: #%06x\n\ttext-background: #%06x\n",
+	      ccze_color_ext_rgb (ccze_color_ext_fg[cidx]),
+	      ccze_color_ext_rgb (ccze_color_ext_bg[cidx]));
+  else if (ccze_color_ext_fg[cidx] >= 0)
+    asprintf (&tmp, "\tcolor: #%06x\n",
+	      ccze_color_ext_rgb (ccze_color_ext_fg[cidx]));
+  else if (my_color < COLOR_PAIR (8))
     asprintf (&tmp, "\tcolor: %s\n", ccze_color_to_name_css (my_color, cidx));
   else
     {
@@ -301,9 +332,195 @@ ccze_colors_to_css (void)
     }
 }
 
+/* The same swap, between ccze's basic colors and palette indexes. */
+static int
+_ccze_color_basic_swap (int c)
+{
+  return (c == 5) ? 6 : (c == 6) ? 5 : c;
+}
+
+/* The 0xrrggbb value of an extended color. */
+int
+ccze_color_ext_rgb (int c)
+{
+  static const int level[] = {0, 95, 135, 175, 215, 255};
+
+  if (c & CCZE_COLOR_RGB)
+    return c & 0xffffff;
+  if (c < 16)
+    return ccze_color_basic_rgb[c];
+  if (c < 232)
+    {
+      c -= 16;
+      return (level[c / 36] << 16) | (level[c / 6 % 6] << 8) | level[c % 6];
+    }
+  c = 8 + (c - 232) * 10;
+  return (c << 16) | (c << 8) | c;
+}
+
+static int
+_ccze_color_cube (int c)
+{
+  return (c < 48) ? 0 : (c < 115) ? 1 : (c - 35) / 40;
+}
+
+/* The nearest color of the 6x6x6 color cube of the palette. */
+int
+ccze_color_rgb_to_256 (int rgb)
+{
+  return 16 + 36 * _ccze_color_cube ((rgb >> 16) & 0xff) +
+    6 * _ccze_color_cube ((rgb >> 8) & 0xff) + _ccze_color_cube (rgb & 0xff);
+}
+
+/* colorN or #rrggbb, with or without an on_ in front. */
+static int
+_ccze_color_ext_lookup (const char *color)
+{
+  char *end;
+  long c;
+
+  if (!strncmp (color, "on_", 3))
+    color += 3;
+  if (color[0] == '#' && strlen (color) == 7 &&
+      strspn (color + 1, "0123456789abcdefABCDEF") == 6)
+    return CCZE_COLOR_RGB | (int)strtol (color + 1, NULL, 16);
+  if (!strncmp (color, "color", 5) && color[5] >= '0' && color[5] <= '9')
+    {
+      c = strtol (color + 5, &end, 10);
+      if (!*end && c < 256)
+	return (int)c;
+    }
+  return -1;
+}
+
+static size_t
+_ccze_color_ansi_ext (char *buf, int base, int c)
+{
+  if (c & CCZE_COLOR_RGB)
+    return sprintf (buf, "\x1b[%d;2;%d;%d;%dm", base, (c >> 16) & 0xff,
+		    (c >> 8) & 0xff, c & 0xff);
+  return sprintf (buf, "\x1b[%d;5;%dm", base, c);
+}
+
+static void
+_ccze_color_make_ansi (ccze_color_t idx)
+{
+  char *buf = ccze_color_ansi_seq[idx];
+  int c = ccze_color_table[idx];
+  size_t n;
+
+  n = sprintf (buf, "\x1b[22m"); /* default */
+  if (c & RAW_ANSI_BOLD)
+    n += sprintf (buf + n, "\x1b[1m");
+  if (c & RAW_ANSI_UNDERLINE)
+    n += sprintf (buf + n, "\x1b[4m");
+  if (c & RAW_ANSI_REVERSE)
+    n += sprintf (buf + n, "\x1b[5m");
+  if (c & RAW_ANSI_BLINK)
+    n += sprintf (buf + n, "\x1b[7m");
+
+  if (ccze_color_ext_bg[idx] >= 0)
+    n += _ccze_color_ansi_ext (buf + n, 48, ccze_color_ext_bg[idx]);
+  else if (((c >> 8) & 7) > 0 || !ccze_config.transparent)
+    n += sprintf (buf + n, "\x1b[%dm",
+		  ccze_raw_ansi_color[(c >> 8) & 7] + 10);
+
+  if (ccze_color_ext_fg[idx] >= 0)
+    _ccze_color_ansi_ext (buf + n, 38, ccze_color_ext_fg[idx]);
+  else
+    sprintf (buf + n, "\x1b[%dm", ccze_raw_ansi_color[c & 7]);
+}
+
+/* What to print before a run of color IDX, in ANSI mode. */
+const char *
+ccze_color_ansi (ccze_color_t idx)
+{
+  return ccze_color_ansi_seq[idx];
+}
+
+#ifndef CCZE_STANDALONE
+/* The nearest basic color, as a palette index. */
+static int
+_ccze_color_rgb_to_8 (int rgb)
+{
+  return (((rgb >> 16) & 0xff) > 0x7f) | ((((rgb >> 8) & 0xff) > 0x7f) << 1) |
+    (((rgb & 0xff) > 0x7f) << 2);
+}
+
+/* Curses color pairs past the 64 basic ones, made when first needed,
+   as long as there are pairs left. */
+static struct
+{
+  short fg, bg;
+} ccze_color_pairs[256 - 64];
+static int ccze_color_npairs;
+
+int
+ccze_color_pair (short fg, short bg)
+{
+  int i, max = (COLOR_PAIRS < 256) ? COLOR_PAIRS : 256;
+
+  for (i = 0; i < ccze_color_npairs; i++)
+    if (ccze_color_pairs[i].fg == fg && ccze_color_pairs[i].bg == bg)
+      return 64 + i;
+  if (64 + i >= max || init_pair (64 + i, fg, bg) == ERR)
+    return -1;
+  ccze_color_pairs[i].fg = fg;
+  ccze_color_pairs[i].bg = bg;
+  ccze_color_npairs++;
+  return 64 + i;
+}
+
+/* An extended color, as near as the terminal can show it. */
+static short
+_ccze_color_curses (int c)
+{
+  if (!(c & CCZE_COLOR_RGB) && c < COLORS)
+    return c;
+  if (COLORS >= 256)
+    return ccze_color_rgb_to_256 (ccze_color_ext_rgb (c));
+  return _ccze_color_rgb_to_8 (ccze_color_ext_rgb (c));
+}
+
+static void
+_ccze_color_resolve (ccze_color_t idx)
+{
+  short fg, bg;
+  int pair;
+
+  /* Not before curses is started. */
+  if (!COLORS)
+    return;
+  ccze_color_pending[idx] = 0;
+
+  /* Pair 1 has the default background. */
+  pair_content (1, &fg, &bg);
+  if (ccze_color_ext_bg[idx] >= 0)
+    bg = _ccze_color_curses (ccze_color_ext_bg[idx]);
+  fg = _ccze_color_curses (ccze_color_ext_fg[idx]);
+  if ((pair = ccze_color_pair (fg, bg)) < 0)
+    pair = _ccze_color_basic_swap
+      (_ccze_color_rgb_to_8 (ccze_color_ext_rgb (ccze_color_ext_fg[idx])));
+  ccze_color_table[idx] |= COLOR_PAIR (pair);
+}
+#else
+int
+ccze_color_pair (short fg, short bg)
+{
+  return -1;
+}
+
+static void
+_ccze_color_resolve (ccze_color_t idx)
+{
+}
+#endif
+
 int
 ccze_color (ccze_color_t idx)
 {
+  if (ccze_color_pending[idx])
+    _ccze_color_resolve (idx);
   return ccze_color_table[idx];
 }
 
@@ -350,10 +567,41 @@ ccze_color_parse (char *line)
 {
   char *tmp, *keyword, *color, *pre = NULL, *bg;
   int ncolor = 0, nkeyword = 0, nbg, rcolor, csskey = 0;
+  int extfg = -1, extbg = -1, basicbg = -1;
       
   keyword = strtok (line, " \t\n=");
   if (!keyword)
     return;
+
+#ifndef CCZE_STANDALONE
+  /* highlight COLOR PATTERN, where the pattern is the rest of the
+     line, spaces and all. */
+  if (!strcmp (keyword, "highlight") || !strcmp (keyword, "highlight_regex"))
+    {
+      char *pattern;
+
+      color = strtok (NULL, " \t=");
+      pattern = strtok (NULL, "\n");
+      if (pattern)
+	pattern += strspn (pattern, " \t");
+      if (color && pattern)
+	ccze_highlight_add (color, pattern, keyword[9] == '_');
+      return;
+    }
+
+  /* map NAME COLOR TOKEN..., adding the tokens to a color map. */
+  if (!strcmp (keyword, "map"))
+    {
+      char *name = strtok (NULL, " \t\n"), *token;
+
+      color = strtok (NULL, " \t\n");
+      if (name && color)
+	while ((token = strtok (NULL, " \t\n")))
+	  ccze_colormap_user_add (name, color, token);
+      return;
+    }
+#endif
+
   if (strstr (keyword, "css") == keyword)
     csskey = 1;
   else
@@ -383,21 +631,54 @@ ccze_color_parse (char *line)
     return;
 
   if (!csskey && (ncolor = _ccze_colorname_map_lookup (color)) == -1)
-    return;
+    {
+      if ((extfg = _ccze_color_ext_lookup (color)) == -1)
+	return;
+      ncolor = 0;
+    }
 
   bg = strtok (NULL, " \t\n");
   if (bg)
     {
       if (!csskey && (nbg = _ccze_colorname_map_lookup (bg)) != -1)
       {
+	basicbg = nbg;
 	if (ccze_config.mode == CCZE_MODE_RAW_ANSI)
 	  ncolor += (nbg << 8);
 	else
 	  ncolor += nbg*8;
       }
+      else if (!csskey)
+	extbg = _ccze_color_ext_lookup (bg);
+    }
+
+  /* With an extended color anywhere, both colors are kept aside, and
+     the table only has the attributes. */
+  if (extfg != -1 || extbg != -1)
+    {
+      if (extfg == -1)
+	extfg = _ccze_color_basic_swap (ncolor & 7);
+      if (extbg == -1 && basicbg != -1)
+	extbg = _ccze_color_basic_swap (basicbg);
+      ncolor = 0;
+    }
+  else if (!csskey && color[0] == '\'')
+    {
+      int ref;
+
+      tmp = strndup (&color[1], strlen (color) - 2);
+      ref = _ccze_color_keyword_lookup (tmp, 0);
+      free (tmp);
+      if (ref != -1)
+	{
+	  extfg = ccze_color_ext_fg[ref];
+	  extbg = ccze_color_ext_bg[ref];
+	  if (extfg != -1 && ccze_config.mode != CCZE_MODE_RAW_ANSI)
+	    ncolor = ccze_color_strip_attrib (ncolor) ^ ncolor;
+	}
     }
       
-  if (color[0] == '\'')
+  if (color[0] == '\'' || extfg != -1)
     rcolor = ncolor;
   else
   {
@@ -424,7 +705,15 @@ ccze_color_parse (char *line)
     }
 
   if (!csskey)
-    ccze_color_table[nkeyword] = rcolor;
+    {
+      ccze_color_table[nkeyword] = rcolor;
+      ccze_color_ext_fg[nkeyword] = extfg;
+      ccze_color_ext_bg[nkeyword] = extbg;
+      ccze_color_pending[nkeyword] =
+	(extfg != -1 && ccze_config.mode == CCZE_MODE_CURSES);
+      if (ccze_config.mode == CCZE_MODE_RAW_ANSI)
+	_ccze_color_make_ansi (nkeyword);
+    }
   else
     {
       int bold = 0;
@@ -475,6 +764,67 @@ ccze_cssbody_color (void)
   return ccze_cssbody;
 }
 
+static int
+_ccze_color_css_save (char *dst, const char *src)
+{
+  if (strlen (src) >= CCZE_COLOR_CSS_MAX)
+    return -1;
+  strcpy (dst, src);
+  return 0;
+}
+
+static void
+_ccze_color_css_restore (char **dst, const char *src)
+{
+  if (strcmp (*dst, src))
+    *dst = strdup (src);
+}
+
+/* Copy the colors as the rc files left them into SNAP. Returns -1 if
+   a CSS color is too long to fit. */
+int
+ccze_color_snapshot (ccze_color_snapshot_t *snap)
+{
+  int i;
+
+  memcpy (snap->table, ccze_color_table, sizeof (snap->table));
+  memcpy (snap->ext_fg, ccze_color_ext_fg, sizeof (snap->ext_fg));
+  memcpy (snap->ext_bg, ccze_color_ext_bg, sizeof (snap->ext_bg));
+  for (i = 0; i < 8; i++)
+    if (_ccze_color_css_save (snap->css_normal[i],
+			      ccze_csscolor_normal_map[i]) ||
+	_ccze_color_css_save (snap->css_bold[i], ccze_csscolor_bold_map[i]))
+      return -1;
+  return _ccze_color_css_save (snap->cssbody, ccze_cssbody);
+}
+
+/* Set the colors from SNAP, as if the rc files were read again. */
+void
+ccze_color_restore (const ccze_color_snapshot_t *snap)
+{
+  ccze_color_t cidx;
+  int i;
+
+  memcpy (ccze_color_table, snap->table, sizeof (snap->table));
+  memcpy (ccze_color_ext_fg, snap->ext_fg, sizeof (snap->ext_fg));
+  memcpy (ccze_color_ext_bg, snap->ext_bg, sizeof (snap->ext_bg));
+  for (cidx = 0; cidx <= CCZE_COLOR_LAST; cidx++)
+    {
+      ccze_color_pending[cidx] = (ccze_color_ext_fg[cidx] != -1 &&
+				  ccze_config.mode == CCZE_MODE_CURSES);
+      if (ccze_config.mode == CCZE_MODE_RAW_ANSI)
+	_ccze_color_make_ansi (cidx);
+    }
+  for (i = 0; i < 8; i++)
+    {
+      _ccze_color_css_restore (&ccze_csscolor_normal_map[i],
+			       snap->css_normal[i]);
+      _ccze_color_css_restore (&ccze_csscolor_bold_map[i],
+			       snap->css_bold[i]);
+    }
+  _ccze_color_css_restore (&ccze_cssbody, snap->cssbody);
+}
+
 static void
 ccze_color_init_raw_ansi (void)
 {
@@ -560,9 +910,22 @@ ccze_color_init_raw_ansi (void)
 void
 ccze_color_init (void)
 {
+  ccze_color_t cidx;
+
+  for (cidx = 0; cidx <= CCZE_COLOR_LAST; cidx++)
+    {
+      ccze_color_ext_fg[cidx] = ccze_color_ext_bg[cidx] = -1;
+      ccze_color_pending[cidx] = 0;
+    }
+#ifndef CCZE_STANDALONE
+  ccze_color_npairs = 0;
+#endif
+
   if (ccze_config.mode == CCZE_MODE_RAW_ANSI)
     {
       ccze_color_init_raw_ansi ();
+      for (cidx = 0; cidx <= CCZE_COLOR_LAST; cidx++)
+	_ccze_color_make_ansi (cidx);
       return;
     }
   
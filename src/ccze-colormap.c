@@ -0,0 +1,298 @@
+/* -*- mode: c; c-file-style: "gnu" -*-
+ * ccze-colormap.c -- Coloring known tokens by table
+ * Copyright (C) 2003 Gergely Nagy <algernon@bonehunter.rulez.org>
+ *
+ * This file is part of ccze.
+ *
+ * ccze is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ccze is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+
+#include <ccze.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "ccze-private.h"
+
+/* A color map tells the color of a token - an HTTP method, a squid
+   result code, and such - that is one of a known set. Plugins declare
+   the tokens they know, and the rc files can add more, or recolor the
+   known ones:
+
+     map http post PATCH DELETE OPTIONS
+
+   Upon the first lookup after either changed, the map is compiled
+   into a perfect hash table, so a lookup is hashing the token and a
+   single comparison, however many tokens there are. A token not in
+   the map is handed to the fallback of the map, if there is one.
+
+   The maps stay around, found by name, until the program ends, so the
+   tokens from the rc files may be read before the plugin declaring
+   the map is even loaded. */
+typedef struct
+{
+  char *token;
+  size_t len;
+  ccze_color_t color;
+} ccze_colormap_entry_t;
+
+struct ccze_colormap
+{
+  char *name;
+  int nocase;
+  ccze_colormap_fallback_t fallback;
+  ccze_colormap_entry_t *entries;
+  size_t nentries, entries_alloc;
+
+  /* The compiled table, of mask + 1 slots, pointing into entries and
+     into the tokens from the rc files. */
+  const ccze_colormap_entry_t **table;
+  unsigned int seed, mask;
+  unsigned int generation;
+
+  ccze_colormap_t *next;
+};
+
+typedef struct
+{
+  char *map;
+  ccze_colormap_entry_t entry;
+} ccze_colormap_user_t;
+
+static ccze_colormap_t *maps;
+static ccze_colormap_user_t *user;
+static size_t nuser, user_alloc;
+/* Bumped whenever the tokens from the rc files change, so every map
+   gets recompiled. Zero is never used, so a map compiled with it is
+   always out of date. */
+static unsigned int generation = 1;
+
+#define CCZE_COLORMAP_FOLD(map,c) \
+  ((map)->nocase && (c) >= 'A' && (c) <= 'Z' ? (c) - 'A' + 'a' : (c))
+
+static unsigned int
+_ccze_colormap_hash (const ccze_colormap_t *map, unsigned int seed,
+		     const char *token, size_t len)
+{
+  unsigned int h = seed;
+  size_t i;
+
+  for (i = 0; i < len; i++)
+    h = (h ^ CCZE_COLORMAP_FOLD (map, (unsigned char)token[i])) * 16777619U;
+  return (h ^ (h >> 16)) & map->mask;
+}
+
+static int
+_ccze_colormap_same (const ccze_colormap_t *map, const char *token,
+		     size_t len, const ccze_colormap_entry_t *e)
+{
+  if (e->len != len)
+    return 0;
+  return (map->nocase) ? !strncasecmp (e->token, token, len) :
+    !memcmp (e->token, token, len);
+}
+
+/* Put E into the table with the current seed. Returns non-zero if its
+   slot is taken by another token. The same token again replaces the
+   one already there, so the rc files override the plugins. */
+static int
+_ccze_colormap_put (ccze_colormap_t *map, const ccze_colormap_entry_t *e)
+{
+  unsigned int h = _ccze_colormap_hash (map, map->seed, e->token, e->len);
+
+  if (map->table[h] && !_ccze_colormap_same (map, e->token, e->len,
+					     map->table[h]))
+    return -1;
+  map->table[h] = e;
+  return 0;
+}
+
+/* Find a seed with which no two tokens share a slot, growing the
+   table if there seems to be none. */
+static void
+_ccze_colormap_build (ccze_colormap_t *map)
+{
+  size_t n = map->nentries, size = 16, i;
+
+  for (i = 0; i < nuser; i++)
+    n += !strcmp (user[i].map, map->name);
+  while (size < n * 4)
+    size *= 2;
+
+  for (;; size *= 2)
+    {
+      map->mask = size - 1;
+      map->table = (const ccze_colormap_entry_t **)ccze_realloc
+	(map->table, size * sizeof (ccze_colormap_entry_t *));
+
+      for (map->seed = 2166136261U; map->seed < 2166136261U + 4096;
+	   map->seed++)
+	{
+	  memset (map->table, 0, size * sizeof (ccze_colormap_entry_t *));
+	  for (i = 0; i < map->nentries; i++)
+	    if (_ccze_colormap_put (map, &map->entries[i]))
+	      break;
+	  if (i < map->nentries)
+	    continue;
+	  for (i = 0; i < nuser; i++)
+	    if (!strcmp (user[i].map, map->name) &&
+		_ccze_colormap_put (map, &user[i].entry))
+	      break;
+	  if (i == nuser)
+	    {
+	      map->generation = generation;
+	      return;
+	    }
+	}
+    }
+}
+
+static ccze_colormap_t *
+_ccze_colormap_find (const char *name)
+{
+  ccze_colormap_t *map;
+
+  for (map = maps; map; map = map->next)
+    if (!strcmp (map->name, name))
+      return map;
+  return NULL;
+}
+
+ccze_colormap_t *
+ccze_colormap_new (const char *name, int nocase,
+		   ccze_colormap_fallback_t fallback)
+{
+  ccze_colormap_t *map = _ccze_colormap_find (name);
+  size_t i;
+
+  if (!map)
+    {
+      map = (ccze_colormap_t *)ccze_calloc (1, sizeof (ccze_colormap_t));
+      map->name = strdup (name);
+      map->next = maps;
+      maps = map;
+    }
+
+  /* Declared again, by a plugin set up anew. */
+  for (i = 0; i < map->nentries; i++)
+    free (map->entries[i].token);
+  map->nentries = 0;
+  map->nocase = nocase;
+  map->fallback = fallback;
+  map->generation = 0;
+  return map;
+}
+
+void
+ccze_colormap_add (ccze_colormap_t *map, const char *token, ccze_color_t col)
+{
+  ccze_colormap_entry_t *e;
+
+  if (map->nentries >= map->entries_alloc)
+    {
+      map->entries_alloc = (map->entries_alloc) ? map->entries_alloc * 2 : 16;
+      map->entries = (ccze_colormap_entry_t *)ccze_realloc
+	(map->entries, map->entries_alloc * sizeof (ccze_colormap_entry_t));
+    }
+  e = &map->entries[map->nentries++];
+  e->token = strdup (token);
+  e->len = strlen (token);
+  e->color = col;
+  map->generation = 0;
+}
+
+ccze_color_t
+ccze_colormap_lookup (ccze_colormap_t *map, const char *token)
+{
+  const ccze_colormap_entry_t *e;
+  size_t len = strlen (token);
+
+  if (map->generation != generation)
+    _ccze_colormap_build (map);
+
+  e = map->table[_ccze_colormap_hash (map, map->seed, token, len)];
+  if (e && _ccze_colormap_same (map, token, len, e))
+    return e->color;
+  return (map->fallback) ? map->fallback (token) : CCZE_COLOR_UNKNOWN;
+}
+
+int
+ccze_colormap_user_add (const char *map, const char *color, const char *token)
+{
+  int col = ccze_color_keyword_lookup (color);
+
+  if (col < 0)
+    return -1;
+  return ccze_colormap_user_add_class (map, (ccze_color_t)col, token);
+}
+
+int
+ccze_colormap_user_add_class (const char *map, ccze_color_t col,
+			      const char *token)
+{
+  ccze_colormap_user_t *u;
+
+  if (!*map || !*token)
+    return -1;
+
+  if (nuser >= user_alloc)
+    {
+      user_alloc = (user_alloc) ? user_alloc * 2 : 16;
+      user = (ccze_colormap_user_t *)ccze_realloc
+	(user, user_alloc * sizeof (ccze_colormap_user_t));
+    }
+  u = &user[nuser++];
+  u->map = strdup (map);
+  u->entry.token = strdup (token);
+  u->entry.len = strlen (token);
+  u->entry.color = col;
+  if (++generation == 0)
+    generation = 1;
+  return 0;
+}
+
+size_t
+ccze_colormap_user_count (void)
+{
+  return nuser;
+}
+
+/* The INDEXth token from the rc files, with its map and color. */
+const char *
+ccze_colormap_user_get (size_t index, const char **map, ccze_color_t *col)
+{
+  if (index >= nuser)
+    return NULL;
+  *map = user[index].map;
+  *col = user[index].entry.color;
+  return user[index].entry.token;
+}
+
+/* Forget the tokens from the rc files, before they are read again. */
+void
+ccze_colormap_user_reset (void)
+{
+  size_t i;
+
+  for (i = 0; i < nuser; i++)
+    {
+      free (user[i].map);
+      free (user[i].entry.token);
+    }
+  nuser = 0;
+  if (++generation == 0)
+    generation = 1;
+}
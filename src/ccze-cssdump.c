@@ -19,6 +19,10 @@
  * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
  */
 
+/* ccze-color.c is built in without the parts that need the rest of
+   ccze: highlights, color maps and curses. */
+#define CCZE_STANDALONE 1
+
 #include <ccze.h>
 #ifdef HAVE_ARGP_H
 # include <argp.h>
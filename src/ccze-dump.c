@@ -20,6 +20,7 @@
  */
 
 #define CCZE_DUMP 1
+#define CCZE_STANDALONE 1
 
 #include <ccze.h>
 #ifdef HAVE_ARGP_H
@@ -116,6 +117,32 @@ ccze_dump_color_to_name (int color)
     }
 }
 
+static void
+ccze_dump_color_ext (char *buf, int c)
+{
+  if (c & CCZE_COLOR_RGB)
+    sprintf (buf, "#%06x", c & 0xffffff);
+  else
+    sprintf (buf, "color%d", c);
+}
+
+static char *
+ccze_dump_color_ext_to_name (ccze_color_t cidx)
+{
+  static char str[40];
+  char fg[16], bg[16];
+
+  ccze_dump_color_ext (fg, ccze_color_ext_fg[cidx]);
+  if (ccze_color_ext_bg[cidx] < 0)
+    strcpy (str, fg);
+  else
+    {
+      ccze_dump_color_ext (bg, ccze_color_ext_bg[cidx]);
+      snprintf (str, sizeof (str), "%s on_%s", fg, bg);
+    }
+  return str;
+}
+
 static char *
 ccze_dump_color_comment (int cidx)
 {
@@ -177,7 +204,10 @@ main (int argc, char *argv[])
   printf ("# Available colors:  black, red, green, yellow, blue, magenta, "
 	  "cyan, white\n");
   printf ("# Available bgcolors: on_black, on_red, on_green, on_yellow, "
-	  "on_blue, on_magenta, on_cyan, on_white\n#\n");
+	  "on_blue, on_magenta, on_cyan, on_white\n");
+  printf ("# Extended colors: color0 to color255 (the 256 color palette), "
+	  "or #rrggbb,\n# and on_color0 to on_color255 or on_#rrggbb as "
+	  "bgcolors\n#\n");
   printf ("# You can also use item names in color definition, like:\n#\n");
   printf ("# default   blue\n# date      'default'\n#\n");
   printf ("# Here you defined default color to blue, and date color to "
@@ -200,7 +230,10 @@ main (int argc, char *argv[])
       memset (&line[llen], ' ', 16 - llen);
       line[16]='\0';
       strcat (line, ccze_dump_color_get_attrib (color));
-      strcat (line, ccze_dump_color_to_name (color));
+      if (ccze_color_ext_fg[cidx] >= 0)
+	strcat (line, ccze_dump_color_ext_to_name (cidx));
+      else
+	strcat (line, ccze_dump_color_to_name (color));
       llen = strlen (line);
       memset (&line[llen], ' ', 42 - llen);
       line[40]='#';
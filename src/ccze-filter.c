@@ -0,0 +1,245 @@
+/* -*- mode: c; c-file-style: "gnu" -*-
+ * ccze-filter.c -- Line filtering on plugins, hosts, processes, colors
+ * and time
+ * Copyright (C) 2003 Gergely Nagy <algernon@bonehunter.rulez.org>
+ *
+ * This file is part of ccze.
+ *
+ * ccze is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ccze is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include <ccze.h>
+#include <fnmatch.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ccze-private.h"
+
+/* A line is shown only if it satisfies every kind of filter given.
+   Within one kind, any of the listed values will do. */
+typedef struct
+{
+  char **list;
+  size_t len, alloc;
+} ccze_filter_list_t;
+
+static ccze_filter_list_t filter_plugins, filter_hosts, filter_procs;
+static unsigned char filter_classes[CCZE_COLOR_LAST];
+
+/* Which kinds of filters are set, which are satisfied by the current
+   line, and whether it was already thrown away. */
+static int filter_wanted, filter_seen, filter_rejected;
+
+/* The time range. Lines without a date of their own go with the line
+   before them; RANGE_OPEN is set until the FULL plugins are done, as
+   only the date they found is the date of the line. */
+static time_t range_from = (time_t)-1, range_to = (time_t)-1;
+static int range_in, range_dated, range_open, range_done;
+
+static void
+_ccze_filter_list_add (ccze_filter_list_t *l, const char *value)
+{
+  if (l->len >= l->alloc)
+    {
+      l->alloc = (l->alloc) ? l->alloc * 2 : 4;
+      l->list = (char **)ccze_realloc (l->list, l->alloc * sizeof (char *));
+    }
+  l->list[l->len++] = strdup (value);
+}
+
+static int
+_ccze_filter_list_match (const ccze_filter_list_t *l, const char *str)
+{
+  size_t i;
+
+  for (i = 0; i < l->len; i++)
+    if (!fnmatch (l->list[i], str, 0))
+      return 1;
+  return 0;
+}
+
+/* Add a comma separated LIST of values to the filter of kind WHAT.
+   Returns -1 if a color class in the list is unknown. */
+int
+ccze_filter_add (int what, const char *list)
+{
+  char *copy, *value, *next;
+  int ret = 0;
+
+  copy = strdup (list);
+  for (value = copy; value; value = next)
+    {
+      if ((next = strchr (value, ',')) != NULL)
+	*next++ = '\0';
+      if (!*value)
+	continue;
+
+      switch (what)
+	{
+	case CCZE_FILTER_PLUGIN:
+	  _ccze_filter_list_add (&filter_plugins, value);
+	  break;
+	case CCZE_FILTER_HOST:
+	  _ccze_filter_list_add (&filter_hosts, value);
+	  break;
+	case CCZE_FILTER_PROCESS:
+	  _ccze_filter_list_add (&filter_procs, value);
+	  break;
+	case CCZE_FILTER_CLASS:
+	  {
+	    int col = ccze_color_keyword_lookup (value);
+
+	    if (col < 0)
+	      {
+		ret = -1;
+		continue;
+	      }
+	    filter_classes[col] = 1;
+	  }
+	  break;
+	default:
+	  break;
+	}
+      filter_wanted |= what;
+    }
+  free (copy);
+  return ret;
+}
+
+/* Only show lines dated between FROM and TO, either of which may be
+   -1 for no limit. */
+void
+ccze_filter_range (time_t from, time_t to)
+{
+  range_from = from;
+  range_to = to;
+  range_in = (from == (time_t)-1);
+  filter_wanted |= CCZE_FILTER_TIME;
+}
+
+/* Non-zero once a line dated after the end of the range was seen:
+   nothing more will be shown. */
+int
+ccze_filter_done (void)
+{
+  return range_done;
+}
+
+static void
+_ccze_filter_date (const char *str)
+{
+  time_t t;
+
+  if (!range_open || range_dated)
+    return;
+  range_dated = 1;
+  if ((t = ccze_date_parse (str)) == (time_t)-1)
+    return;
+
+  range_in = ((range_from == (time_t)-1 || t >= range_from) &&
+	      (range_to == (time_t)-1 || t <= range_to));
+  if (range_to != (time_t)-1 && t > range_to)
+    range_done = 1;
+  if (range_in)
+    filter_seen |= CCZE_FILTER_TIME;
+  else
+    filter_seen &= ~CCZE_FILTER_TIME;
+}
+
+void
+ccze_filter_start (void)
+{
+  filter_seen = (range_in) ? CCZE_FILTER_TIME : 0;
+  filter_rejected = 0;
+  range_dated = 0;
+  range_open = 1;
+}
+
+/* The current line continues a record: it is shown if the line which
+   started the record was, whatever is in it. */
+void
+ccze_filter_continue (int shown)
+{
+  filter_seen = (shown) ? filter_wanted : 0;
+  filter_rejected = !shown;
+  range_open = 0;
+}
+
+int
+ccze_filter_rejected (void)
+{
+  return filter_rejected;
+}
+
+/* Called when plugin NAME handled the current line. */
+void
+ccze_filter_handled (const char *name)
+{
+  if ((filter_wanted & CCZE_FILTER_PLUGIN) &&
+      _ccze_filter_list_match (&filter_plugins, name))
+    filter_seen |= CCZE_FILTER_PLUGIN;
+}
+
+/* Look at a piece of the line before it gets added to the output. The
+   FULL plugins add the host and process names they captured this
+   way. */
+void
+ccze_filter_token (ccze_color_t col, const char *str)
+{
+  if (filter_classes[col])
+    filter_seen |= CCZE_FILTER_CLASS;
+
+  switch (col)
+    {
+    case CCZE_COLOR_HOST:
+      if ((filter_wanted & CCZE_FILTER_HOST) &&
+	  _ccze_filter_list_match (&filter_hosts, str))
+	filter_seen |= CCZE_FILTER_HOST;
+      break;
+    case CCZE_COLOR_PROC:
+      if ((filter_wanted & CCZE_FILTER_PROCESS) &&
+	  _ccze_filter_list_match (&filter_procs, str))
+	filter_seen |= CCZE_FILTER_PROCESS;
+      break;
+    case CCZE_COLOR_DATE:
+      if (filter_wanted & CCZE_FILTER_TIME)
+	_ccze_filter_date (str);
+      break;
+    default:
+      break;
+    }
+}
+
+/* Reject the line now if any of the filters in MASK is not satisfied:
+   once the plugins which could have satisfied them are done, there is
+   no point in colorizing the rest. Returns non-zero if the line was
+   rejected. */
+int
+ccze_filter_check (int mask)
+{
+  range_open = 0;
+  if (filter_wanted & mask & ~filter_seen)
+    filter_rejected = 1;
+  return filter_rejected;
+}
+
+/* Whether the finished line should be output. */
+int
+ccze_filter_accept (void)
+{
+  return (!filter_rejected &&
+	  (filter_seen & filter_wanted) == filter_wanted);
+}
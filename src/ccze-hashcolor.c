@@ -0,0 +1,210 @@
+/* -*- mode: c; c-file-style: "gnu" -*-
+ * ccze-hashcolor.c -- Per-entity colors for hosts, PIDs and queue IDs
+ * Copyright (C) 2003 Gergely Nagy <algernon@bonehunter.rulez.org>
+ *
+ * This file is part of ccze.
+ *
+ * ccze is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ccze is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include <ccze.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ccze-private.h"
+
+/* With -o hashcolor, every host, PID and message ID gets a color of
+   its own, picked from a palette by a hash of its text, so the same
+   one always looks the same, in this run and the next. Mails followed
+   through the queue (see ccze-mailq.c) are given theirs in turn.
+
+   Whatever a palette entry needs - its escape sequence, its CSS color
+   or its curses color pair - is made the first time it is used, and
+   kept. The table is as large as the palette, however many entities
+   there are, and after the first sighting an entity costs no more
+   than hashing its text. */
+typedef enum
+{
+  CCZE_HASHCOLOR_8,
+  CCZE_HASHCOLOR_256,
+  CCZE_HASHCOLOR_TRUE
+} ccze_hashcolor_depth_t;
+
+typedef struct
+{
+  int ready;
+  unsigned char r, g, b;
+  char seq[40];
+  char css[8];
+  int attr;
+} ccze_hashcolor_slot_t;
+
+static ccze_hashcolor_slot_t slots[CCZE_HASHCOLOR_SLOTS];
+static ccze_hashcolor_depth_t depth;
+static int nslots;
+
+/* The fallback palette: the six colors that are neither black nor
+   white, normal and bold. */
+#define CCZE_HASHCOLOR_SLOTS_8 12
+
+static void
+_ccze_hashcolor_setup (void)
+{
+  const char *env;
+
+  switch (ccze_config.mode)
+    {
+    case CCZE_MODE_CURSES:
+      depth = (COLORS >= 256) ? CCZE_HASHCOLOR_256 : CCZE_HASHCOLOR_8;
+      break;
+    case CCZE_MODE_RAW_ANSI:
+      depth = CCZE_HASHCOLOR_8;
+      if ((env = getenv ("COLORTERM")) &&
+	  (!strcmp (env, "truecolor") || !strcmp (env, "24bit")))
+	depth = CCZE_HASHCOLOR_TRUE;
+      else if ((env = getenv ("TERM")) && strstr (env, "256"))
+	depth = CCZE_HASHCOLOR_256;
+      break;
+    default:
+      depth = CCZE_HASHCOLOR_TRUE;
+      break;
+    }
+  nslots = (depth == CCZE_HASHCOLOR_8) ? CCZE_HASHCOLOR_SLOTS_8 :
+    CCZE_HASHCOLOR_SLOTS;
+}
+
+/* Spread the hues of the palette around the color wheel, each one as
+   far from the previous as it can get, and make every other one a bit
+   darker. */
+static void
+_ccze_hashcolor_rgb (int slot, ccze_hashcolor_slot_t *s)
+{
+  int hue = (slot * 1375 / 10) % 360, sector = hue / 60;
+  int v = (slot & 1) ? 205 : 255, lo = v * 35 / 100;
+  int rise = lo + (v - lo) * (hue % 60) / 60;
+  int fall = v - (v - lo) * (hue % 60) / 60;
+  int rgb[6][3] = {
+    {v, rise, lo}, {fall, v, lo}, {lo, v, rise},
+    {lo, fall, v}, {rise, lo, v}, {v, lo, fall}
+  };
+
+  s->r = rgb[sector][0];
+  s->g = rgb[sector][1];
+  s->b = rgb[sector][2];
+}
+
+static void
+_ccze_hashcolor_make (int slot)
+{
+  ccze_hashcolor_slot_t *s = &slots[slot];
+  const char *back = (ccze_config.transparent) ? "" : "\x1b[40m";
+  int cube, pair = -1;
+
+  _ccze_hashcolor_rgb (slot, s);
+  cube = ccze_color_rgb_to_256 ((s->r << 16) | (s->g << 8) | s->b);
+
+  switch (depth)
+    {
+    case CCZE_HASHCOLOR_8:
+      snprintf (s->seq, sizeof (s->seq), "\x1b[22m%s\x1b[%s3%dm", back,
+		(slot >= 6) ? "1;" : "", slot % 6 + 1);
+      break;
+    case CCZE_HASHCOLOR_256:
+      snprintf (s->seq, sizeof (s->seq), "\x1b[22m%s\x1b[38;5;%dm", back,
+		cube);
+      break;
+    case CCZE_HASHCOLOR_TRUE:
+      snprintf (s->seq, sizeof (s->seq), "\x1b[22m%s\x1b[38;2;%d;%d;%dm",
+		back, s->r, s->g, s->b);
+      break;
+    }
+  snprintf (s->css, sizeof (s->css), "#%02x%02x%02x", s->r, s->g, s->b);
+
+  if (ccze_config.mode == CCZE_MODE_CURSES)
+    {
+      /* Pair 1 is red on whatever the background is. */
+      short fg, bg;
+
+      pair_content (1, &fg, &bg);
+      if (depth == CCZE_HASHCOLOR_256)
+	pair = ccze_color_pair (cube, bg);
+      if (pair >= 0)
+	s->attr = COLOR_PAIR (pair);
+      else
+	s->attr = COLOR_PAIR (slot % 6 + 1) | ((slot >= 6) ? A_BOLD : 0);
+    }
+  s->ready = 1;
+}
+
+/* Forget everything made so far: the color pairs, for one, are gone
+   when curses is restarted. */
+void
+ccze_hashcolor_reset (void)
+{
+  memset (slots, 0, sizeof (slots));
+  nslots = 0;
+}
+
+/* The palette entry of the token STR (LEN bytes long), colored COL,
+   or -1 if it keeps the color of its class. */
+int
+ccze_hashcolor_slot (ccze_color_t col, const char *str, size_t len)
+{
+  unsigned int h = 2166136261U;
+  size_t i;
+  int mail = -1;
+
+  /* Mails in the queue have their colors handed out in turn. */
+  if (ccze_config.mailq && col == CCZE_COLOR_UNIQN && len)
+    mail = ccze_mailq_color (str, len);
+
+  /* "-" is no one in particular. */
+  if ((!ccze_config.hashcolor && mail < 0) || !len ||
+      (len == 1 && *str == '-') ||
+      (col != CCZE_COLOR_HOST && col != CCZE_COLOR_PID &&
+       col != CCZE_COLOR_UNIQN))
+    return -1;
+
+  if (!nslots)
+    _ccze_hashcolor_setup ();
+  if (mail >= 0)
+    h = (unsigned int)mail;
+  else
+    for (i = 0; i < len; i++)
+      h = (h ^ (unsigned char)str[i]) * 16777619U;
+  h %= nslots;
+  if (!slots[h].ready)
+    _ccze_hashcolor_make (h);
+  return (int)h;
+}
+
+const char *
+ccze_hashcolor_ansi (int slot)
+{
+  return slots[slot].seq;
+}
+
+int
+ccze_hashcolor_attr (int slot)
+{
+  return slots[slot].attr;
+}
+
+const char *
+ccze_hashcolor_css (int slot)
+{
+  return slots[slot].css;
+}
@@ -0,0 +1,416 @@
+/* -*- mode: c; c-file-style: "gnu" -*-
+ * ccze-highlight.c -- User supplied highlight patterns
+ * Copyright (C) 2003 Gergely Nagy <algernon@bonehunter.rulez.org>
+ *
+ * This file is part of ccze.
+ *
+ * ccze is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ccze is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include <ccze.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ccze-private.h"
+
+typedef struct
+{
+  char *pattern;
+  size_t len;
+  ccze_color_t color;
+  int regex;
+  int group;
+  /* A regex that cannot go into the alternation, matched on its own. */
+  pcre *re;
+  pcre_extra *hints;
+} ccze_highlight_t;
+
+static ccze_highlight_t *patterns;
+static size_t npatterns, patterns_alloc;
+
+/* All the literal patterns are matched by one Aho-Corasick automaton,
+   turned into a DFA. Bytes not appearing in any pattern share class
+   zero, so the transition table has only as many columns as there are
+   distinct bytes in the patterns. */
+static unsigned char ac_class[256];
+static size_t ac_nclass;
+static int *ac_next;
+static int *ac_out;
+static size_t ac_nstates, ac_alloc;
+
+/* All the regex patterns are matched by one alternation, with each of
+   them in its own capturing group. Those referring back to a group of
+   their own are not: in the alternation, their groups would have other
+   numbers, so they are matched one by one. */
+static pcre *hl_re;
+static pcre_extra *hl_hints;
+static int hl_ovecsize;
+static int *hl_ovec;
+
+static unsigned char *marks;
+static size_t marks_alloc;
+
+int
+ccze_highlight_add (const char *color, const char *pattern, int regex)
+{
+  int col = ccze_color_keyword_lookup (color);
+
+  if (col < 0)
+    return -1;
+  return ccze_highlight_add_class ((ccze_color_t)col, pattern, regex);
+}
+
+int
+ccze_highlight_add_class (ccze_color_t col, const char *pattern, int regex)
+{
+  ccze_highlight_t *h;
+
+  if (!pattern || !*pattern)
+    return -1;
+
+  if (npatterns >= patterns_alloc)
+    {
+      patterns_alloc = (patterns_alloc) ? patterns_alloc * 2 : 16;
+      patterns = (ccze_highlight_t *)ccze_realloc
+	(patterns, patterns_alloc * sizeof (ccze_highlight_t));
+    }
+  h = &patterns[npatterns++];
+  h->pattern = strdup (pattern);
+  h->len = strlen (pattern);
+  h->color = (ccze_color_t)col;
+  h->regex = regex;
+  h->group = 0;
+  h->re = NULL;
+  h->hints = NULL;
+  return 0;
+}
+
+size_t
+ccze_highlight_count (void)
+{
+  return npatterns;
+}
+
+/* The INDEXth pattern added, with its color and kind. */
+const char *
+ccze_highlight_get (size_t index, ccze_color_t *col, int *regex)
+{
+  if (index >= npatterns)
+    return NULL;
+  *col = patterns[index].color;
+  *regex = patterns[index].regex;
+  return patterns[index].pattern;
+}
+
+static int
+_ccze_highlight_ac_state (void)
+{
+  size_t i;
+
+  if (ac_nstates >= ac_alloc)
+    {
+      ac_alloc = (ac_alloc) ? ac_alloc * 2 : 64;
+      ac_next = (int *)ccze_realloc (ac_next,
+				     ac_alloc * ac_nclass * sizeof (int));
+      ac_out = (int *)ccze_realloc (ac_out, ac_alloc * sizeof (int));
+    }
+  for (i = 0; i < ac_nclass; i++)
+    ac_next[ac_nstates * ac_nclass + i] = -1;
+  ac_out[ac_nstates] = -1;
+  return (int)ac_nstates++;
+}
+
+static void
+_ccze_highlight_ac_build (void)
+{
+  size_t i, j, head = 0, tail = 0;
+  int *fail, *queue;
+
+  memset (ac_class, 0, sizeof (ac_class));
+  ac_nclass = 1;
+  for (i = 0; i < npatterns; i++)
+    if (!patterns[i].regex)
+      for (j = 0; j < patterns[i].len; j++)
+	{
+	  unsigned char c = (unsigned char)patterns[i].pattern[j];
+
+	  if (!ac_class[c])
+	    ac_class[c] = (unsigned char)ac_nclass++;
+	}
+  if (ac_nclass == 1)
+    return;
+
+  /* The trie. The output of a state is the longest pattern ending
+     there. */
+  _ccze_highlight_ac_state ();
+  for (i = 0; i < npatterns; i++)
+    {
+      int s = 0;
+
+      if (patterns[i].regex)
+	continue;
+      for (j = 0; j < patterns[i].len; j++)
+	{
+	  size_t c = ac_class[(unsigned char)patterns[i].pattern[j]];
+
+	  if (ac_next[s * ac_nclass + c] < 0)
+	    {
+	      int n = _ccze_highlight_ac_state ();
+	      ac_next[s * ac_nclass + c] = n;
+	    }
+	  s = ac_next[s * ac_nclass + c];
+	}
+      if (ac_out[s] < 0 || patterns[ac_out[s]].len < patterns[i].len)
+	ac_out[s] = (int)i;
+    }
+
+  /* Breadth first, fill in the failure transitions, so that scanning
+     is a single table lookup per byte. */
+  fail = (int *)ccze_calloc (ac_nstates, sizeof (int));
+  queue = (int *)ccze_calloc (ac_nstates, sizeof (int));
+  for (i = 0; i < ac_nclass; i++)
+    {
+      int n = ac_next[i];
+
+      if (n < 0)
+	ac_next[i] = 0;
+      else
+	{
+	  fail[n] = 0;
+	  queue[tail++] = n;
+	}
+    }
+  while (head < tail)
+    {
+      int s = queue[head++];
+
+      if (ac_out[s] < 0)
+	ac_out[s] = ac_out[fail[s]];
+      for (i = 0; i < ac_nclass; i++)
+	{
+	  int n = ac_next[s * ac_nclass + i];
+	  int f = ac_next[fail[s] * ac_nclass + i];
+
+	  if (n < 0)
+	    ac_next[s * ac_nclass + i] = f;
+	  else
+	    {
+	      fail[n] = f;
+	      queue[tail++] = n;
+	    }
+	}
+    }
+  free (fail);
+  free (queue);
+}
+
+static void
+_ccze_highlight_re_build (void)
+{
+  char *combined = NULL;
+  size_t i, clen = 0;
+  int group = 1, ovecsize = 0;
+  const char *error;
+  int errptr;
+
+  for (i = 0; i < npatterns; i++)
+    {
+      pcre *re;
+      int ncap = 0, backref = 0;
+
+      if (!patterns[i].regex)
+	continue;
+
+      /* Check each regex on its own, so a bad one does not spoil the
+	 rest, and to know how many groups it brings along. */
+      if (!(re = pcre_compile (patterns[i].pattern, 0, &error, &errptr,
+			       NULL)))
+	{
+	  patterns[i].group = 0;
+	  continue;
+	}
+      pcre_fullinfo (re, NULL, PCRE_INFO_CAPTURECOUNT, &ncap);
+      pcre_fullinfo (re, NULL, PCRE_INFO_BACKREFMAX, &backref);
+      if (backref)
+	{
+	  patterns[i].re = re;
+	  patterns[i].hints = pcre_study (re, 0, &error);
+	  if ((ncap + 1) * 3 > ovecsize)
+	    ovecsize = (ncap + 1) * 3;
+	  continue;
+	}
+      pcre_free (re);
+
+      combined = (char *)ccze_realloc (combined,
+				       clen + patterns[i].len + 4);
+      if (clen)
+	combined[clen++] = '|';
+      combined[clen++] = '(';
+      memcpy (combined + clen, patterns[i].pattern, patterns[i].len);
+      clen += patterns[i].len;
+      combined[clen++] = ')';
+      combined[clen] = '\0';
+
+      patterns[i].group = group;
+      group += ncap + 1;
+    }
+
+  if (combined)
+    {
+      hl_re = pcre_compile (combined, 0, &error, &errptr, NULL);
+      hl_hints = pcre_study (hl_re, 0, &error);
+      if (group * 3 > ovecsize)
+	ovecsize = group * 3;
+      free (combined);
+    }
+  if (ovecsize)
+    {
+      hl_ovecsize = ovecsize;
+      hl_ovec = (int *)ccze_calloc (hl_ovecsize, sizeof (int));
+    }
+}
+
+void
+ccze_highlight_setup (void)
+{
+  if (!npatterns)
+    return;
+  _ccze_highlight_ac_build ();
+  _ccze_highlight_re_build ();
+}
+
+void
+ccze_highlight_shutdown (void)
+{
+  size_t i;
+
+  for (i = 0; i < npatterns; i++)
+    {
+      free (patterns[i].pattern);
+      if (patterns[i].re)
+	pcre_free (patterns[i].re);
+      free (patterns[i].hints);
+    }
+  free (patterns);
+  patterns = NULL;
+  npatterns = patterns_alloc = 0;
+
+  free (ac_next);
+  free (ac_out);
+  ac_next = ac_out = NULL;
+  ac_nstates = ac_alloc = 0;
+  ac_nclass = 0;
+
+  free (hl_re);
+  free (hl_hints);
+  free (hl_ovec);
+  hl_re = NULL;
+  hl_hints = NULL;
+  hl_ovec = NULL;
+
+  free (marks);
+  marks = NULL;
+  marks_alloc = 0;
+}
+
+/* Mark [START,END) with COL, leaving bytes an earlier match already
+   claimed alone. */
+static int
+_ccze_highlight_mark (size_t start, size_t end, ccze_color_t col,
+		      size_t len, int any)
+{
+  if (!any)
+    {
+      if (len > marks_alloc)
+	{
+	  marks_alloc = len;
+	  marks = (unsigned char *)ccze_realloc (marks, marks_alloc);
+	}
+      memset (marks, CCZE_HIGHLIGHT_NONE, len);
+    }
+  for (; start < end; start++)
+    if (marks[start] == CCZE_HIGHLIGHT_NONE)
+      marks[start] = (unsigned char)col;
+  return 1;
+}
+
+/* Find the highlighted spans in TEXT. Returns NULL if there are none,
+   otherwise an array of LEN colors, CCZE_HIGHLIGHT_NONE where the
+   original coloring stays. */
+const unsigned char *
+ccze_highlight_scan (const char *text, size_t len)
+{
+  int any = 0;
+  size_t i;
+
+  if (ac_nstates)
+    {
+      int s = 0;
+
+      for (i = 0; i < len; i++)
+	{
+	  s = ac_next[s * ac_nclass + ac_class[(unsigned char)text[i]]];
+	  if (ac_out[s] >= 0)
+	    {
+	      ccze_highlight_t *h = &patterns[ac_out[s]];
+	      any = _ccze_highlight_mark (i + 1 - h->len, i + 1, h->color,
+					  len, any);
+	    }
+	}
+    }
+
+  if (hl_re)
+    {
+      int from = 0, rc;
+
+      while (from <= (int)len &&
+	     (rc = pcre_exec (hl_re, hl_hints, text, (int)len, from, 0,
+			      hl_ovec, hl_ovecsize)) >= 0)
+	{
+	  for (i = 0; i < npatterns; i++)
+	    {
+	      int g = patterns[i].group;
+
+	      if (g && g < rc && hl_ovec[g * 2] >= 0 &&
+		  hl_ovec[g * 2 + 1] > hl_ovec[g * 2])
+		{
+		  any = _ccze_highlight_mark (hl_ovec[g * 2], hl_ovec[g * 2 + 1],
+					      patterns[i].color, len, any);
+		  break;
+		}
+	    }
+	  from = (hl_ovec[1] > hl_ovec[0]) ? hl_ovec[1] : hl_ovec[1] + 1;
+	}
+    }
+
+  for (i = 0; i < npatterns; i++)
+    {
+      int from = 0;
+
+      if (!patterns[i].re)
+	continue;
+      while (from <= (int)len &&
+	     pcre_exec (patterns[i].re, patterns[i].hints, text, (int)len,
+			from, 0, hl_ovec, hl_ovecsize) >= 0)
+	{
+	  if (hl_ovec[1] > hl_ovec[0])
+	    any = _ccze_highlight_mark (hl_ovec[0], hl_ovec[1],
+					patterns[i].color, len, any);
+	  from = (hl_ovec[1] > hl_ovec[0]) ? hl_ovec[1] : hl_ovec[1] + 1;
+	}
+    }
+
+  return (any) ? marks : NULL;
+}
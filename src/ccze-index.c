@@ -0,0 +1,368 @@
+/* -*- mode: c; c-file-style: "gnu" -*-
+ * ccze-index.c -- Sidecar time index and time based seeking
+ * Copyright (C) 2003 Gergely Nagy <algernon@bonehunter.rulez.org>
+ *
+ * This file is part of ccze.
+ *
+ * ccze is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ccze is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include <ccze.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ccze-private.h"
+
+#define CCZE_INDEX_MAGIC "CCZEIDX1"
+#define CCZE_INDEX_SUFFIX ".cczeidx"
+
+/* Lines longer than this are not looked at when probing for dates. */
+#define CCZE_INDEX_PROBE_MAX 4096
+
+/* The index is a header followed by a sorted array of entries, in the
+   byte order of the machine that made it: it is a cache, not an
+   interchange format. HEAD is a hash of the start of the log, so a
+   rotated log is not mistaken for a grown one. */
+typedef struct
+{
+  char magic[8];
+  uint32_t interval;
+  uint32_t pending;
+  uint64_t size;
+  uint64_t lines;
+  uint64_t head;
+  uint64_t nentries;
+} ccze_index_header_t;
+
+typedef struct
+{
+  uint64_t offset;
+  int64_t time;
+} ccze_index_entry_t;
+
+/* Formats tried, in order, by ccze_date_parse(). */
+static const char *date_formats[] = {
+  "%Y-%m-%dT%H:%M:%S",
+  "%Y-%m-%d %H:%M:%S",
+  "%d/%b/%Y:%H:%M:%S",
+  "%a %b %d %H:%M:%S %Y",
+  "%b %d %H:%M:%S",
+  "%Y-%m-%d %H:%M",
+  "%b %d %H:%M",
+  "%Y-%m-%d",
+  "%b %d",
+  "%H:%M:%S",
+  "%H:%M",
+  NULL
+};
+
+/* Parse a date, as found in logs or given on the command line, into
+   local time. Dates without a year are taken to be in the last twelve
+   months, times without a date to be today. Returns -1 if STR is not a
+   date we know. */
+time_t
+ccze_date_parse (const char *str)
+{
+  time_t now = time (NULL), t;
+  struct tm tm, today;
+  const char *p;
+  size_t i;
+
+  while (*str == '[' || isspace ((unsigned char)*str))
+    str++;
+
+  /* Seconds since the epoch, like squid and oops use. */
+  for (p = str; isdigit ((unsigned char)*p); p++)
+    ;
+  if (p - str >= 9 && (*p == '\0' || *p == '.'))
+    return (time_t)atol (str);
+
+  localtime_r (&now, &today);
+  for (i = 0; date_formats[i]; i++)
+    {
+      memset (&tm, 0, sizeof (tm));
+      tm.tm_year = -1;
+      tm.tm_mday = -1;
+      if (!strptime (str, date_formats[i], &tm))
+	continue;
+
+      if (tm.tm_mday == -1)
+	{
+	  tm.tm_mday = today.tm_mday;
+	  tm.tm_mon = today.tm_mon;
+	}
+      if (tm.tm_year == -1)
+	tm.tm_year = today.tm_year;
+      tm.tm_isdst = -1;
+      t = mktime (&tm);
+
+      if (t > now + 86400 && strchr (date_formats[i], 'Y') == NULL)
+	{
+	  tm.tm_year--;
+	  tm.tm_isdst = -1;
+	  t = mktime (&tm);
+	}
+      return t;
+    }
+  return (time_t)-1;
+}
+
+static char *
+_ccze_index_name (const char *fn)
+{
+  char *name;
+
+  asprintf (&name, "%s" CCZE_INDEX_SUFFIX, fn);
+  return name;
+}
+
+static uint64_t
+_ccze_index_head (const char *map, size_t size)
+{
+  uint64_t h = 14695981039346656037ULL;
+  size_t i;
+
+  for (i = 0; i < size && i < 4096; i++)
+    h = (h ^ (unsigned char)map[i]) * 1099511628211ULL;
+  return h;
+}
+
+/* The date of the line at OFF, if it has one we understand. */
+static time_t
+_ccze_index_probe (const char *map, size_t size, size_t off,
+		   size_t *next)
+{
+  static char buf[CCZE_INDEX_PROBE_MAX + 1];
+  const char *eol = memchr (map + off, '\n', size - off);
+  size_t len = (eol) ? (size_t)(eol - map) - off : size - off;
+
+  *next = off + len + 1;
+  if (len > CCZE_INDEX_PROBE_MAX)
+    return (time_t)-1;
+  memcpy (buf, map + off, len);
+  buf[len] = '\0';
+  return ccze_line_date (buf);
+}
+
+/* Load the index of the log FN. Returns NULL if there is none, or if
+   it does not belong to the log as it is now. */
+static ccze_index_header_t *
+_ccze_index_load (const char *fn, const char *map, size_t size,
+		  size_t *maplen)
+{
+  char *name = _ccze_index_name (fn);
+  ccze_index_header_t *idx;
+  struct stat st;
+  int fd;
+
+  fd = open (name, O_RDONLY);
+  free (name);
+  if (fd < 0)
+    return NULL;
+  if (fstat (fd, &st) ||
+      (size_t)st.st_size < sizeof (ccze_index_header_t))
+    {
+      close (fd);
+      return NULL;
+    }
+  idx = (ccze_index_header_t *)mmap (NULL, st.st_size, PROT_READ,
+				     MAP_SHARED, fd, 0);
+  close (fd);
+  if (idx == MAP_FAILED)
+    return NULL;
+
+  if (memcmp (idx->magic, CCZE_INDEX_MAGIC, 8) || idx->size > size ||
+      sizeof (ccze_index_header_t) + idx->nentries *
+      sizeof (ccze_index_entry_t) > (size_t)st.st_size ||
+      idx->head != _ccze_index_head (map, idx->size))
+    {
+      munmap (idx, st.st_size);
+      return NULL;
+    }
+  *maplen = st.st_size;
+  return idx;
+}
+
+/* Build the index of the log FN, with an entry at every INTERVAL-th
+   line (or the first dated one after it), or bring it up to date if
+   the log only grew since. */
+int
+ccze_index_build (const char *fn, size_t interval)
+{
+  ccze_index_header_t hdr, *old;
+  ccze_index_entry_t e;
+  char *name, *map;
+  struct stat st;
+  size_t off, oldlen, next;
+  int fd, ifd;
+
+  if ((fd = open (fn, O_RDONLY)) < 0 || fstat (fd, &st))
+    return -1;
+  if (!st.st_size)
+    {
+      close (fd);
+      return 0;
+    }
+  map = (char *)mmap (NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close (fd);
+  if (map == MAP_FAILED)
+    return -1;
+
+  old = _ccze_index_load (fn, map, st.st_size, &oldlen);
+  if (old && old->interval == interval)
+    {
+      hdr = *old;
+      munmap (old, oldlen);
+    }
+  else
+    {
+      if (old)
+	munmap (old, oldlen);
+      memset (&hdr, 0, sizeof (hdr));
+      memcpy (hdr.magic, CCZE_INDEX_MAGIC, 8);
+      hdr.interval = interval;
+      hdr.pending = 1;
+    }
+  name = _ccze_index_name (fn);
+  ifd = open (name, O_WRONLY | O_CREAT | ((hdr.size) ? 0 : O_TRUNC),
+	      0644);
+  free (name);
+  if (ifd < 0)
+    {
+      munmap (map, st.st_size);
+      return -1;
+    }
+  lseek (ifd, sizeof (hdr) + hdr.nentries * sizeof (e), SEEK_SET);
+
+  /* Only complete lines are indexed: a partial last one is picked up
+     next time. */
+  for (off = hdr.size; off < (size_t)st.st_size; off = next)
+    {
+      const char *eol = memchr (map + off, '\n', st.st_size - off);
+      int sample = hdr.pending || hdr.lines % interval == 0;
+      time_t t = (time_t)-1;
+
+      if (!eol)
+	break;
+      next = eol - map + 1;
+      if (sample)
+	t = _ccze_index_probe (map, st.st_size, off, &next);
+
+      if (t != (time_t)-1)
+	{
+	  e.offset = off;
+	  e.time = t;
+	  write (ifd, &e, sizeof (e));
+	  hdr.nentries++;
+	}
+      hdr.pending = sample && t == (time_t)-1;
+      hdr.lines++;
+      hdr.size = next;
+    }
+
+  hdr.head = _ccze_index_head (map, hdr.size);
+  pwrite (ifd, &hdr, sizeof (hdr), 0);
+  close (ifd);
+  munmap (map, st.st_size);
+  return 0;
+}
+
+/* Without an index: bisect the log itself, probing the first dated
+   line after each midpoint. */
+static size_t
+_ccze_index_bisect (const char *map, size_t size, time_t from)
+{
+  size_t lo = 0, hi = size;
+
+  while (hi - lo > CCZE_INDEX_PROBE_MAX)
+    {
+      size_t mid = lo + (hi - lo) / 2, off, next;
+      const char *eol = memchr (map + mid, '\n', hi - mid);
+      time_t t = (time_t)-1;
+      int tries;
+
+      if (!eol)
+	break;
+      off = eol - map + 1;
+      for (tries = 0; tries < 64 && off < hi && t == (time_t)-1; tries++)
+	{
+	  t = _ccze_index_probe (map, size, off, &next);
+	  off = next;
+	}
+      if (t == (time_t)-1 || t >= from)
+	hi = mid;
+      else
+	lo = mid;
+    }
+
+  /* Start at the beginning of a line. */
+  while (lo > 0 && map[lo - 1] != '\n')
+    lo--;
+  return lo;
+}
+
+/* Find a place in the log open on FD (named FN) from where on reading
+   will not miss any line dated FROM or later. */
+off_t
+ccze_index_seek (const char *fn, int fd, time_t from)
+{
+  ccze_index_header_t *idx;
+  ccze_index_entry_t *entries;
+  struct stat st;
+  size_t lo, hi, off, idxlen;
+  char *map;
+
+  if (fstat (fd, &st) || !S_ISREG (st.st_mode) || !st.st_size)
+    return 0;
+  map = (char *)mmap (NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  if (map == MAP_FAILED)
+    return 0;
+
+  idx = (fn) ? _ccze_index_load (fn, map, st.st_size, &idxlen) : NULL;
+  if (!idx)
+    {
+      off = _ccze_index_bisect (map, st.st_size, from);
+      munmap (map, st.st_size);
+      return (off_t)off;
+    }
+
+  /* The last entry dated before FROM. */
+  entries = (ccze_index_entry_t *)(idx + 1);
+  lo = 0;
+  hi = idx->nentries;
+  while (lo < hi)
+    {
+      size_t mid = lo + (hi - lo) / 2;
+
+      if (entries[mid].time < from)
+	lo = mid + 1;
+      else
+	hi = mid;
+    }
+  off = (lo > 0) ? entries[lo - 1].offset : 0;
+
+  munmap (idx, idxlen);
+  munmap (map, st.st_size);
+  return (off_t)off;
+}
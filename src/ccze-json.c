@@ -0,0 +1,259 @@
+/* -*- mode: c; c-file-style: "gnu" -*-
+ * ccze-json.c -- JSON Lines output
+ * Copyright (C) 2003 Gergely Nagy <algernon@bonehunter.rulez.org>
+ *
+ * This file is part of ccze.
+ *
+ * ccze is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ccze is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include <ccze.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "ccze-private.h"
+
+/* Every line becomes one object:
+
+   {"text":"...","plugin":"syslog","fields":{"date":[0,15],...},
+    "spans":[["date",0,15],["default",15,1],...]}
+
+   The fields and spans are offsets and lengths into "text", which is
+   the line as colorized. "plugin" is null if no plugin recognised the
+   line, and "partial" names the PARTIAL plugin, if one colorized the
+   rest of it too.
+
+   The object is built in a fixed buffer, written out whenever it is
+   full, so nothing is allocated per line. */
+static char out[8192];
+static size_t outlen;
+
+/* The field a color class is reported as, the first time it appears
+   in a line. */
+static const char *field_names[CCZE_COLOR_LAST] = {
+  [CCZE_COLOR_DATE] = "date",
+  [CCZE_COLOR_HOST] = "host",
+  [CCZE_COLOR_PROC] = "proc",
+  [CCZE_COLOR_PID] = "pid",
+  [CCZE_COLOR_USER] = "user",
+  [CCZE_COLOR_IDENT] = "ident",
+  [CCZE_COLOR_EMAIL] = "email",
+  [CCZE_COLOR_SUBJECT] = "subject",
+  [CCZE_COLOR_HTTP_GET] = "method",
+  [CCZE_COLOR_HTTP_POST] = "method",
+  [CCZE_COLOR_HTTP_HEAD] = "method",
+  [CCZE_COLOR_HTTP_PUT] = "method",
+  [CCZE_COLOR_HTTP_CONNECT] = "method",
+  [CCZE_COLOR_HTTP_TRACE] = "method",
+  [CCZE_COLOR_HTTPCODES] = "status",
+  [CCZE_COLOR_FTPCODES] = "status",
+  [CCZE_COLOR_GETSIZE] = "size",
+  [CCZE_COLOR_SIZE] = "size",
+  [CCZE_COLOR_GETTIME] = "time",
+  [CCZE_COLOR_URI] = "uri",
+  [CCZE_COLOR_CTYPE] = "ctype",
+  [CCZE_COLOR_UNIQN] = "id"
+};
+
+static const char *color_names[CCZE_COLOR_LAST];
+
+/* Fields of the same name (the HTTP methods, for one) are only
+   reported once per line too: they share the slot of the first color
+   class with that name. */
+static unsigned char field_slot[CCZE_COLOR_LAST];
+
+static void
+_ccze_json_flush (void)
+{
+  fwrite (out, 1, outlen, ccze_out);
+  outlen = 0;
+}
+
+static inline void
+_ccze_json_putc (char c)
+{
+  if (outlen >= sizeof (out))
+    _ccze_json_flush ();
+  out[outlen++] = c;
+}
+
+static void
+_ccze_json_puts (const char *str, size_t len)
+{
+  while (len > 0)
+    {
+      size_t n = sizeof (out) - outlen;
+
+      if (n == 0)
+	{
+	  _ccze_json_flush ();
+	  n = sizeof (out);
+	}
+      if (n > len)
+	n = len;
+      memcpy (out + outlen, str, n);
+      outlen += n;
+      str += n;
+      len -= n;
+    }
+}
+
+static void
+_ccze_json_number (size_t num)
+{
+  char buf[24];
+  size_t i = sizeof (buf);
+
+  do
+    {
+      buf[--i] = '0' + num % 10;
+      num /= 10;
+    } while (num);
+  _ccze_json_puts (buf + i, sizeof (buf) - i);
+}
+
+/* A string, quoted. Bytes above 0x7f are copied as they are: logs are
+   assumed to be UTF-8. */
+static void
+_ccze_json_string (const char *str, size_t len)
+{
+  static const char hex[] = "0123456789abcdef";
+  size_t i, start = 0;
+
+  _ccze_json_putc ('"');
+  for (i = 0; i < len; i++)
+    {
+      unsigned char c = (unsigned char)str[i];
+
+      if (c >= 0x20 && c != '"' && c != '\\')
+	continue;
+
+      _ccze_json_puts (str + start, i - start);
+      start = i + 1;
+      _ccze_json_putc ('\\');
+      switch (c)
+	{
+	case '"':
+	case '\\':
+	  _ccze_json_putc (c);
+	  break;
+	case '\t':
+	  _ccze_json_putc ('t');
+	  break;
+	case '\r':
+	  _ccze_json_putc ('r');
+	  break;
+	case '\n':
+	  _ccze_json_putc ('n');
+	  break;
+	default:
+	  _ccze_json_puts ("u00", 3);
+	  _ccze_json_putc (hex[c >> 4]);
+	  _ccze_json_putc (hex[c & 0xf]);
+	  break;
+	}
+    }
+  _ccze_json_puts (str + start, len - start);
+  _ccze_json_putc ('"');
+}
+
+static void
+_ccze_json_name (const char *name)
+{
+  if (name)
+    _ccze_json_string (name, strlen (name));
+  else
+    _ccze_json_puts ("null", 4);
+}
+
+void
+ccze_json_line (const char *text, size_t len, const ccze_run_t *runs,
+		size_t nruns)
+{
+  unsigned char seen[CCZE_COLOR_LAST];
+  const char **plugins;
+  size_t i, off;
+  int nplugins, nfields = 0;
+
+  if (!color_names[0])
+    for (i = 0; i < CCZE_COLOR_LAST; i++)
+      {
+	color_names[i] = ccze_color_lookup_name ((ccze_color_t)i);
+	for (field_slot[i] = 0; field_slot[i] < i; field_slot[i]++)
+	  if (field_names[field_slot[i]] == field_names[i])
+	    break;
+      }
+
+  _ccze_json_puts ("{\"text\":", 8);
+  _ccze_json_string (text, len);
+
+  plugins = ccze_plugin_line_handlers (&nplugins);
+  _ccze_json_puts (",\"plugin\":", 10);
+  _ccze_json_name ((nplugins > 0) ? plugins[0] : NULL);
+  if (nplugins > 1)
+    {
+      _ccze_json_puts (",\"partial\":", 11);
+      _ccze_json_name (plugins[1]);
+    }
+
+  memset (seen, 0, sizeof (seen));
+  _ccze_json_puts (",\"fields\":{", 11);
+  for (i = 0, off = 0; i < nruns; off += runs[i++].len)
+    {
+      const char *name = field_names[runs[i].color];
+      size_t flen = runs[i].len, j;
+
+      if (!name || (runs[i].flags & CCZE_RUN_CONT) ||
+	  seen[field_slot[runs[i].color]])
+	continue;
+      seen[field_slot[runs[i].color]] = 1;
+
+      for (j = i + 1; j < nruns && (runs[j].flags & CCZE_RUN_CONT); j++)
+	flen += runs[j].len;
+      /* Without the colon syslog may put after the process. */
+      if (runs[i].color == CCZE_COLOR_PROC && flen > 1 &&
+	  text[off + flen - 1] == ':')
+	flen--;
+      if (nfields++)
+	_ccze_json_putc (',');
+      _ccze_json_name (name);
+      _ccze_json_puts (":[", 2);
+      _ccze_json_number (off);
+      _ccze_json_putc (',');
+      _ccze_json_number (flen);
+      _ccze_json_putc (']');
+    }
+
+  _ccze_json_puts ("},\"spans\":[", 11);
+  for (i = 0, off = 0; i < nruns; i++)
+    {
+      size_t slen = runs[i].len, first = i;
+
+      while (i + 1 < nruns && (runs[i + 1].flags & CCZE_RUN_CONT))
+	slen += runs[++i].len;
+      if (first)
+	_ccze_json_putc (',');
+      _ccze_json_putc ('[');
+      _ccze_json_name (color_names[runs[first].color]);
+      _ccze_json_putc (',');
+      _ccze_json_number (off);
+      _ccze_json_putc (',');
+      _ccze_json_number (slen);
+      _ccze_json_putc (']');
+      off += slen;
+    }
+  _ccze_json_puts ("]}\n", 3);
+  _ccze_json_flush ();
+}
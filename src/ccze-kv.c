@@ -0,0 +1,308 @@
+/* -*- mode: c; c-file-style: "gnu" -*-
+ * ccze-kv.c -- Key=value pairs
+ * Copyright (C) 2003 Gergely Nagy <algernon@bonehunter.rulez.org>
+ *
+ * This file is part of ccze.
+ *
+ * ccze is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ccze is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+
+#include <ccze.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "ccze-private.h"
+
+/* Plugins coloring key=value lists - netfilter's, postfix's, logfmt -
+   split them with ccze_kv_next(), which cuts the string it is given
+   into pairs in place, and add them with ccze_kv_add(). Values of the
+   keys below are known to be of a kind, and the commonest kinds of
+   values - empty ones, numbers and hex numbers - are recognised right
+   away, so only the rest goes through the word coloriser. */
+typedef enum
+{
+  CCZE_KV_HOST,
+  CCZE_KV_NUMBER,
+  CCZE_KV_MAC,
+  CCZE_KV_PROTO,
+  CCZE_KV_IFACE,
+  CCZE_KV_STATUS
+} ccze_kv_kind_t;
+
+static const struct
+{
+  const char *key;
+  ccze_kv_kind_t kind;
+} kv_hints[] = {
+  {"SRC", CCZE_KV_HOST}, {"DST", CCZE_KV_HOST},
+  {"SPT", CCZE_KV_NUMBER}, {"DPT", CCZE_KV_NUMBER},
+  {"LEN", CCZE_KV_NUMBER}, {"TTL", CCZE_KV_NUMBER},
+  {"ID", CCZE_KV_NUMBER}, {"WINDOW", CCZE_KV_NUMBER},
+  {"URGP", CCZE_KV_NUMBER}, {"MAC", CCZE_KV_MAC},
+  {"PROTO", CCZE_KV_PROTO}, {"IN", CCZE_KV_IFACE},
+  {"OUT", CCZE_KV_IFACE}, {"status", CCZE_KV_STATUS}
+};
+
+#define KV_DIGIT(c) ((c) >= '0' && (c) <= '9')
+#define KV_HEX(c) (KV_DIGIT (c) || ((c) >= 'a' && (c) <= 'f') || \
+		   ((c) >= 'A' && (c) <= 'F'))
+#define KV_ALPHA(c) (((c) >= 'a' && (c) <= 'z') || ((c) >= 'A' && (c) <= 'Z'))
+
+/* Cut the pair at STR, which ends at DELIM or the end of the string,
+   into KV: KEY is what comes before the first '=', VALUE what comes
+   after it, or NULL if there is no '='. A value in double quotes,
+   with backslash escapes, may have DELIM in it; KV->quoted is set
+   then, and VALUE is what is between the quotes. Returns the start of
+   the next pair, or NULL if this was the last one. */
+char *
+ccze_kv_next (char *str, char delim, ccze_kv_t *kv)
+{
+  char *p, *q;
+
+  kv->key = str;
+  kv->value = NULL;
+  kv->quoted = 0;
+
+  for (p = str; *p && *p != delim && *p != '='; p++)
+    ;
+  if (*p == '=' && p[1] == '"')
+    {
+      for (q = p + 2; *q && *q != '"'; q++)
+	if (*q == '\\' && q[1])
+	  q++;
+      if (*q == '"' && (q[1] == delim || q[1] == '\0'))
+	{
+	  *p = '\0';
+	  kv->value = p + 2;
+	  kv->quoted = 1;
+	  *q = '\0';
+	  return (q[1]) ? q + 2 : NULL;
+	}
+    }
+  if (*p == '=')
+    {
+      *p = '\0';
+      kv->value = ++p;
+      while (*p && *p != delim)
+	p++;
+    }
+
+  if (!*p)
+    return NULL;
+  *p = '\0';
+  return p + 1;
+}
+
+static int
+_ccze_kv_match (const char *str, int (*pred) (char c))
+{
+  if (!*str)
+    return 0;
+  for (; *str; str++)
+    if (!pred (*str))
+      return 0;
+  return 1;
+}
+
+static int
+_ccze_kv_is_digit (char c)
+{
+  return KV_DIGIT (c);
+}
+
+static int
+_ccze_kv_is_alpha (char c)
+{
+  return KV_ALPHA (c);
+}
+
+/* A dotted quad, as the word coloriser takes it. */
+static int
+_ccze_kv_is_ipv4 (const char *str)
+{
+  int i, n;
+
+  for (i = 0; i < 4; i++)
+    {
+      for (n = 0; n < 4 && KV_DIGIT (str[n]); n++)
+	;
+      if (n == 0 || n == 4 || str[n] != ((i < 3) ? '.' : '\0'))
+	return 0;
+      str += n + 1;
+    }
+  return 1;
+}
+
+/* Colon separated hex bytes: six of them for an ethernet address,
+   more for the link layer header netfilter logs. */
+static int
+_ccze_kv_is_mac (const char *str)
+{
+  int n = 0;
+
+  for (;;)
+    {
+      if (!KV_HEX (str[0]) || !KV_HEX (str[1]))
+	return 0;
+      n++;
+      if (str[2] == '\0')
+	return (n >= 6);
+      if (str[2] != ':')
+	return 0;
+      str += 3;
+    }
+}
+
+static ccze_color_t
+_ccze_kv_status (const char *str, size_t len)
+{
+  if (len == 4 && !strncmp (str, "sent", 4))
+    return CCZE_COLOR_GOODWORD;
+  if (len == 8 && !strncmp (str, "deferred", 8))
+    return CCZE_COLOR_WARNING;
+  if ((len == 7 && (!strncmp (str, "bounced", 7) ||
+		    !strncmp (str, "expired", 7))) ||
+      (len == 13 && !strncmp (str, "undeliverable", 13)))
+    return CCZE_COLOR_BADWORD;
+  return CCZE_COLOR_LAST;
+}
+
+/* Add the single word VALUE, in the color the word coloriser would
+   give it. */
+static void
+_ccze_kv_word (char *value, int slookup)
+{
+  const char *p = value;
+
+  if (*p == '-')
+    p++;
+  if (!*value)
+    ccze_addstr (CCZE_COLOR_DEFAULT, value);
+  else if (_ccze_kv_match (p, _ccze_kv_is_digit))
+    ccze_addstr (CCZE_COLOR_NUMBERS, value);
+  else if (value[0] == '0' && (value[1] == 'x' || value[1] == 'X') &&
+	   value[2] && strspn (value + 2, "0123456789abcdefABCDEF") ==
+	   strlen (value + 2))
+    ccze_addstr (CCZE_COLOR_ADDRESS, value);
+  else
+    ccze_wordcolor_process_one (strdup (value), slookup);
+}
+
+/* Add the words in VALUE, with the spaces between them. */
+static void
+_ccze_kv_words (char *value, int slookup)
+{
+  char *end, save;
+
+  while (*value)
+    {
+      if (*value == ' ')
+	{
+	  ccze_space ();
+	  value++;
+	  continue;
+	}
+      for (end = value; *end && *end != ' '; end++)
+	;
+      save = *end;
+      *end = '\0';
+      _ccze_kv_word (value, slookup);
+      *end = save;
+      value = end;
+    }
+}
+
+/* Add the value of KEY, if KEY is known, and VALUE is of the kind
+   expected. Returns non-zero if it was added. */
+static int
+_ccze_kv_hinted (const char *key, char *value, int slookup)
+{
+  ccze_color_t col;
+  size_t i, len;
+
+  while (*key == ' ')
+    key++;
+  for (i = 0; i < sizeof (kv_hints) / sizeof (kv_hints[0]); i++)
+    if (kv_hints[i].key[0] == key[0] && !strcmp (kv_hints[i].key, key))
+      break;
+  if (i == sizeof (kv_hints) / sizeof (kv_hints[0]))
+    return 0;
+
+  switch (kv_hints[i].kind)
+    {
+    case CCZE_KV_HOST:
+      if (!_ccze_kv_is_ipv4 (value))
+	return 0;
+      ccze_addstr (CCZE_COLOR_HOST, value);
+      return 1;
+    case CCZE_KV_NUMBER:
+      if (!_ccze_kv_match (value, _ccze_kv_is_digit))
+	return 0;
+      ccze_addstr (CCZE_COLOR_NUMBERS, value);
+      return 1;
+    case CCZE_KV_MAC:
+      if (!_ccze_kv_is_mac (value))
+	return 0;
+      ccze_addstr (CCZE_COLOR_MAC, value);
+      return 1;
+    case CCZE_KV_PROTO:
+      if (!_ccze_kv_match (value, _ccze_kv_is_alpha))
+	return 0;
+      ccze_addstr (CCZE_COLOR_PROT, value);
+      return 1;
+    case CCZE_KV_IFACE:
+      /* Not a service, protocol or user name, however it looks. */
+      _ccze_kv_word (value, 0);
+      return 1;
+    case CCZE_KV_STATUS:
+      /* postfix's status=sent (250 2.0.0 Ok: queued as ...) */
+      len = strcspn (value, " ");
+      if ((col = _ccze_kv_status (value, len)) == CCZE_COLOR_LAST)
+	return 0;
+      if (value[len])
+	{
+	  value[len] = '\0';
+	  ccze_addstr (col, value);
+	  value[len] = ' ';
+	  _ccze_kv_words (value + len, slookup);
+	}
+      else
+	ccze_addstr (col, value);
+      return 1;
+    }
+  return 0;
+}
+
+/* Add the pair in KV: the key as a field name, and the value colored
+   by what it is. SLOOKUP is passed on to the word coloriser. */
+void
+ccze_kv_add (const ccze_kv_t *kv, int slookup)
+{
+  ccze_addstr (CCZE_COLOR_FIELD, kv->key);
+  if (!kv->value)
+    return;
+  ccze_addstr (CCZE_COLOR_DEFAULT, "=");
+
+  if (kv->quoted)
+    {
+      ccze_addstr (CCZE_COLOR_DEFAULT, "\"");
+      if (!_ccze_kv_hinted (kv->key, kv->value, slookup))
+	_ccze_kv_words (kv->value, slookup);
+      ccze_addstr (CCZE_COLOR_DEFAULT, "\"");
+    }
+  else if (!_ccze_kv_hinted (kv->key, kv->value, slookup))
+    _ccze_kv_word (kv->value, slookup);
+}
@@ -0,0 +1,690 @@
+/* -*- mode: c; c-file-style: "gnu" -*-
+ * ccze-lib.c -- The line pipeline, and libccze contexts around it
+ * Copyright (C) 2003 Gergely Nagy <algernon@bonehunter.rulez.org>
+ *
+ * This file is part of ccze.
+ *
+ * ccze is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ccze is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include <ccze.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ccze-private.h"
+#include "ccze-compat.h"
+#include "libccze.h"
+
+ccze_config_t ccze_config = {
+  .scroll = 1,
+  .convdate = 0,
+  .remfac = 0,
+  .wcol = 1,
+  .slookup = 1,
+  .rcfile = NULL,
+  .cssfile = NULL,
+  .transparent = 1,
+  .scrollback = 4 * 1024 * 1024,
+  .collapse = 0,
+  .collapse_time = 10,
+  .infile = NULL,
+  .index_interval = 0,
+  .from = (time_t)-1,
+  .to = (time_t)-1,
+  .summary_bucket = 3600,
+  .jobs = 1,
+  .pluginlist_len = 0,
+  .pluginlist_alloc = 10,
+  .color_argv_len = 0,
+  .color_argv_alloc = 10,
+  .mode = CCZE_MODE_CURSES
+};
+
+/* Set while ccze_line_date() runs the plugins over a line only to find
+   out its date. */
+static int date_probe = 0;
+static time_t date_probe_time;
+
+static char *_strbrk_string;
+static size_t _strbrk_string_len;
+
+char *
+ccze_strbrk (char *str, char delim)
+{
+  char *found;
+      
+  if (str)
+    {
+      _strbrk_string = str;
+      _strbrk_string_len = strlen (str);
+      found = str;
+    }
+  else
+    found = _strbrk_string + 1;
+  
+  if (!_strbrk_string_len)
+    return NULL;
+  while (_strbrk_string_len >= 1 &&
+	 *_strbrk_string != delim)
+    {
+      _strbrk_string++;
+      _strbrk_string_len--;
+    }
+  if (_strbrk_string_len > 0)
+    *_strbrk_string = '\0';
+  return found;
+}
+
+char *
+xstrdup (const char *str)
+{
+  if (!str)
+    return NULL;
+  else
+    return strdup (str);
+}
+
+/* The HTTP methods, in the "http" color map, that the rc files can
+   add PATCH, DELETE and the rest to. */
+ccze_color_t
+ccze_http_action (const char *method)
+{
+  static ccze_colormap_t *methods;
+
+  if (!methods)
+    {
+      methods = ccze_colormap_new ("http", 1, NULL);
+      ccze_colormap_add (methods, "GET", CCZE_COLOR_HTTP_GET);
+      ccze_colormap_add (methods, "POST", CCZE_COLOR_HTTP_POST);
+      ccze_colormap_add (methods, "HEAD", CCZE_COLOR_HTTP_HEAD);
+      ccze_colormap_add (methods, "PUT", CCZE_COLOR_HTTP_PUT);
+      ccze_colormap_add (methods, "CONNECT", CCZE_COLOR_HTTP_CONNECT);
+      ccze_colormap_add (methods, "TRACE", CCZE_COLOR_HTTP_TRACE);
+    }
+  return ccze_colormap_lookup (methods, method);
+}
+
+/* Lines next to each other are mostly from the same second, or at
+   least from the same minute, so the last date converted is kept:
+   for the same second it is used again, for the same minute only the
+   seconds are written over it, and only a new minute costs a
+   gmtime() and a strftime(). With -o localtime, the time is moved by
+   the UTC offset first, which is looked up once for every quarter of
+   an hour, as no zone changes its offset in between. */
+static struct
+{
+  time_t second, minute;
+  time_t quarter;
+  long offset;
+  char text[64];
+} convdate_cache = {-1, -1, -1, 0, ""};
+
+static const char *
+_ccze_convdate (time_t ltime)
+{
+  struct tm tm;
+  time_t t = ltime;
+
+  if (ccze_config.localdate)
+    {
+      if (ltime / 900 != convdate_cache.quarter)
+	{
+	  localtime_r (&ltime, &tm);
+	  convdate_cache.offset = tm.tm_gmtoff;
+	  convdate_cache.quarter = ltime / 900;
+	}
+      t += convdate_cache.offset;
+    }
+
+  if (t == convdate_cache.second)
+    return convdate_cache.text;
+  if (t >= 0 && t / 60 == convdate_cache.minute)
+    {
+      /* "%b %e %T" ends with the seconds. */
+      size_t len = strlen (convdate_cache.text);
+
+      convdate_cache.text[len - 2] = '0' + (t % 60) / 10;
+      convdate_cache.text[len - 1] = '0' + t % 10;
+    }
+  else
+    {
+      gmtime_r (&t, &tm);
+      strftime (convdate_cache.text, sizeof (convdate_cache.text), "%b %e %T", &tm);
+      convdate_cache.minute = (t >= 0) ? t / 60 : -1;
+    }
+  convdate_cache.second = t;
+  return convdate_cache.text;
+}
+
+void
+ccze_print_date (const char *date)
+{
+  time_t ltime;
+  char *end, tmp[128];
+
+  if (ccze_config.convdate)
+    {
+      /* The time filter wants the date as it was logged. */
+      ccze_filter_token (CCZE_COLOR_DATE, date);
+      ltime = strtol (date, &end, 10);
+      if (ltime < 0)
+	{
+	  ccze_addstr (CCZE_COLOR_DATE, date);
+	  return;
+	}
+      /* Squid logs the milliseconds too, those are kept. */
+      if (end[0] == '.' && end[1] >= '0' && end[1] <= '9' &&
+	  strspn (end + 1, "0123456789") == strlen (end + 1))
+	{
+	  snprintf (tmp, sizeof (tmp), "%s%s", _ccze_convdate (ltime), end);
+	  ccze_addstr (CCZE_COLOR_DATE, tmp);
+	}
+      else
+	ccze_addstr (CCZE_COLOR_DATE, _ccze_convdate (ltime));
+    }
+  else
+    ccze_addstr (CCZE_COLOR_DATE, date);
+}
+
+/* The priority in the "<NN>" syslog may put before a message at STR,
+   or -1 if there is none there. *LEN is set to its length. */
+int
+ccze_syslog_pri (const char *str, size_t *len)
+{
+  int pri = 0;
+  size_t i;
+
+  if (str[0] != '<')
+    return -1;
+  for (i = 1; i <= 3 && str[i] >= '0' && str[i] <= '9'; i++)
+    pri = pri * 10 + str[i] - '0';
+  if (i == 1 || str[i] != '>' || pri > 191)
+    return -1;
+  *len = i + 1;
+  return pri;
+}
+
+void
+ccze_newline (void)
+{
+  const char *plugin = ccze_plugin_name_get ();
+
+  if (date_probe)
+    {
+      ccze_line_reset ();
+      return;
+    }
+
+  /* Plugins handling the whole line end it themselves, before they
+     return. */
+  if (plugin)
+    {
+      ccze_filter_handled (plugin);
+      ccze_plugin_line_handled (plugin);
+    }
+
+  if (!ccze_filter_accept ())
+    {
+      ccze_line_reset ();
+      return;
+    }
+
+  if (ccze_config.mailq)
+    ccze_mailq_line (ccze_line_current ());
+  if (ccze_config.collapse &&
+      ccze_collapse_line (ccze_line_current ()))
+    ccze_line_reset ();
+  else
+    ccze_line_flush ();
+  if (ccze_config.mailq)
+    ccze_mailq_flush ();
+}
+
+void
+ccze_addstr (ccze_color_t col, const char *str)
+{
+  if (!str || ccze_filter_rejected ())
+    return;
+  if (date_probe)
+    {
+      if (col == CCZE_COLOR_DATE && date_probe_time == (time_t)-1)
+	date_probe_time = ccze_date_parse (str);
+      return;
+    }
+  ccze_filter_token (col, str);
+  ccze_line_add (col, str, strlen (str), 0);
+}
+
+void
+ccze_space (void)
+{
+  if (date_probe || ccze_filter_rejected ())
+    return;
+  ccze_line_add (CCZE_COLOR_DEFAULT, " ", 1, CCZE_RUN_NBSP);
+}
+
+/* The date of LINE, as found by the FULL plugins, or -1 if they did
+   not find one. LINE may be modified. */
+time_t
+ccze_line_date (char *line)
+{
+  int handled = 0, status = 0, convdate = ccze_config.convdate;
+  char *rest = NULL;
+  size_t prilen;
+
+  if (ccze_config.remfac && ccze_syslog_pri (line, &prilen) >= 0)
+    line += prilen;
+
+  date_probe = 1;
+  date_probe_time = (time_t)-1;
+  ccze_config.convdate = 0;
+  ccze_plugin_run (ccze_plugins (), line, strlen (line), &rest,
+		   CCZE_PLUGIN_TYPE_FULL, &handled, &status);
+  ccze_config.convdate = convdate;
+  date_probe = 0;
+
+  free (rest);
+  ccze_line_reset ();
+  return date_probe_time;
+}
+
+/* Colorize one line. SUBJECT may be modified. */
+void
+ccze_process_line (ccze_plugin_t **plugins, char *subject)
+{
+  int handled = 0;
+  int status = 0;
+  char *rest = NULL, *rest2 = NULL;
+  size_t subjlen, prilen;
+
+  if (ccze_config.remfac && ccze_syslog_pri (subject, &prilen) >= 0)
+    subject += prilen;
+
+  ccze_filter_start ();
+  ccze_plugin_line_start ();
+
+  subjlen = strlen (subject);
+  /* A line continuing a record is only wordcolored, and shown if the
+     start of the record was. */
+  if (ccze_record_continues (subject, subjlen))
+    {
+      ccze_filter_continue (ccze_record_shown ());
+      ccze_wordcolor_process (subject, ccze_config.wcol,
+			      ccze_config.slookup);
+      ccze_newline ();
+      return;
+    }
+
+  ccze_plugin_run (plugins, subject, subjlen, &rest,
+		   CCZE_PLUGIN_TYPE_FULL, &handled, &status);
+
+  /* The host and the process can only come from a FULL plugin, so a
+     line not matching those filters can be dropped right here, before
+     wordcoloring the rest of it. */
+  if (status == 0)
+    ccze_filter_check (CCZE_FILTER_HOST | CCZE_FILTER_PROCESS |
+		       CCZE_FILTER_TIME | CCZE_FILTER_PLUGIN);
+  else
+    ccze_filter_check (CCZE_FILTER_HOST | CCZE_FILTER_PROCESS |
+		       CCZE_FILTER_TIME |
+		       ((rest) ? 0 : CCZE_FILTER_PLUGIN));
+
+  if (rest)
+    {
+      handled = 0;
+      if (!ccze_filter_rejected ())
+	{
+	  ccze_plugin_run (plugins, rest, strlen (rest), &rest2,
+			   CCZE_PLUGIN_TYPE_PARTIAL, &handled, &status);
+	  ccze_filter_check (CCZE_FILTER_PLUGIN);
+	}
+      if (handled == 0)
+	ccze_wordcolor_process (rest, ccze_config.wcol,
+				ccze_config.slookup);
+      else
+	ccze_wordcolor_process (rest2, ccze_config.wcol,
+				ccze_config.slookup);
+      ccze_newline ();
+      free (rest);
+      free (rest2);
+    }
+
+  if (status == 0)
+    {
+      ccze_wordcolor_process (subject, ccze_config.wcol,
+			      ccze_config.slookup);
+      ccze_newline ();
+    }
+  ccze_record_start ();
+}
+
+/* Read RCFILE, or if it is NULL, the system-wide and the user's rc
+   files - or what they came to last time, if none of them changed
+   since. */
+void
+ccze_rc_load (const char *rcfile)
+{
+  const char *files[4];
+  char *home = getenv ("HOME"), *homerc[2] = {NULL, NULL};
+  size_t first;
+  int nfiles = 0, i;
+
+  if (rcfile)
+    files[nfiles++] = rcfile;
+  else
+    {
+      files[nfiles++] = SYSCONFDIR "/colorizerc";
+      files[nfiles++] = SYSCONFDIR "/cczerc";
+      if (home)
+	{
+	  asprintf (&homerc[0], "%s/.colorizerc", home);
+	  asprintf (&homerc[1], "%s/.cczerc", home);
+	  files[nfiles++] = homerc[0];
+	  files[nfiles++] = homerc[1];
+	}
+    }
+
+  ccze_colormap_user_reset ();
+  if (ccze_rccache_load (files, nfiles))
+    {
+      first = ccze_highlight_count ();
+      for (i = 0; i < nfiles; i++)
+	ccze_color_load (files[i]);
+      ccze_rccache_save (files, nfiles, first);
+    }
+
+  free (homerc[0]);
+  free (homerc[1]);
+}
+
+/* The engine underneath is a single one, with its settings in
+   ccze_config and its output going to ccze_out. A context brings its
+   own settings along, the colors of its rc file, and the record the
+   lines it was given last may be continuing; when a context other
+   than the last one is used, those are swapped in. The colors are
+   only changed if they are not the ones already there, and the rc
+   file is only read again if it is not the one read last: the colors
+   it gave for each output are kept, for contexts asking for different
+   outputs to take turns without reading it every time. The
+   output goes through a stream of the context's own, which hands
+   whatever is written to it to the sink of the call in progress. */
+struct ccze_ctx
+{
+  ccze_ctx_config_t config;
+  char *rcfile;
+  ccze_record_state_t record;
+  char *partial;
+  size_t partial_len, partial_alloc;
+  FILE *out;
+  ccze_sink_t sink;
+  void *data;
+};
+
+static ccze_ctx_t *ctx_active = NULL;
+static int ctx_count = 0;
+
+static struct
+{
+  int loaded;
+  char *rcfile;
+  ccze_output_t output;
+  int transparent;
+  ccze_color_snapshot_t *prebuilt[CCZE_OUTPUT_JSON + 1];
+} ctx_colors;
+
+void
+ccze_ctx_config_init (ccze_ctx_config_t *config)
+{
+  config->output = CCZE_OUTPUT_ANSI;
+  config->rcfile = NULL;
+  config->wordcolor = 1;
+  config->lookups = 1;
+  config->convdate = 0;
+  config->remfac = 0;
+  config->transparent = 1;
+  config->hashcolor = 0;
+}
+
+static ssize_t
+_ccze_ctx_write (void *cookie, const char *buf, size_t len)
+{
+  ccze_ctx_t *ctx = (ccze_ctx_t *)cookie;
+
+  if (ctx->sink)
+    (*ctx->sink) (buf, len, ctx->data);
+  return len;
+}
+
+static void
+_ccze_ctx_colors_forget (void)
+{
+  int i;
+
+  for (i = 0; i <= CCZE_OUTPUT_JSON; i++)
+    {
+      free (ctx_colors.prebuilt[i]);
+      ctx_colors.prebuilt[i] = NULL;
+    }
+  free (ctx_colors.rcfile);
+  ctx_colors.rcfile = NULL;
+  ctx_colors.loaded = 0;
+}
+
+static void
+_ccze_ctx_engine_start (void)
+{
+  ccze_line_init ();
+  ccze_plugin_argv_init ();
+  ccze_plugin_init ();
+  ccze_wordcolor_setup ();
+  ccze_plugin_load_all ();
+  ccze_plugin_load_all_builtins ();
+  ccze_plugin_finalise ();
+  ccze_plugin_argv_finalise ();
+  ccze_plugin_setup ();
+}
+
+static void
+_ccze_ctx_engine_stop (void)
+{
+  ccze_wordcolor_shutdown ();
+  ccze_highlight_shutdown ();
+  ccze_plugin_shutdown ();
+  ccze_line_shutdown ();
+  ccze_mailq_shutdown ();
+  _ccze_ctx_colors_forget ();
+}
+
+/* Whether CTX reads the rc file the colors were last read from. */
+static int
+_ccze_ctx_same_rcfile (const ccze_ctx_t *ctx)
+{
+  if (!ctx_colors.loaded)
+    return 0;
+  if (!ctx_colors.rcfile || !ctx->rcfile)
+    return (ctx_colors.rcfile == ctx->rcfile);
+  return !strcmp (ctx_colors.rcfile, ctx->rcfile);
+}
+
+/* Set the colors up for CTX; ccze_config has to be set for it. */
+static void
+_ccze_ctx_colors (ccze_ctx_t *ctx)
+{
+  ccze_output_t output = ctx->config.output;
+  ccze_color_snapshot_t **prebuilt = &ctx_colors.prebuilt[output];
+
+  if (_ccze_ctx_same_rcfile (ctx))
+    {
+      if (ctx_colors.output == output &&
+	  ctx_colors.transparent == ctx->config.transparent)
+	return;
+      if (*prebuilt)
+	{
+	  ccze_color_init ();
+	  ccze_color_restore (*prebuilt);
+	}
+    }
+  else
+    _ccze_ctx_colors_forget ();
+
+  if (!*prebuilt)
+    {
+      ccze_highlight_shutdown ();
+      ccze_color_init ();
+      ccze_rc_load (ctx->rcfile);
+      ccze_highlight_setup ();
+
+      *prebuilt = (ccze_color_snapshot_t *)
+	ccze_malloc (sizeof (ccze_color_snapshot_t));
+      if (ccze_color_snapshot (*prebuilt))
+	{
+	  free (*prebuilt);
+	  *prebuilt = NULL;
+	}
+    }
+  ccze_hashcolor_reset ();
+
+  if (!ctx_colors.loaded)
+    ctx_colors.rcfile = xstrdup (ctx->rcfile);
+  ctx_colors.loaded = 1;
+  ctx_colors.output = output;
+  ctx_colors.transparent = ctx->config.transparent;
+}
+
+static void
+_ccze_ctx_activate (ccze_ctx_t *ctx)
+{
+  static const ccze_mode_t modes[] = {
+    [CCZE_OUTPUT_ANSI] = CCZE_MODE_RAW_ANSI,
+    [CCZE_OUTPUT_HTML] = CCZE_MODE_HTML,
+    [CCZE_OUTPUT_DEBUG] = CCZE_MODE_DEBUG,
+    [CCZE_OUTPUT_JSON] = CCZE_MODE_JSON
+  };
+
+  if (ctx_active == ctx)
+    return;
+  if (ctx_active)
+    ccze_record_save (&ctx_active->record);
+
+  ccze_config.mode = modes[ctx->config.output];
+  ccze_config.wcol = ctx->config.wordcolor;
+  ccze_config.slookup = ctx->config.lookups;
+  ccze_config.convdate = ctx->config.convdate;
+  ccze_config.remfac = ctx->config.remfac;
+  ccze_config.transparent = ctx->config.transparent;
+  ccze_config.hashcolor = ctx->config.hashcolor;
+  ccze_config.collapse = 0;
+
+  _ccze_ctx_colors (ctx);
+  ccze_record_restore (&ctx->record);
+  ctx_active = ctx;
+}
+
+ccze_ctx_t *
+ccze_ctx_new (const ccze_ctx_config_t *config)
+{
+  cookie_io_functions_t io = {NULL, _ccze_ctx_write, NULL, NULL};
+  ccze_ctx_t *ctx = (ccze_ctx_t *)ccze_calloc (1, sizeof (ccze_ctx_t));
+
+  if (config)
+    ctx->config = *config;
+  else
+    ccze_ctx_config_init (&ctx->config);
+  if ((unsigned int)ctx->config.output > CCZE_OUTPUT_JSON ||
+      !(ctx->out = fopencookie (ctx, "w", io)))
+    {
+      free (ctx);
+      return NULL;
+    }
+  ctx->config.rcfile = ctx->rcfile = xstrdup (ctx->config.rcfile);
+  ctx->partial_alloc = 1024;
+  ctx->partial = (char *)ccze_malloc (ctx->partial_alloc);
+
+  if (ctx_count++ == 0)
+    _ccze_ctx_engine_start ();
+  return ctx;
+}
+
+void
+ccze_ctx_free (ccze_ctx_t *ctx)
+{
+  if (!ctx)
+    return;
+
+  ctx->sink = NULL;
+  fclose (ctx->out);
+  free (ctx->rcfile);
+  free (ctx->partial);
+  if (ctx_active == ctx)
+    ctx_active = NULL;
+  free (ctx);
+
+  if (--ctx_count == 0)
+    _ccze_ctx_engine_stop ();
+}
+
+static void
+_ccze_ctx_append (ccze_ctx_t *ctx, const char *str, size_t len)
+{
+  if (ctx->partial_len + len + 1 > ctx->partial_alloc)
+    {
+      while (ctx->partial_len + len + 1 > ctx->partial_alloc)
+	ctx->partial_alloc *= 2;
+      ctx->partial = (char *)ccze_realloc (ctx->partial, ctx->partial_alloc);
+    }
+  memcpy (ctx->partial + ctx->partial_len, str, len);
+  ctx->partial_len += len;
+  ctx->partial[ctx->partial_len] = '\0';
+}
+
+int
+ccze_colorize (ccze_ctx_t *ctx, const char *in, size_t len,
+	       ccze_sink_t sink, void *data)
+{
+  FILE *saved = ccze_out;
+  const char *nl;
+  int lines = 0;
+
+  _ccze_ctx_activate (ctx);
+  ctx->sink = sink;
+  ctx->data = data;
+  ccze_out = ctx->out;
+
+  while ((nl = (const char *)memchr (in, '\n', len)) != NULL)
+    {
+      _ccze_ctx_append (ctx, in, nl - in);
+      ccze_process_line (ccze_plugins (), ctx->partial);
+      ctx->partial_len = 0;
+      len -= nl - in + 1;
+      in = nl + 1;
+      lines++;
+    }
+  _ccze_ctx_append (ctx, in, len);
+
+  fflush (ctx->out);
+  ccze_out = saved;
+  ctx->sink = NULL;
+  return lines;
+}
+
+int
+ccze_ctx_flush (ccze_ctx_t *ctx, ccze_sink_t sink, void *data)
+{
+  if (!ctx->partial_len)
+    return 0;
+  return ccze_colorize (ctx, "\n", 1, sink, data);
+}
@@ -0,0 +1,219 @@
+/* -*- mode: c; c-file-style: "gnu" -*-
+ * ccze-line.c -- Line accumulator and output backends
+ * Copyright (C) 2003 Gergely Nagy <algernon@bonehunter.rulez.org>
+ *
+ * This file is part of ccze.
+ *
+ * ccze is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ccze is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include <ccze.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ccze-private.h"
+
+/* Everything ccze_addstr() produces ends up here first, and only
+   leaves when the line is finished. This way every output backend -
+   and the curses scrollback - sees whole lines as text plus a list of
+   color runs. */
+static ccze_line_t line;
+
+/* Spare run list, for re-splitting the runs of a highlighted line. */
+static ccze_run_t *hl_runs;
+static size_t hl_runs_alloc;
+
+void
+ccze_line_init (void)
+{
+  line.alloc = 256;
+  line.len = 0;
+  line.text = (char *)ccze_malloc (line.alloc);
+  line.text[0] = '\0';
+  line.runs_alloc = 32;
+  line.nruns = 0;
+  line.runs = (ccze_run_t *)ccze_calloc (line.runs_alloc,
+					 sizeof (ccze_run_t));
+}
+
+void
+ccze_line_shutdown (void)
+{
+  free (line.text);
+  free (line.runs);
+  free (hl_runs);
+  line.text = NULL;
+  line.runs = NULL;
+  hl_runs = NULL;
+  hl_runs_alloc = 0;
+  line.len = line.alloc = line.nruns = line.runs_alloc = 0;
+}
+
+ccze_line_t *
+ccze_line_current (void)
+{
+  return &line;
+}
+
+void
+ccze_line_reset (void)
+{
+  line.len = 0;
+  line.nruns = 0;
+  if (line.text)
+    line.text[0] = '\0';
+}
+
+static void
+_ccze_line_add_run (ccze_color_t col, size_t len, int flags)
+{
+  if (line.nruns >= line.runs_alloc)
+    {
+      line.runs_alloc *= 2;
+      line.runs = (ccze_run_t *)ccze_realloc
+	(line.runs, line.runs_alloc * sizeof (ccze_run_t));
+    }
+  line.runs[line.nruns].color = (unsigned char)col;
+  line.runs[line.nruns].flags = (unsigned char)flags;
+  line.runs[line.nruns].len = (unsigned short)len;
+  line.nruns++;
+}
+
+void
+ccze_line_add (ccze_color_t col, const char *str, size_t len, int flags)
+{
+  size_t left;
+
+  if (!str)
+    return;
+
+  if (line.len + len + 1 > line.alloc)
+    {
+      while (line.len + len + 1 > line.alloc)
+	line.alloc *= 2;
+      line.text = (char *)ccze_realloc (line.text, line.alloc);
+    }
+  memcpy (line.text + line.len, str, len);
+  line.len += len;
+  line.text[line.len] = '\0';
+
+  /* Runs are kept one per ccze_addstr() call, even if the color is
+     the same as the previous one's: the debug and HTML outputs print
+     one element per call. Overlong runs are split. */
+  left = len;
+  do
+    {
+      size_t chunk = (left > CCZE_RUN_MAXLEN) ? CCZE_RUN_MAXLEN : left;
+      _ccze_line_add_run (col, chunk, flags);
+      flags |= CCZE_RUN_CONT;
+      left -= chunk;
+    } while (left > 0);
+}
+
+/* Cut RUNS where the highlight MARKS change, and give the marked
+   pieces their highlight color. The result is in hl_runs. */
+static size_t
+_ccze_line_highlight (const unsigned char *marks, const ccze_run_t *runs,
+		      size_t nruns)
+{
+  size_t i, off = 0, n = 0;
+
+  for (i = 0; i < nruns; i++)
+    {
+      size_t pos = off, end = off + runs[i].len;
+
+      while (pos < end)
+	{
+	  size_t seg = pos + 1;
+	  unsigned char m = marks[pos];
+
+	  while (seg < end && marks[seg] == m)
+	    seg++;
+
+	  if (n >= hl_runs_alloc)
+	    {
+	      hl_runs_alloc = (hl_runs_alloc) ? hl_runs_alloc * 2 : 64;
+	      hl_runs = (ccze_run_t *)ccze_realloc
+		(hl_runs, hl_runs_alloc * sizeof (ccze_run_t));
+	    }
+	  hl_runs[n].color = (m == CCZE_HIGHLIGHT_NONE) ? runs[i].color : m;
+	  hl_runs[n].flags = runs[i].flags;
+	  if (pos != off || m != CCZE_HIGHLIGHT_NONE)
+	    hl_runs[n].flags &= ~CCZE_RUN_CONT;
+	  hl_runs[n].len = (unsigned short)(seg - pos);
+	  n++;
+	  pos = seg;
+	}
+      off = end;
+    }
+  return n;
+}
+
+/* Output a complete line, in whatever mode we are in. */
+void
+ccze_line_write (const char *text, size_t len, const ccze_run_t *runs,
+		 size_t nruns)
+{
+  const unsigned char *marks = ccze_highlight_scan (text, len);
+
+  if (marks)
+    {
+      nruns = _ccze_line_highlight (marks, runs, nruns);
+      runs = hl_runs;
+    }
+
+  /* The curses scrollback stores, filters and draws lines itself. */
+  if (ccze_config.mode == CCZE_MODE_CURSES)
+    {
+      ccze_scroll_line (text, len, runs, nruns);
+      return;
+    }
+  if (ccze_config.mode == CCZE_MODE_JSON)
+    {
+      ccze_json_line (text, len, runs, nruns);
+      return;
+    }
+  if (ccze_config.mode == CCZE_MODE_TOKENS)
+    {
+      ccze_tokens_line (text, len, runs, nruns);
+      return;
+    }
+
+  ccze_print_runs (text, runs, nruns);
+
+  switch (ccze_config.mode)
+    {
+    case CCZE_MODE_HTML:
+      fputs ("<br>\n", ccze_out);
+      break;
+    case CCZE_MODE_DEBUG:
+    case CCZE_MODE_RAW_ANSI:
+      putc ('\n', ccze_out);
+      break;
+    default:
+      break;
+    }
+}
+
+void
+ccze_line_flush (void)
+{
+  if (ccze_config.mode == CCZE_MODE_SUMMARY)
+    ccze_summary_line (&line);
+  else
+    ccze_line_write (line.text, line.len, line.runs, line.nruns);
+  ccze_line_reset ();
+}
@@ -0,0 +1,371 @@
+/* -*- mode: c; c-file-style: "gnu" -*-
+ * ccze-mailq.c -- Following mails through the queue
+ * Copyright (C) 2003 Gergely Nagy <algernon@bonehunter.rulez.org>
+ *
+ * This file is part of ccze.
+ *
+ * ccze is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ccze is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include <ccze.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ccze-private.h"
+
+/* With -o mailq, the queue IDs the postfix and exim plugins find are
+   remembered while their mail is in the queue, and every new one gets
+   the next color of the hashcolor palette, so mails in flight at the
+   same time look different, and every line of one looks the same.
+   With -o mailq=summary, a line telling what became of the mail is
+   added after the one that takes it out of the queue.
+
+   The table is fixed in size: when it is full, the mail seen the
+   longest time ago is forgotten, and so is one not seen for an hour.
+   Lookups are a hash and a short chain. */
+#define CCZE_MAILQ_MAX 16384
+#define CCZE_MAILQ_BUCKETS 32768
+#define CCZE_MAILQ_TTL 3600
+
+typedef struct
+{
+  char id[24];
+  char from[64];
+  char to[64];
+  char status[16];
+  char delay[16];
+  int nrcpt;
+  unsigned int seq;
+  time_t seen;
+  /* The hash chain, and the list of entries from the most recently
+     seen to the least, as indexes, -1 ending them. */
+  int next;
+  int prev_seen, next_seen;
+} ccze_mailq_entry_t;
+
+static ccze_mailq_entry_t *mailq;
+static int buckets[CCZE_MAILQ_BUCKETS];
+static int newest = -1, oldest = -1, unused = -1, nused;
+static unsigned int seq;
+/* The mail the current line took out of the queue, if any. */
+static int done = -1;
+
+static unsigned int
+_ccze_mailq_hash (const char *id, size_t len)
+{
+  unsigned int h = 2166136261U;
+  size_t i;
+
+  for (i = 0; i < len; i++)
+    h = (h ^ (unsigned char)id[i]) * 16777619U;
+  return h & (CCZE_MAILQ_BUCKETS - 1);
+}
+
+static void
+_ccze_mailq_unseen (int i)
+{
+  if (mailq[i].prev_seen >= 0)
+    mailq[mailq[i].prev_seen].next_seen = mailq[i].next_seen;
+  else
+    newest = mailq[i].next_seen;
+  if (mailq[i].next_seen >= 0)
+    mailq[mailq[i].next_seen].prev_seen = mailq[i].prev_seen;
+  else
+    oldest = mailq[i].prev_seen;
+}
+
+static void
+_ccze_mailq_seen (int i, time_t now)
+{
+  mailq[i].seen = now;
+  mailq[i].prev_seen = -1;
+  mailq[i].next_seen = newest;
+  if (newest >= 0)
+    mailq[newest].prev_seen = i;
+  newest = i;
+  if (oldest < 0)
+    oldest = i;
+}
+
+static void
+_ccze_mailq_forget (int i)
+{
+  int *p = &buckets[_ccze_mailq_hash (mailq[i].id, strlen (mailq[i].id))];
+
+  while (*p != i)
+    p = &mailq[*p].next;
+  *p = mailq[i].next;
+  _ccze_mailq_unseen (i);
+  mailq[i].next = unused;
+  unused = i;
+}
+
+/* The entry of ID (LEN bytes long), or -1. */
+static int
+_ccze_mailq_find (const char *id, size_t len, time_t now)
+{
+  int i;
+
+  if (!mailq)
+    return -1;
+  for (i = buckets[_ccze_mailq_hash (id, len)]; i >= 0; i = mailq[i].next)
+    if (!strncmp (mailq[i].id, id, len) && mailq[i].id[len] == '\0')
+      {
+	if (now - mailq[i].seen > CCZE_MAILQ_TTL)
+	  {
+	    _ccze_mailq_forget (i);
+	    return -1;
+	  }
+	return i;
+      }
+  return -1;
+}
+
+static int
+_ccze_mailq_add (const char *id, size_t len, time_t now)
+{
+  unsigned int h = _ccze_mailq_hash (id, len);
+  int i;
+
+  if (!mailq)
+    {
+      mailq = (ccze_mailq_entry_t *)ccze_malloc (CCZE_MAILQ_MAX *
+						 sizeof (ccze_mailq_entry_t));
+      memset (buckets, 0xff, sizeof (buckets));
+    }
+
+  if (unused >= 0)
+    {
+      i = unused;
+      unused = mailq[i].next;
+    }
+  else if (nused < CCZE_MAILQ_MAX)
+    i = nused++;
+  else
+    {
+      i = oldest;
+      _ccze_mailq_forget (i);
+      unused = mailq[i].next;
+    }
+
+  memset (&mailq[i], 0, sizeof (mailq[i]));
+  memcpy (mailq[i].id, id, len);
+  mailq[i].seq = seq++;
+  mailq[i].next = buckets[h];
+  buckets[h] = i;
+  _ccze_mailq_seen (i, now);
+  return i;
+}
+
+/* Copy the value at STR, up to one of the bytes in END, into DST. */
+static void
+_ccze_mailq_copy (char *dst, size_t size, const char *str, const char *end)
+{
+  size_t len = strcspn (str, end);
+
+  if (len >= size)
+    len = size - 1;
+  memcpy (dst, str, len);
+  dst[len] = '\0';
+}
+
+static const char *
+_ccze_mailq_field (const char *str, const char *name)
+{
+  const char *p = strstr (str, name);
+
+  return (p) ? p + strlen (name) : NULL;
+}
+
+/* What a postfix line after the queue ID says about the mail. Returns
+   non-zero if it is the last one. */
+static int
+_ccze_mailq_postfix (ccze_mailq_entry_t *e, const char *str)
+{
+  const char *p;
+
+  if (!strncmp (str, ": removed", 9))
+    return 1;
+  if ((p = _ccze_mailq_field (str, "from=<")))
+    _ccze_mailq_copy (e->from, sizeof (e->from), p, ">");
+  if ((p = _ccze_mailq_field (str, "nrcpt=")))
+    e->nrcpt = atoi (p);
+  if ((p = _ccze_mailq_field (str, " to=<")) && !e->to[0])
+    _ccze_mailq_copy (e->to, sizeof (e->to), p, ">");
+  if ((p = _ccze_mailq_field (str, "delay=")))
+    _ccze_mailq_copy (e->delay, sizeof (e->delay), p, ", ");
+  if ((p = _ccze_mailq_field (str, "status=")))
+    _ccze_mailq_copy (e->status, sizeof (e->status), p, ", ");
+  return 0;
+}
+
+/* The same for exim, where the queue ID is followed by a flag and an
+   address, or "Completed". */
+static int
+_ccze_mailq_exim (ccze_mailq_entry_t *e, const char *str)
+{
+  static const struct
+  {
+    const char *flag, *status;
+  } flags[] = {
+    {" => ", "sent"}, {" -> ", "sent"}, {" *> ", "sent"},
+    {" ** ", "bounced"}, {" == ", "deferred"}
+  };
+  size_t i;
+
+  if (!strncmp (str, " Completed", 10))
+    return 1;
+  if (!strncmp (str, " <= ", 4))
+    {
+      _ccze_mailq_copy (e->from, sizeof (e->from), str + 4, " ");
+      return 0;
+    }
+  for (i = 0; i < sizeof (flags) / sizeof (flags[0]); i++)
+    if (!strncmp (str, flags[i].flag, 4))
+      {
+	if (!e->to[0])
+	  _ccze_mailq_copy (e->to, sizeof (e->to), str + 4, " ");
+	e->nrcpt++;
+	strcpy (e->status, flags[i].status);
+      }
+  return 0;
+}
+
+/* Remember what LINE, about to be written, says about the mail it is
+   about. The queue ID is what the plugin colored as one; lines only
+   wordcolored, like postfix's "removed", are matched by the ID after
+   the syslog header, to mails already known. */
+void
+ccze_mailq_line (const ccze_line_t *line)
+{
+  const char **handlers, *id = NULL, *p;
+  size_t i, off, len = 0;
+  int n, postfix = 0, exim = 0, colored = 0, e;
+  time_t now;
+
+  handlers = ccze_plugin_line_handlers (&n);
+  while (n-- > 0)
+    {
+      postfix |= !strcmp (handlers[n], "postfix");
+      exim |= !strcmp (handlers[n], "exim");
+    }
+
+  for (i = 0, off = 0; i < line->nruns; off += line->runs[i++].len)
+    if (line->runs[i].color == CCZE_COLOR_UNIQN)
+      {
+	id = line->text + off;
+	len = line->runs[i].len;
+	colored = 1;
+	break;
+      }
+  if (!id && (p = strstr (line->text, "]: ")))
+    {
+      id = p + 3;
+      len = strcspn (id, ": ");
+      postfix = (id[len] == ':');
+    }
+  if (!id || len == 0 || len >= sizeof (mailq[0].id) || (!postfix && !exim))
+    return;
+
+  now = time (NULL);
+  if ((e = _ccze_mailq_find (id, len, now)) >= 0)
+    {
+      _ccze_mailq_unseen (e);
+      _ccze_mailq_seen (e, now);
+    }
+  else if (colored)
+    e = _ccze_mailq_add (id, len, now);
+  else
+    return;
+
+  if ((postfix) ? _ccze_mailq_postfix (&mailq[e], id + len) :
+      _ccze_mailq_exim (&mailq[e], id + len))
+    done = e;
+}
+
+static void
+_ccze_mailq_add_field (const char *name, ccze_color_t col, const char *value)
+{
+  if (!value[0])
+    return;
+  ccze_line_add (CCZE_COLOR_DEFAULT, " ", 1, CCZE_RUN_NBSP);
+  ccze_line_add (CCZE_COLOR_FIELD, name, strlen (name), 0);
+  ccze_line_add (CCZE_COLOR_DEFAULT, "=", 1, 0);
+  ccze_line_add (col, value, strlen (value), 0);
+}
+
+/* Once the line that took a mail out of the queue is written, write
+   its summary, if asked to, and forget it. */
+void
+ccze_mailq_flush (void)
+{
+  ccze_mailq_entry_t *e;
+  ccze_color_t scol = CCZE_COLOR_DEFAULT;
+  char nrcpt[16];
+
+  if (done < 0)
+    return;
+  e = &mailq[done];
+
+  if (ccze_config.mailq > 1 && ccze_config.mode != CCZE_MODE_SUMMARY &&
+      ccze_config.mode != CCZE_MODE_INDEX)
+    {
+      if (!strcmp (e->status, "sent"))
+	scol = CCZE_COLOR_GOODWORD;
+      else if (!strcmp (e->status, "deferred"))
+	scol = CCZE_COLOR_WARNING;
+      else if (e->status[0])
+	scol = CCZE_COLOR_BADWORD;
+      snprintf (nrcpt, sizeof (nrcpt), "%d", e->nrcpt);
+
+      ccze_plugin_line_start ();
+      ccze_line_add (CCZE_COLOR_UNIQN, e->id, strlen (e->id), 0);
+      ccze_line_add (CCZE_COLOR_DEFAULT, ":", 1, 0);
+      ccze_line_add (CCZE_COLOR_DEFAULT, " ", 1, CCZE_RUN_NBSP);
+      ccze_line_add (CCZE_COLOR_DEFAULT, "completed", 9, 0);
+      _ccze_mailq_add_field ("from", CCZE_COLOR_EMAIL, e->from);
+      _ccze_mailq_add_field ("to", CCZE_COLOR_EMAIL, e->to);
+      if (e->nrcpt > 1)
+	_ccze_mailq_add_field ("nrcpt", CCZE_COLOR_NUMBERS, nrcpt);
+      _ccze_mailq_add_field ("status", scol, e->status);
+      _ccze_mailq_add_field ("delay", CCZE_COLOR_GETTIME, e->delay);
+      ccze_line_flush ();
+    }
+
+  _ccze_mailq_forget (done);
+  done = -1;
+}
+
+/* The color of the mail with the queue ID STR (LEN bytes long), as a
+   number to pick a palette entry by, or -1 if it is not in the
+   queue. */
+int
+ccze_mailq_color (const char *str, size_t len)
+{
+  int i = _ccze_mailq_find (str, len, time (NULL));
+
+  return (i >= 0) ? (int)mailq[i].seq : -1;
+}
+
+void
+ccze_mailq_shutdown (void)
+{
+  free (mailq);
+  mailq = NULL;
+  newest = oldest = unused = done = -1;
+  nused = 0;
+  seq = 0;
+}
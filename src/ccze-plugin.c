@@ -36,6 +36,11 @@ static ccze_plugin_t **plugin_args;
 static size_t plugin_args_alloc, plugin_args_len;
 static char *plugin_running = NULL;
 
+/* The plugins which handled the current line: a FULL and a PARTIAL
+   one at most. */
+static const char *line_handlers[2];
+static int line_nhandlers;
+
 static ccze_plugin_t *
 _ccze_plugin_find (const char *name)
 {
@@ -290,6 +295,30 @@ ccze_plugin_setup (void)
   plugin_running = NULL;
 }
 
+/* Load the plugins that appeared since the rest were loaded, and
+   start them up. Those already running are kept as they are, and are
+   still tried first. */
+void
+ccze_plugin_reload (void)
+{
+  size_t i, first = plugins_len;
+  int pl;
+
+  if (ccze_config.pluginlist_len == 0)
+    ccze_plugin_load_all ();
+  else
+    for (pl = ccze_config.pluginlist_len - 1; pl >= 0; pl--)
+      ccze_plugin_load (ccze_config.pluginlist[pl]);
+  ccze_plugin_finalise ();
+
+  for (i = first; i < plugins_len; i++)
+    {
+      plugin_running = plugins[i]->name;
+      (*(plugins[i]->startup))();
+    }
+  plugin_running = NULL;
+}
+
 void
 ccze_plugin_shutdown (void)
 {
@@ -309,6 +338,7 @@ ccze_plugin_shutdown (void)
 
   plugin_running = NULL;
   free (plugins);
+  ccze_record_shutdown ();
 }
 
 void
@@ -327,6 +357,8 @@ ccze_plugin_run (ccze_plugin_t **pluginset, char *subject, size_t subjlen,
 	  if ((*handled = (*(pluginset[i]->handler))
 	       (subject, subjlen, rest)) != 0)
 	    {
+	      ccze_filter_handled (pluginset[i]->name);
+	      ccze_plugin_line_handled (pluginset[i]->name);
 	      *status = *handled;
 	      break;
 	    }
@@ -419,6 +451,30 @@ ccze_plugin_name_get (void)
   return plugin_running;
 }
 
+void
+ccze_plugin_line_start (void)
+{
+  line_nhandlers = 0;
+}
+
+/* Called when plugin NAME handled the current line. A FULL plugin
+   which ends the line itself is reported both from ccze_newline() and
+   when it returns. */
+void
+ccze_plugin_line_handled (const char *name)
+{
+  if (line_nhandlers < 2 &&
+      (!line_nhandlers || line_handlers[line_nhandlers - 1] != name))
+    line_handlers[line_nhandlers++] = name;
+}
+
+const char **
+ccze_plugin_line_handlers (int *n)
+{
+  *n = line_nhandlers;
+  return line_handlers;
+}
+
 int
 ccze_plugin_list_fancy (void)
 {
@@ -0,0 +1,117 @@
+/* -*- mode: c; c-file-style: "gnu" -*-
+ * ccze-print.c -- Printing color runs in the stream output modes
+ * Copyright (C) 2003 Gergely Nagy <algernon@bonehunter.rulez.org>
+ *
+ * This file is part of ccze.
+ *
+ * ccze is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ccze is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include <ccze.h>
+#include <stdio.h>
+
+#include "ccze-private.h"
+
+/* Where the output goes: stdout, unless a libccze context collects it
+   for its caller. */
+FILE *ccze_out;
+
+static void
+_ccze_print_html (const char *str, size_t len)
+{
+  size_t i;
+
+  for (i = 0; i < len; i++)
+    {
+      switch (str[i])
+	{
+	case '>':
+	  fputs ("&gt;", ccze_out);
+	  break;
+	case '<':
+	  fputs ("&lt;", ccze_out);
+	  break;
+	case '&':
+	  fputs ("&amp;", ccze_out);
+	  break;
+	default:
+	  putc (str[i], ccze_out);
+	  break;
+	}
+    }
+}
+
+static void
+_ccze_print_run (ccze_color_t col, const char *str, size_t len, int flags)
+{
+  int slot = ccze_hashcolor_slot (col, str, len);
+
+  switch (ccze_config.mode)
+    {
+    case CCZE_MODE_HTML:
+      if (slot >= 0)
+	fprintf (ccze_out, "<font class=\"ccze_%s\" style=\"color: %s\">",
+		ccze_color_lookup_name (col), ccze_hashcolor_css (slot));
+      else
+	fprintf (ccze_out, "<font class=\"ccze_%s\">", ccze_color_lookup_name (col));
+      if (flags & CCZE_RUN_NBSP)
+	fputs ("&nbsp;", ccze_out);
+      else
+	_ccze_print_html (str, len);
+      fprintf (ccze_out, "</font>");
+      break;
+    case CCZE_MODE_RAW_ANSI:
+      fputs ((slot >= 0) ? ccze_hashcolor_ansi (slot) : ccze_color_ansi (col),
+	     ccze_out);
+      fwrite (str, 1, len, ccze_out);
+      fputs ("\x1b[0m", ccze_out);
+      break;
+    case CCZE_MODE_DEBUG:
+      {
+	char *cn = ccze_color_lookup_name (col);
+	fprintf (ccze_out, "<%s>%.*s</%s>", cn, (int)len, str, cn);
+      }
+      break;
+    case CCZE_MODE_CURSES:
+      attrset ((slot >= 0) ? ccze_hashcolor_attr (slot) : ccze_color (col));
+      addnstr (str, (int)len);
+      break;
+    default:
+      break;
+    }
+}
+
+/* Print a run list over TEXT. Runs that were split because of their
+   length are glued back together, so the output is the same as if
+   ccze_addstr() wrote directly. */
+void
+ccze_print_runs (const char *text, const ccze_run_t *runs, size_t nruns)
+{
+  size_t i, off = 0;
+
+  for (i = 0; i < nruns; i++)
+    {
+      size_t len = runs[i].len, first = i;
+
+      while (i + 1 < nruns && (runs[i + 1].flags & CCZE_RUN_CONT))
+	{
+	  i++;
+	  len += runs[i].len;
+	}
+      _ccze_print_run (runs[first].color, text + off, len,
+			    runs[first].flags);
+      off += len;
+    }
+}
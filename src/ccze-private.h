@@ -23,8 +23,14 @@
 #define _CCZE_PRIVATE_H 1
 
 #include <ccze.h>
+#include <sys/types.h>
+#include <time.h>
+
+#include "libccze.h"
 
 /* ccze-color.c */
+#define CCZE_COLOR_RGB 0x1000000 /* A #rrggbb color, not a palette index */
+
 void ccze_color_init (void);
 void ccze_color_parse (char *line);
 void ccze_color_load (const char *fn);
@@ -35,6 +41,142 @@ char *ccze_color_lookup_name (ccze_color_t color);
 char *ccze_color_to_css (ccze_color_t cidx);
 void ccze_colors_to_css (void);
 char *ccze_cssbody_color (void);
+int ccze_color_ext_rgb (int c);
+int ccze_color_rgb_to_256 (int rgb);
+const char *ccze_color_ansi (ccze_color_t idx);
+int ccze_color_pair (short fg, short bg);
+
+#define CCZE_COLOR_CSS_MAX 32
+
+typedef struct
+{
+  int table[CCZE_COLOR_LAST + 1];
+  int ext_fg[CCZE_COLOR_LAST + 1];
+  int ext_bg[CCZE_COLOR_LAST + 1];
+  char css_normal[8][CCZE_COLOR_CSS_MAX];
+  char css_bold[8][CCZE_COLOR_CSS_MAX];
+  char cssbody[CCZE_COLOR_CSS_MAX];
+} ccze_color_snapshot_t;
+
+int ccze_color_snapshot (ccze_color_snapshot_t *snap);
+void ccze_color_restore (const ccze_color_snapshot_t *snap);
+
+/* ccze-filter.c */
+#define CCZE_FILTER_PLUGIN 0x01
+#define CCZE_FILTER_HOST 0x02
+#define CCZE_FILTER_PROCESS 0x04
+#define CCZE_FILTER_CLASS 0x08
+#define CCZE_FILTER_TIME 0x10
+
+int ccze_filter_add (int what, const char *list);
+void ccze_filter_start (void);
+void ccze_filter_continue (int shown);
+int ccze_filter_rejected (void);
+void ccze_filter_handled (const char *name);
+void ccze_filter_token (ccze_color_t col, const char *str);
+int ccze_filter_check (int mask);
+int ccze_filter_accept (void);
+void ccze_filter_range (time_t from, time_t to);
+int ccze_filter_done (void);
+
+/* ccze-colormap.c */
+int ccze_colormap_user_add (const char *map, const char *color,
+			    const char *token);
+int ccze_colormap_user_add_class (const char *map, ccze_color_t col,
+				  const char *token);
+size_t ccze_colormap_user_count (void);
+const char *ccze_colormap_user_get (size_t index, const char **map,
+				    ccze_color_t *col);
+void ccze_colormap_user_reset (void);
+
+/* ccze-highlight.c */
+#define CCZE_HIGHLIGHT_NONE 0xff
+
+int ccze_highlight_add (const char *color, const char *pattern, int regex);
+int ccze_highlight_add_class (ccze_color_t col, const char *pattern,
+			      int regex);
+size_t ccze_highlight_count (void);
+const char *ccze_highlight_get (size_t index, ccze_color_t *col, int *regex);
+void ccze_highlight_setup (void);
+void ccze_highlight_shutdown (void);
+const unsigned char *ccze_highlight_scan (const char *text, size_t len);
+
+/* ccze-index.c */
+time_t ccze_date_parse (const char *str);
+int ccze_index_build (const char *fn, size_t interval);
+off_t ccze_index_seek (const char *fn, int fd, time_t from);
+
+/* ccze-line.c */
+#define CCZE_RUN_NBSP 0x01 /* A ccze_space(), &nbsp; in HTML */
+#define CCZE_RUN_CONT 0x02 /* Continuation of an overlong run */
+#define CCZE_RUN_MAXLEN 0xffff
+
+typedef struct
+{
+  unsigned char color;
+  unsigned char flags;
+  unsigned short len;
+} ccze_run_t;
+
+typedef struct
+{
+  char *text;
+  size_t len, alloc;
+  ccze_run_t *runs;
+  size_t nruns, runs_alloc;
+} ccze_line_t;
+
+void ccze_line_init (void);
+void ccze_line_shutdown (void);
+ccze_line_t *ccze_line_current (void);
+void ccze_line_reset (void);
+void ccze_line_add (ccze_color_t col, const char *str, size_t len,
+		    int flags);
+void ccze_line_write (const char *text, size_t len, const ccze_run_t *runs,
+		      size_t nruns);
+void ccze_line_flush (void);
+
+/* ccze-print.c */
+extern FILE *ccze_out;
+
+void ccze_print_runs (const char *text, const ccze_run_t *runs, size_t nruns);
+
+/* ccze-hashcolor.c */
+#define CCZE_HASHCOLOR_SLOTS 32
+
+void ccze_hashcolor_reset (void);
+int ccze_hashcolor_slot (ccze_color_t col, const char *str, size_t len);
+const char *ccze_hashcolor_ansi (int slot);
+int ccze_hashcolor_attr (int slot);
+const char *ccze_hashcolor_css (int slot);
+
+/* ccze-json.c */
+void ccze_json_line (const char *text, size_t len, const ccze_run_t *runs,
+		     size_t nruns);
+
+/* ccze-tokens.c */
+#define CCZE_TOKENS_MAGIC "CCZETOK1"
+#define CCZE_TOKENS_NBSP 0x80
+#define CCZE_TOKENS_BLOCK_LINES 1024
+#define CCZE_TOKENS_BLOCK_SIZE (256 * 1024)
+
+void ccze_tokens_line (const char *text, size_t len, const ccze_run_t *runs,
+		       size_t nruns);
+void ccze_tokens_flush (void);
+void ccze_tokens_shutdown (void);
+
+/* ccze-collapse.c */
+void ccze_collapse_init (size_t lines, int seconds);
+void ccze_collapse_shutdown (void);
+int ccze_collapse_line (const ccze_line_t *line);
+void ccze_collapse_expire (int all);
+int ccze_collapse_timeout (void);
+
+/* ccze-mailq.c */
+void ccze_mailq_line (const ccze_line_t *line);
+void ccze_mailq_flush (void);
+int ccze_mailq_color (const char *str, size_t len);
+void ccze_mailq_shutdown (void);
 
 /* ccze-plugin.c */
 void ccze_plugin_init (void);
@@ -46,6 +188,7 @@ void ccze_plugin_load_all (void);
 void ccze_plugin_load (const char *name);
 void ccze_plugin_add (ccze_plugin_t *plugin);
 void ccze_plugin_setup (void);
+void ccze_plugin_reload (void);
 void ccze_plugin_shutdown (void);
 void ccze_plugin_finalise (void);
 void ccze_plugin_run (ccze_plugin_t **pluginset, char *subject,
@@ -54,6 +197,74 @@ void ccze_plugin_run (ccze_plugin_t **pluginset, char *subject,
 		      int *status);
 void ccze_plugin_load_all_builtins (void);
 int ccze_plugin_list_fancy (void);
+void ccze_plugin_line_start (void);
+void ccze_plugin_line_handled (const char *name);
+const char **ccze_plugin_line_handlers (int *n);
+
+/* ccze-rccache.c */
+int ccze_rccache_load (const char **files, int nfiles);
+void ccze_rccache_save (const char **files, int nfiles, size_t first);
+
+/* ccze-record.c */
+typedef struct
+{
+  /* The plugin which started the open record, if it has rules. */
+  const char *plugin;
+  int open, generic, shown;
+  size_t lines;
+  time_t last;
+} ccze_record_state_t;
+
+int ccze_record_continues (const char *str, size_t len);
+int ccze_record_shown (void);
+void ccze_record_start (void);
+void ccze_record_save (ccze_record_state_t *state);
+void ccze_record_restore (const ccze_record_state_t *state);
+void ccze_record_shutdown (void);
+
+/* ccze-remote.c */
+#define CCZE_REMOTE_MAGIC "CCZE1"
+#define CCZE_REMOTE_SOCKET "/tmp/cczed.socket"
+
+int ccze_remote_parse (char *line, ccze_ctx_config_t *config);
+int ccze_remote (const char *path, int fd);
+
+/* ccze-ring.c */
+#define CCZE_RING_RECORD_MAX 16384
+
+typedef enum
+{
+  CCZE_RING_BLOCK,
+  CCZE_RING_DROP,
+  CCZE_RING_SUMMARY
+} ccze_ring_policy_t;
+
+int ccze_ring_start (int fd, size_t size, ccze_ring_policy_t policy);
+int ccze_ring_pending (void);
+ssize_t ccze_ring_read (char *buf, size_t len, unsigned long *dropped,
+		       int *cut);
+unsigned long ccze_ring_dropped (void);
+void ccze_ring_stop (void);
+
+/* ccze-scroll.c */
+void ccze_scroll_init (size_t cap);
+void ccze_scroll_shutdown (void);
+void ccze_scroll_line (const char *text, size_t len, const ccze_run_t *runs,
+		       size_t nruns);
+int ccze_scroll_following (void);
+void ccze_scroll_eof (void);
+void ccze_scroll_redraw (void);
+int ccze_scroll_key (int key);
+int ccze_scroll_busy (void);
+void ccze_scroll_work (void);
+
+/* ccze-summary.c */
+void ccze_summary_init (int bucket);
+void ccze_summary_shutdown (void);
+void ccze_summary_line (const ccze_line_t *line);
+void ccze_summary_write (FILE *f);
+void ccze_summary_merge (FILE *f);
+void ccze_summary_report (void);
 
 /* ccze-wordcolor.c */
 void ccze_wordcolor_process (const char *msg, int wcol, int slookup);
@@ -61,23 +272,43 @@ void ccze_wordcolor_setup (void);
 void ccze_wordcolor_shutdown (void);
 
 /* ccze.c */
+size_t ccze_parse_size (const char *str);
+
+/* ccze-lib.c */
 typedef enum
 {
   CCZE_MODE_CURSES,
   CCZE_MODE_RAW_ANSI,
   CCZE_MODE_HTML,
   CCZE_MODE_DEBUG,
-  CCZE_MODE_PLUGIN_LIST
+  CCZE_MODE_PLUGIN_LIST,
+  CCZE_MODE_INDEX,
+  CCZE_MODE_SUMMARY,
+  CCZE_MODE_JSON,
+  CCZE_MODE_TOKENS
 } ccze_mode_t;
 
 typedef struct
 {
   int scroll;
   int convdate;
+  int localdate;
   int wcol;
   int slookup;
   int remfac;
   int transparent;
+  int hashcolor;
+  int mailq;
+  size_t scrollback;
+  size_t collapse;
+  int collapse_time;
+  char *infile;
+  size_t index_interval;
+  time_t from, to;
+  int summary_bucket;
+  int jobs;
+  size_t buffer;
+  ccze_ring_policy_t overflow;
   char *rcfile;
   char *cssfile;
   char **pluginlist;
@@ -90,4 +321,8 @@ typedef struct
 
 extern ccze_config_t ccze_config;
 
+void ccze_rc_load (const char *rcfile);
+void ccze_process_line (ccze_plugin_t **plugins, char *subject);
+time_t ccze_line_date (char *line);
+
 #endif /* !_CCZE_PRIVATE_H */
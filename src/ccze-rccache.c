@@ -0,0 +1,314 @@
+/* -*- mode: c; c-file-style: "gnu" -*-
+ * ccze-rccache.c -- The rc files, parsed once and kept
+ * Copyright (C) 2003 Gergely Nagy <algernon@bonehunter.rulez.org>
+ *
+ * This file is part of ccze.
+ *
+ * ccze is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ccze is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include <ccze.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ccze-private.h"
+
+/* What the rc files amount to - the color table, the CSS colors, the
+   highlight patterns and the color map tokens - is written to a cache
+   file after they are read, and the next time the same files are to
+   be read, unchanged, the cache is mapped and copied in instead. The
+   file is:
+
+     "CCZERC2\n"
+     uint32 key length, key
+     ccze_color_snapshot_t
+     uint32 number of highlights
+     for each: uint32 color, uint32 regex, uint32 length, pattern
+     uint32 number of color map tokens
+     for each: uint32 color, uint32 length, map, uint32 length, token
+
+   all in the byte order of the machine. The key names ccze, the
+   output mode and every rc file, with its inode, size and mtime, so
+   any change to them makes the cache stale. There is a cache file
+   for every mode and set of rc files, named by a hash of those. */
+#define CCZE_RCCACHE_MAGIC "CCZERC2\n"
+
+static char *
+_ccze_rccache_dir (void)
+{
+  const char *base = getenv ("XDG_CACHE_HOME"), *home = getenv ("HOME");
+  char *dir;
+
+  if (base && *base)
+    asprintf (&dir, "%s/ccze", base);
+  else if (home && *home)
+    asprintf (&dir, "%s/.cache/ccze", home);
+  else
+    return NULL;
+  return dir;
+}
+
+/* Make the key of FILES into KEY (of SIZE bytes), and the name of
+   their cache file. Returns NULL if there is to be no cache. */
+static char *
+_ccze_rccache_key (const char **files, int nfiles, char *key, size_t size)
+{
+  unsigned int h = 2166136261U;
+  size_t len, i;
+  char *dir, *path;
+  int n;
+
+  len = snprintf (key, size, "ccze 0.2." PATCHLEVEL " %d %d\n",
+		  (int)CCZE_COLOR_LAST, (int)ccze_config.mode);
+  for (n = 0; n < nfiles && len < size; n++)
+    {
+      struct stat st;
+
+      for (i = 0; files[n][i]; i++)
+	h = (h ^ (unsigned char)files[n][i]) * 16777619U;
+      if (stat (files[n], &st))
+	len += snprintf (key + len, size - len, "%s -\n", files[n]);
+      else
+	len += snprintf (key + len, size - len, "%s %lu %lu %ld.%09ld\n",
+			 files[n], (unsigned long)st.st_ino,
+			 (unsigned long)st.st_size, (long)st.st_mtim.tv_sec,
+			 (long)st.st_mtim.tv_nsec);
+    }
+  if (len >= size || !(dir = _ccze_rccache_dir ()))
+    return NULL;
+
+  asprintf (&path, "%s/rc-%d-%08x", dir, (int)ccze_config.mode, h);
+  free (dir);
+  return path;
+}
+
+static uint32_t
+_ccze_rccache_u32 (const unsigned char **p)
+{
+  uint32_t v;
+
+  memcpy (&v, *p, sizeof (v));
+  *p += sizeof (v);
+  return v;
+}
+
+/* Set the colors and highlights of FILES from their cache. Returns
+   -1, having done nothing, if there is no usable cache. */
+int
+ccze_rccache_load (const char **files, int nfiles)
+{
+  ccze_color_snapshot_t snap;
+  char key[4096], *path;
+  const unsigned char *map, *p, *end;
+  void *addr;
+  struct stat st;
+  uint32_t keylen, nhl, nmap, i;
+  int fd, rval = -1;
+
+  if (!(path = _ccze_rccache_key (files, nfiles, key, sizeof (key))))
+    return -1;
+  fd = open (path, O_RDONLY);
+  free (path);
+  if (fd < 0)
+    return -1;
+  if (fstat (fd, &st) || st.st_size < 12 ||
+      (addr = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) ==
+      MAP_FAILED)
+    {
+      close (fd);
+      return -1;
+    }
+  map = (const unsigned char *)addr;
+  p = map + 8;
+  end = map + st.st_size;
+
+  keylen = _ccze_rccache_u32 (&p);
+  if (memcmp (map, CCZE_RCCACHE_MAGIC, 8) || keylen != strlen (key) ||
+      (size_t)(end - p) < keylen + sizeof (snap) + 4 ||
+      memcmp (p, key, keylen))
+    goto out;
+  p += keylen;
+  memcpy (&snap, p, sizeof (snap));
+  p += sizeof (snap);
+
+  /* Check every record before using any of them. */
+  nhl = _ccze_rccache_u32 (&p);
+  {
+    const unsigned char *q = p;
+
+    for (i = 0; i < nhl; i++)
+      {
+	uint32_t len;
+
+	if ((size_t)(end - q) < 12)
+	  goto out;
+	q += 8;
+	len = _ccze_rccache_u32 (&q);
+	if ((size_t)(end - q) < len)
+	  goto out;
+	q += len;
+      }
+    if ((size_t)(end - q) < 4)
+      goto out;
+    nmap = _ccze_rccache_u32 (&q);
+    for (i = 0; i < nmap; i++)
+      {
+	uint32_t len;
+	int j;
+
+	if ((size_t)(end - q) < 4)
+	  goto out;
+	q += 4;
+	for (j = 0; j < 2; j++)
+	  {
+	    if ((size_t)(end - q) < 4)
+	      goto out;
+	    len = _ccze_rccache_u32 (&q);
+	    if ((size_t)(end - q) < len)
+	      goto out;
+	    q += len;
+	  }
+      }
+  }
+
+  ccze_color_restore (&snap);
+  for (i = 0; i < nhl; i++)
+    {
+      uint32_t col = _ccze_rccache_u32 (&p);
+      uint32_t regex = _ccze_rccache_u32 (&p);
+      uint32_t len = _ccze_rccache_u32 (&p);
+      char *pattern = strndup ((const char *)p, len);
+
+      if (col < CCZE_COLOR_LAST)
+	ccze_highlight_add_class ((ccze_color_t)col, pattern, (int)regex);
+      free (pattern);
+      p += len;
+    }
+  nmap = _ccze_rccache_u32 (&p);
+  for (i = 0; i < nmap; i++)
+    {
+      uint32_t col = _ccze_rccache_u32 (&p);
+      uint32_t len = _ccze_rccache_u32 (&p);
+      char *mapname = strndup ((const char *)p, len), *token;
+
+      p += len;
+      len = _ccze_rccache_u32 (&p);
+      token = strndup ((const char *)p, len);
+      p += len;
+      if (col < CCZE_COLOR_LAST)
+	ccze_colormap_user_add_class (mapname, (ccze_color_t)col, token);
+      free (mapname);
+      free (token);
+    }
+  rval = 0;
+
+ out:
+  munmap (addr, st.st_size);
+  close (fd);
+  return rval;
+}
+
+static void
+_ccze_rccache_put (FILE *f, uint32_t v)
+{
+  fwrite (&v, sizeof (v), 1, f);
+}
+
+/* Write the cache of FILES, just read, which added the highlights
+   from the FIRSTth on. Failing to is not an error: the files will
+   just be read again next time. */
+void
+ccze_rccache_save (const char **files, int nfiles, size_t first)
+{
+  ccze_color_snapshot_t snap;
+  char key[4096], *path, *tmp, *dir;
+  size_t i, n = ccze_highlight_count ();
+  FILE *f;
+  int fd;
+
+  memset (&snap, 0, sizeof (snap));
+  if (ccze_color_snapshot (&snap) ||
+      !(path = _ccze_rccache_key (files, nfiles, key, sizeof (key))))
+    return;
+
+  /* ~/.cache may not be there either. */
+  dir = strdup (path);
+  *strrchr (dir, '/') = '\0';
+  if (mkdir (dir, 0700) && errno == ENOENT)
+    {
+      char *slash = strrchr (dir, '/');
+
+      *slash = '\0';
+      mkdir (dir, 0700);
+      *slash = '/';
+      mkdir (dir, 0700);
+    }
+  free (dir);
+
+  asprintf (&tmp, "%s.%ld", path, (long)getpid ());
+  if ((fd = open (tmp, O_WRONLY | O_CREAT | O_EXCL, 0600)) < 0 ||
+      !(f = fdopen (fd, "w")))
+    {
+      if (fd >= 0)
+	close (fd);
+      free (tmp);
+      free (path);
+      return;
+    }
+
+  fwrite (CCZE_RCCACHE_MAGIC, 1, 8, f);
+  _ccze_rccache_put (f, strlen (key));
+  fwrite (key, 1, strlen (key), f);
+  fwrite (&snap, sizeof (snap), 1, f);
+  _ccze_rccache_put (f, n - first);
+  for (i = first; i < n; i++)
+    {
+      ccze_color_t col;
+      int regex;
+      const char *pattern = ccze_highlight_get (i, &col, &regex);
+
+      _ccze_rccache_put (f, col);
+      _ccze_rccache_put (f, regex);
+      _ccze_rccache_put (f, strlen (pattern));
+      fwrite (pattern, 1, strlen (pattern), f);
+    }
+  n = ccze_colormap_user_count ();
+  _ccze_rccache_put (f, n);
+  for (i = 0; i < n; i++)
+    {
+      const char *map, *token;
+      ccze_color_t col;
+
+      token = ccze_colormap_user_get (i, &map, &col);
+      _ccze_rccache_put (f, col);
+      _ccze_rccache_put (f, strlen (map));
+      fwrite (map, 1, strlen (map), f);
+      _ccze_rccache_put (f, strlen (token));
+      fwrite (token, 1, strlen (token), f);
+    }
+
+  /* Whoever reads it sees either the old cache or the whole new one. */
+  if (fclose (f) || rename (tmp, path))
+    unlink (tmp);
+  free (tmp);
+  free (path);
+}
@@ -0,0 +1,195 @@
+/* -*- mode: c; c-file-style: "gnu" -*-
+ * ccze-record.c -- Records spanning more than one line
+ * Copyright (C) 2003 Gergely Nagy <algernon@bonehunter.rulez.org>
+ *
+ * This file is part of ccze.
+ *
+ * ccze is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ccze is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include <ccze.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ccze-private.h"
+
+/* Some records go on for more than one line: a stack trace after an
+   exception, or the rest of a message that had newlines in it. Such
+   continuation lines have nothing a FULL plugin could match, so they
+   are only wordcolored, and they are shown or filtered out along with
+   the line that started the record.
+
+   Plugins register rules for what can follow the lines they handle.
+   After a line no plugin recognised - an application writing its
+   exceptions to the log - any indented line continues the record, and
+   so does a "Caused by: " within a Java trace.
+
+   A record ends at the first line that does not continue it, after
+   CCZE_RECORD_MAX_LINES lines, or when nothing came for
+   CCZE_RECORD_TIMEOUT seconds - following a log, a line written much
+   later is not part of the same record. */
+#define CCZE_RECORD_MAX_LINES 1000
+#define CCZE_RECORD_TIMEOUT 2
+
+typedef struct
+{
+  char *plugin;
+  pcre *regex;
+  pcre_extra *hints;
+} ccze_record_rule_t;
+
+static ccze_record_rule_t *rules;
+static size_t rules_len;
+
+static ccze_record_state_t record;
+
+/* Register REGEX as matching the lines which continue a record started
+   by a line the calling plugin handled. To be called from the setup
+   routine of the plugin. */
+void
+ccze_plugin_continuation (const char *regex)
+{
+  const char *name = ccze_plugin_name_get (), *error;
+  pcre *reg;
+  int errptr;
+
+  if (!name || !(reg = pcre_compile (regex, 0, &error, &errptr, NULL)))
+    return;
+
+  rules = (ccze_record_rule_t *)ccze_realloc (rules, (rules_len + 1) *
+					      sizeof (ccze_record_rule_t));
+  rules[rules_len].plugin = strdup (name);
+  rules[rules_len].regex = reg;
+  rules[rules_len].hints = pcre_study (reg, 0, &error);
+  rules_len++;
+}
+
+static int
+_ccze_record_plugin (const char *str, size_t len)
+{
+  int offsets[3];
+  size_t i;
+
+  for (i = 0; i < rules_len; i++)
+    if (!strcmp (rules[i].plugin, record.plugin) &&
+	pcre_exec (rules[i].regex, rules[i].hints, str, len,
+		   0, 0, offsets, 3) >= 0)
+      return 1;
+  return 0;
+}
+
+static int
+_ccze_record_generic (const char *str)
+{
+  const char *p = str;
+
+  if (*p == ' ' || *p == '\t')
+    {
+      while (*p == ' ' || *p == '\t')
+	p++;
+      return (*p != '\0');
+    }
+  return (record.lines > 0 && !strncmp (str, "Caused by: ", 11));
+}
+
+/* Whether STR (LEN bytes long) continues the open record. */
+int
+ccze_record_continues (const char *str, size_t len)
+{
+  time_t now;
+
+  if (!record.open)
+    return 0;
+
+  now = time (NULL);
+  if (record.lines >= CCZE_RECORD_MAX_LINES ||
+      now - record.last > CCZE_RECORD_TIMEOUT ||
+      !((record.plugin && _ccze_record_plugin (str, len)) ||
+	(record.generic && _ccze_record_generic (str))))
+    {
+      record.open = 0;
+      return 0;
+    }
+
+  record.lines++;
+  record.last = now;
+  return 1;
+}
+
+/* Whether the line that started the open record was shown. */
+int
+ccze_record_shown (void)
+{
+  return record.shown;
+}
+
+/* The line just written can start a record: remember who handled it,
+   and whether it was shown. */
+void
+ccze_record_start (void)
+{
+  const char **handlers;
+  size_t i;
+  int n;
+
+  record.plugin = NULL;
+  handlers = ccze_plugin_line_handlers (&n);
+  if (n > 0)
+    for (i = 0; i < rules_len; i++)
+      if (!strcmp (rules[i].plugin, handlers[0]))
+	{
+	  record.plugin = rules[i].plugin;
+	  break;
+	}
+
+  record.open = (record.plugin || n == 0);
+  record.generic = (n == 0);
+  record.shown = ccze_filter_accept ();
+  record.lines = 0;
+  record.last = time (NULL);
+}
+
+/* The open record belongs to the stream being colorized; a library
+   context keeps its own, and swaps it in and out. */
+void
+ccze_record_save (ccze_record_state_t *state)
+{
+  *state = record;
+}
+
+void
+ccze_record_restore (const ccze_record_state_t *state)
+{
+  record = *state;
+}
+
+void
+ccze_record_shutdown (void)
+{
+  size_t i;
+
+  for (i = 0; i < rules_len; i++)
+    {
+      free (rules[i].plugin);
+      free (rules[i].regex);
+      free (rules[i].hints);
+    }
+  free (rules);
+  rules = NULL;
+  rules_len = 0;
+  record.plugin = NULL;
+  record.open = 0;
+}
@@ -0,0 +1,266 @@
+/* -*- mode: c; c-file-style: "gnu" -*-
+ * ccze-remote.c -- Talking to cczed
+ * Copyright (C) 2003 Gergely Nagy <algernon@bonehunter.rulez.org>
+ *
+ * This file is part of ccze.
+ *
+ * ccze is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ccze is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include <ccze.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "ccze-private.h"
+#include "libccze.h"
+
+/* A client sends a single line first:
+
+     CCZE1 MODE OPTIONS
+
+   where MODE is ansi, debug or json, and OPTIONS is a comma separated
+   list of the settings below, or "-". Then comes the log, and the
+   colorized log is sent back, until the client shuts down its side of
+   the connection and everything it sent has been answered. */
+enum
+{
+  CCZE_REMOTE_CONVDATE,
+  CCZE_REMOTE_REMFAC,
+  CCZE_REMOTE_NOWORDCOLOR,
+  CCZE_REMOTE_NOLOOKUPS,
+  CCZE_REMOTE_NOTRANSPARENT,
+  CCZE_REMOTE_HASHCOLOR,
+  CCZE_REMOTE_END
+};
+
+static char *remote_opts[] = {
+  [CCZE_REMOTE_CONVDATE] = "convdate",
+  [CCZE_REMOTE_REMFAC] = "remfac",
+  [CCZE_REMOTE_NOWORDCOLOR] = "nowordcolor",
+  [CCZE_REMOTE_NOLOOKUPS] = "nolookups",
+  [CCZE_REMOTE_NOTRANSPARENT] = "notransparent",
+  [CCZE_REMOTE_HASHCOLOR] = "hashcolor",
+  [CCZE_REMOTE_END] = NULL
+};
+
+static const char *remote_modes[] = {
+  [CCZE_OUTPUT_ANSI] = "ansi",
+  [CCZE_OUTPUT_HTML] = NULL,
+  [CCZE_OUTPUT_DEBUG] = "debug",
+  [CCZE_OUTPUT_JSON] = "json"
+};
+
+/* Parse the request in LINE into CONFIG. Returns -1 if LINE is not a
+   valid request. */
+int
+ccze_remote_parse (char *line, ccze_ctx_config_t *config)
+{
+  char *magic, *mode, *opts, *value;
+  int output;
+
+  magic = strtok (line, " ");
+  mode = strtok (NULL, " ");
+  opts = strtok (NULL, " \r\n");
+  if (!magic || !mode || !opts || strcmp (magic, CCZE_REMOTE_MAGIC))
+    return -1;
+
+  ccze_ctx_config_init (config);
+  for (output = 0; output <= CCZE_OUTPUT_JSON; output++)
+    if (remote_modes[output] && !strcmp (mode, remote_modes[output]))
+      break;
+  if (output > CCZE_OUTPUT_JSON)
+    return -1;
+  config->output = (ccze_output_t)output;
+
+  if (!strcmp (opts, "-"))
+    opts += 1;
+  while (*opts != '\0')
+    {
+      int opt = getsubopt (&opts, remote_opts, &value);
+
+      if (opt < 0)
+	return -1;
+      switch (opt)
+	{
+	case CCZE_REMOTE_CONVDATE:
+	  config->convdate = 1;
+	  break;
+	case CCZE_REMOTE_REMFAC:
+	  config->remfac = 1;
+	  break;
+	case CCZE_REMOTE_NOWORDCOLOR:
+	  config->wordcolor = 0;
+	  break;
+	case CCZE_REMOTE_NOLOOKUPS:
+	  config->lookups = 0;
+	  break;
+	case CCZE_REMOTE_NOTRANSPARENT:
+	  config->transparent = 0;
+	  break;
+	case CCZE_REMOTE_HASHCOLOR:
+	  config->hashcolor = 1;
+	  break;
+	}
+    }
+  return 0;
+}
+
+/* The request for what ccze_config asks for, or NULL if it is not
+   something cczed can do. */
+static char *
+_ccze_remote_request (void)
+{
+  int flags[CCZE_REMOTE_END], i;
+  char *req, *p;
+  ccze_output_t output;
+
+  switch (ccze_config.mode)
+    {
+    case CCZE_MODE_RAW_ANSI:
+      output = CCZE_OUTPUT_ANSI;
+      break;
+    case CCZE_MODE_DEBUG:
+      output = CCZE_OUTPUT_DEBUG;
+      break;
+    case CCZE_MODE_JSON:
+      output = CCZE_OUTPUT_JSON;
+      break;
+    default:
+      return NULL;
+    }
+
+  flags[CCZE_REMOTE_CONVDATE] = ccze_config.convdate;
+  flags[CCZE_REMOTE_REMFAC] = ccze_config.remfac;
+  flags[CCZE_REMOTE_NOWORDCOLOR] = !ccze_config.wcol;
+  flags[CCZE_REMOTE_NOLOOKUPS] = !ccze_config.slookup;
+  flags[CCZE_REMOTE_NOTRANSPARENT] = !ccze_config.transparent;
+  flags[CCZE_REMOTE_HASHCOLOR] = ccze_config.hashcolor;
+
+  req = (char *)ccze_malloc (256);
+  p = req + sprintf (req, "%s %s ", CCZE_REMOTE_MAGIC, remote_modes[output]);
+  for (i = 0; i < CCZE_REMOTE_END; i++)
+    if (flags[i])
+      p += sprintf (p, "%s%s", (p[-1] == ' ') ? "" : ",", remote_opts[i]);
+  strcpy (p, (p[-1] == ' ') ? "-\n" : "\n");
+  return req;
+}
+
+/* Have cczed at PATH colorize what can be read from FD, and write
+   what it sends back to the standard output. Returns non-zero if
+   that could not be done. */
+int
+ccze_remote (const char *path, int fd)
+{
+  struct sockaddr_un addr;
+  char buf[65536], *req;
+  size_t pending, sent = 0;
+  int sock, in_eof = 0;
+
+  if (!(req = _ccze_remote_request ()))
+    {
+      fprintf (stderr, "ccze: --remote only works with the ansi, debug "
+	       "and json modes\n");
+      return 1;
+    }
+
+  memset (&addr, 0, sizeof (addr));
+  addr.sun_family = AF_UNIX;
+  strncpy (addr.sun_path, path, sizeof (addr.sun_path) - 1);
+  if ((sock = socket (AF_UNIX, SOCK_STREAM, 0)) < 0 ||
+      connect (sock, (struct sockaddr *)&addr, sizeof (addr)) < 0)
+    {
+      fprintf (stderr, "ccze: Cannot connect to %s: %s\n", path,
+	       strerror (errno));
+      free (req);
+      return 1;
+    }
+  signal (SIGPIPE, SIG_IGN);
+
+  pending = strlen (req);
+  memcpy (buf, req, pending);
+  free (req);
+
+  /* Whatever cczed sends is read even while the log is being written
+     to it, so that neither of us can block the other. */
+  for (;;)
+    {
+      struct pollfd fds[2];
+      int nfds = 1;
+      ssize_t n;
+
+      fds[0].fd = sock;
+      fds[0].events = POLLIN | ((sent < pending) ? POLLOUT : 0);
+      fds[1].revents = 0;
+      if (!in_eof && sent == pending)
+	{
+	  fds[1].fd = fd;
+	  fds[1].events = POLLIN;
+	  nfds++;
+	}
+      if (poll (fds, nfds, -1) < 0)
+	{
+	  if (errno == EINTR)
+	    continue;
+	  break;
+	}
+
+      if (fds[0].revents & (POLLIN | POLLHUP | POLLERR))
+	{
+	  char out[65536];
+
+	  if ((n = read (sock, out, sizeof (out))) <= 0)
+	    {
+	      if (n < 0 && errno == EINTR)
+		continue;
+	      break;
+	    }
+	  fwrite (out, 1, n, stdout);
+	  fflush (stdout);
+	}
+      if (fds[0].revents & POLLOUT)
+	{
+	  if ((n = write (sock, buf + sent, pending - sent)) < 0 &&
+	      errno != EINTR)
+	    break;
+	  if (n > 0 && (sent += n) == pending)
+	    sent = pending = 0;
+	}
+      if (fds[1].revents & (POLLIN | POLLHUP | POLLERR))
+	{
+	  if ((n = read (fd, buf, sizeof (buf))) > 0)
+	    pending = n;
+	  else if (n == 0 || errno != EINTR)
+	    {
+	      in_eof = 1;
+	      shutdown (sock, SHUT_WR);
+	    }
+	}
+    }
+
+  close (sock);
+  if (!in_eof)
+    {
+      fprintf (stderr, "ccze: Connection to %s lost\n", path);
+      return 1;
+    }
+  return 0;
+}
@@ -0,0 +1,404 @@
+/* -*- mode: c; c-file-style: "gnu" -*-
+ * ccze-render.c -- Render a token stream written by ccze -m tokens
+ * Copyright (C) 2003 Gergely Nagy <algernon@bonehunter.rulez.org>
+ *
+ * This file is part of ccze.
+ *
+ * ccze is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ccze is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+/* ccze-color.c is built in without the parts that need the rest of
+   ccze: highlights, color maps and curses. */
+#define CCZE_STANDALONE 1
+
+#include <ccze.h>
+#ifdef HAVE_ARGP_H
+# include <argp.h>
+#endif
+#include <errno.h>
+#include <stdint.h>
+#include <sys/mman.h>
+
+#include "ccze-compat.h"
+#include "ccze-private.h"
+#include "ccze-color.c"
+
+#define ESC 0x1b
+
+const char *argp_program_name = "ccze-render";
+const char *argp_program_version = "ccze-render (ccze 0.2." PATCHLEVEL ")";
+const char *argp_program_bug_address = "<algernon@bonehunter.rulez.org>";
+static struct argp_option options[] = {
+  {NULL, 0, NULL, 0, "", 1},
+  {"rcfile", 'F', "FILE", 0, "Read configuration from FILE", 1},
+  {"mode", 'm', "MODE", 0, "Change the output mode\n"
+   "(Available modes are ansi, html and debug.)", 1},
+  {"options", 'o', "OPTIONS...", 0, "Toggle some options\n"
+   "(such as transparent, cssfile, or hashcolor)", 1},
+  {"start", 's', "LINE", 0, "Start at the LINEth line (counting from 0)", 1},
+  {"lines", 'n', "COUNT", 0, "Render only COUNT lines", 1},
+  {NULL, 0, NULL, 0,  NULL, 0}
+};
+
+ccze_config_t ccze_config = {
+  .scroll = 1,
+  .convdate = 0,
+  .remfac = 0,
+  .wcol = 1,
+  .slookup = 1,
+  .rcfile = NULL,
+  .cssfile = NULL,
+  .transparent = 1,
+  .pluginlist_len = 0,
+  .pluginlist_alloc = 10,
+  .color_argv_len = 0,
+  .color_argv_alloc = 10,
+  .mode = CCZE_MODE_RAW_ANSI
+};
+
+/* The mail queue is not followed here: the message IDs of a token
+   stream are colored by their hash, with -o hashcolor. */
+int
+ccze_mailq_color (const char *str, size_t len)
+{
+  return -1;
+}
+
+static error_t parse_opt (int key, char *arg, struct argp_state *state);
+static struct argp argp =
+  {options, parse_opt, "[FILE]", "ccze-render -- render ccze token streams",
+   NULL, NULL, NULL};
+
+static char *infile = NULL;
+static uint64_t start_line = 0, max_lines = (uint64_t)-1;
+
+static char *o_subopts[] = {
+  "transparent",
+  "notransparent",
+  "cssfile",
+  "nocssfile",
+  "hashcolor",
+  "nohashcolor",
+  NULL
+};
+
+static error_t
+parse_opt (int key, char *arg, struct argp_state *state)
+{
+  char *subopts, *value;
+
+  switch (key)
+    {
+    case 'F':
+      ccze_config.rcfile = arg;
+      break;
+    case 'm':
+      if (!strcmp (arg, "ansi"))
+	ccze_config.mode = CCZE_MODE_RAW_ANSI;
+      else if (!strcmp (arg, "html"))
+	ccze_config.mode = CCZE_MODE_HTML;
+      else if (!strcmp (arg, "debug"))
+	ccze_config.mode = CCZE_MODE_DEBUG;
+      else
+	argp_error (state, "unrecognised mode: `%s'", arg);
+      break;
+    case 'o':
+      subopts = arg;
+      while (*subopts != '\0')
+	{
+	  switch (getsubopt (&subopts, o_subopts, &value))
+	    {
+	    case 0:
+	      ccze_config.transparent = 1;
+	      break;
+	    case 1:
+	      ccze_config.transparent = 0;
+	      break;
+	    case 2:
+	      if (value)
+		ccze_config.cssfile = value;
+	      break;
+	    case 3:
+	      ccze_config.cssfile = NULL;
+	      break;
+	    case 4:
+	      ccze_config.hashcolor = 1;
+	      break;
+	    case 5:
+	      ccze_config.hashcolor = 0;
+	      break;
+	    default:
+	      argp_error (state, "unrecognised option: `%s'", value);
+	      break;
+	    }
+	}
+      break;
+    case 's':
+      start_line = strtoull (arg, NULL, 10);
+      break;
+    case 'n':
+      max_lines = strtoull (arg, NULL, 10);
+      break;
+    case ARGP_KEY_ARG:
+      if (infile)
+	argp_error (state, "only one FILE can be given");
+      infile = arg;
+      break;
+    default:
+      return ARGP_ERR_UNKNOWN;
+    }
+  return 0;
+}
+
+/* The whole stream, mapped if it is a file, read otherwise. */
+static const unsigned char *
+_ccze_render_load (int fd, size_t *size)
+{
+  struct stat st;
+  unsigned char *buf = NULL;
+  size_t len = 0, alloc = 0;
+  ssize_t n;
+
+  if (!fstat (fd, &st) && S_ISREG (st.st_mode) && st.st_size > 0)
+    {
+      void *map = mmap (NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+      if (map != MAP_FAILED)
+	{
+	  *size = st.st_size;
+	  return (const unsigned char *)map;
+	}
+    }
+
+  do
+    {
+      if (len == alloc)
+	{
+	  alloc = (alloc) ? alloc * 2 : 1024 * 1024;
+	  buf = (unsigned char *)ccze_realloc (buf, alloc);
+	}
+      n = read (fd, buf + len, alloc - len);
+      if (n > 0)
+	len += n;
+    } while (n > 0 || (n < 0 && errno == EINTR));
+
+  *size = len;
+  return buf;
+}
+
+static uint64_t
+_ccze_render_le (const unsigned char *p, int bytes)
+{
+  uint64_t v = 0;
+  int i;
+
+  for (i = bytes - 1; i >= 0; i--)
+    v = (v << 8) | p[i];
+  return v;
+}
+
+/* Decode a varint from [*P, END). Returns -1 if it is cut short. */
+static int
+_ccze_render_varint (const unsigned char **p, const unsigned char *end,
+		     size_t *v)
+{
+  int shift = 0;
+
+  *v = 0;
+  while (*p < end && shift < 64)
+    {
+      unsigned char c = *(*p)++;
+
+      *v |= (size_t)(c & 0x7f) << shift;
+      if (!(c & 0x80))
+	return 0;
+      shift += 7;
+    }
+  return -1;
+}
+
+static ccze_run_t *runs;
+static size_t runs_alloc;
+
+/* Render the line at P, which may not go past END. */
+static int
+_ccze_render_line (const unsigned char *p, const unsigned char *end)
+{
+  size_t nruns, n = 0, i, len, textlen = 0;
+
+  if (_ccze_render_varint (&p, end, &nruns))
+    return -1;
+  for (i = 0; i < nruns; i++)
+    {
+      int col, flags;
+
+      if (p >= end)
+	return -1;
+      col = *p & ~CCZE_TOKENS_NBSP;
+      flags = (*p++ & CCZE_TOKENS_NBSP) ? CCZE_RUN_NBSP : 0;
+      if (col >= CCZE_COLOR_LAST || _ccze_render_varint (&p, end, &len))
+	return -1;
+      textlen += len;
+
+      /* ccze_print_runs() wants the long runs split. */
+      do
+	{
+	  size_t chunk = (len > CCZE_RUN_MAXLEN) ? CCZE_RUN_MAXLEN : len;
+
+	  if (n >= runs_alloc)
+	    {
+	      runs_alloc = (runs_alloc) ? runs_alloc * 2 : 256;
+	      runs = (ccze_run_t *)ccze_realloc
+		(runs, runs_alloc * sizeof (ccze_run_t));
+	    }
+	  runs[n].color = (unsigned char)col;
+	  runs[n].flags = (unsigned char)flags;
+	  runs[n].len = (unsigned short)chunk;
+	  n++;
+	  flags |= CCZE_RUN_CONT;
+	  len -= chunk;
+	} while (len > 0);
+    }
+  if (textlen > (size_t)(end - p))
+    return -1;
+
+  ccze_print_runs ((const char *)p, runs, n);
+  if (ccze_config.mode == CCZE_MODE_HTML)
+    fputs ("<br>\n", stdout);
+  else
+    putchar ('\n');
+  return 0;
+}
+
+/* Render the stream in BUF, of SIZE bytes. Blocks before the first
+   wanted line are skipped over by their size alone. */
+static int
+_ccze_render (const unsigned char *buf, size_t size)
+{
+  const unsigned char *p = buf + 8, *end = buf + size;
+  uint64_t left = max_lines;
+
+  if (size < 8 || memcmp (buf, CCZE_TOKENS_MAGIC, 8))
+    return -1;
+
+  while (p < end && left > 0)
+    {
+      const unsigned char *offs, *body;
+      uint64_t first, i;
+      size_t bsize, nlines;
+
+      if (end - p < 20 || memcmp (p, "CZB1", 4))
+	return -1;
+      bsize = _ccze_render_le (p + 4, 4);
+      nlines = _ccze_render_le (p + 8, 4);
+      first = _ccze_render_le (p + 12, 8);
+      offs = p + 20;
+      body = offs + nlines * 4;
+      if ((size_t)(end - offs) < nlines * 4 ||
+	  (size_t)(end - body) < bsize)
+	return -1;
+      p = body + bsize;
+
+      if (first + nlines <= start_line)
+	continue;
+      for (i = (start_line > first) ? start_line - first : 0;
+	   i < nlines && left > 0; i++, left--)
+	{
+	  size_t off = _ccze_render_le (offs + i * 4, 4);
+	  size_t next = (i + 1 < nlines) ?
+	    _ccze_render_le (offs + (i + 1) * 4, 4) : bsize;
+
+	  if (off > next || next > bsize ||
+	      _ccze_render_line (body + off, body + next))
+	    return -1;
+	}
+    }
+  return 0;
+}
+
+int
+main (int argc, char *argv[])
+{
+  const unsigned char *buf;
+  size_t size;
+  int fd = STDIN_FILENO;
+
+  ccze_out = stdout;
+  argp_parse (&argp, argc, argv, 0, 0, NULL);
+
+  ccze_color_init ();
+  if (ccze_config.rcfile)
+    ccze_color_load (ccze_config.rcfile);
+  else
+    {
+      char *home, *homerc;
+
+      ccze_color_load (SYSCONFDIR "/colorizerc");
+      ccze_color_load (SYSCONFDIR "/cczerc");
+      home = getenv ("HOME");
+      if (home)
+	{
+	  asprintf (&homerc, "%s/.colorizerc", home);
+	  ccze_color_load (homerc);
+	  free (homerc);
+	  asprintf (&homerc, "%s/.cczerc", home);
+	  ccze_color_load (homerc);
+	  free (homerc);
+	}
+    }
+
+  if (infile && (fd = open (infile, O_RDONLY)) < 0)
+    {
+      fprintf (stderr, "ccze-render: Cannot open %s: %s\n", infile,
+	       strerror (errno));
+      return 1;
+    }
+  buf = _ccze_render_load (fd, &size);
+
+  if (ccze_config.mode == CCZE_MODE_HTML)
+    {
+      printf
+	("<!DOCTYPE HTML PUBLIC \"-//W3C//DTD HTML 4.01//Transitional//EN\">\n"
+	 "<html>\n<head>\n<meta name=\"generator\" content=\"%s\">\n",
+	 argp_program_version);
+      if (ccze_config.cssfile)
+	printf ("<link rel=\"stylesheet\" href=\"%s\">\n",
+		ccze_config.cssfile);
+      else
+	{
+	  printf ("<style type=\"text/css\">\n"
+		  "body { font: 10pt courier; white-space: nowrap }\n");
+	  ccze_colors_to_css ();
+	  printf ("</style>\n");
+	}
+      printf ("<title>Log colorisation generated by %s</title>\n"
+	      "</head>\n<body bgcolor=\"%s\">\n\n",
+	      argp_program_version, ccze_cssbody_color ());
+    }
+
+  if (_ccze_render (buf, size))
+    {
+      fflush (stdout);
+      fprintf (stderr, "ccze-render: %s: not a valid token stream\n",
+	       (infile) ? infile : "stdin");
+      return 1;
+    }
+
+  if (ccze_config.mode == CCZE_MODE_HTML)
+    printf ("\n</body>\n</html>\n");
+  else if (ccze_config.mode == CCZE_MODE_RAW_ANSI)
+    printf ("%c[0m", ESC);
+  return 0;
+}
@@ -0,0 +1,415 @@
+/* -*- mode: c; c-file-style: "gnu" -*-
+ * ccze-ring.c -- Reading the input ahead of the colorizer
+ * Copyright (C) 2003 Gergely Nagy <algernon@bonehunter.rulez.org>
+ *
+ * This file is part of ccze.
+ *
+ * ccze is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ccze is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+
+#include <ccze.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "ccze-private.h"
+
+/* With --buffer, a process of its own reads the input, and hands the
+   lines over through a ring in shared memory, so that however long
+   the terminal keeps the colorizer waiting, the program writing the
+   log is not: it only has to wait when the ring is full, and with
+   --overflow=drop or summary, not even then.
+
+   The ring is a single producer, single consumer queue of records:
+   a 32 bit length, then that many bytes, which are a line, or a piece
+   of one longer than CCZE_RING_RECORD_MAX. Head and tail count bytes
+   from the start, and only ever grow; they are updated with atomic
+   operations, and neither side ever takes a lock. When dropping, the
+   reader takes the oldest line off the tail itself, all its pieces at
+   once, so the tail is moved with compare-and-swap by both sides: the
+   colorizer copies a record first, and only keeps it if the tail did
+   not move under it. Lines are dropped whole: if the colorizer already
+   has the first pieces of one, it finds the next record is not the
+   rest of it, and throws them away too.
+
+   The pipes are only for sleeping: the reader writes a byte into one
+   after adding lines, and when blocked, waits for the colorizer to
+   write one into the other after taking some. */
+#define CCZE_RING_MORE 0x80000000U	/* The line goes on in the next. */
+#define CCZE_RING_CONT 0x40000000U	/* This is not its first piece. */
+#define CCZE_RING_LEN 0x3fffffffU
+
+typedef struct
+{
+  uint64_t head, tail;
+  uint64_t dropped;
+  int eof;
+  int waiting;
+  size_t size;
+  unsigned char data[];
+} ccze_ring_t;
+
+static ccze_ring_t *ring;
+static pid_t reader = -1;
+static int notify_fd = -1, wakeup_fd = -1;
+static ccze_ring_policy_t ring_policy;
+static uint64_t reported;
+/* The reader is throwing away the rest of a line it dropped the start
+   of; the colorizer has the start of a line. */
+static int skipping, midline;
+
+static void
+_ccze_ring_get (uint64_t pos, void *dst, size_t len)
+{
+  size_t off = pos & (ring->size - 1), first = ring->size - off;
+
+  if (first > len)
+    first = len;
+  memcpy (dst, ring->data + off, first);
+  memcpy ((unsigned char *)dst + first, ring->data, len - first);
+}
+
+static void
+_ccze_ring_put (uint64_t pos, const void *src, size_t len)
+{
+  size_t off = pos & (ring->size - 1), first = ring->size - off;
+
+  if (first > len)
+    first = len;
+  memcpy (ring->data + off, src, first);
+  memcpy (ring->data, (const unsigned char *)src + first, len - first);
+}
+
+/* Drop the oldest line, or the pieces of it in the ring, if the
+   reader is still adding them. */
+static void
+_ccze_ring_drop (uint64_t tail)
+{
+  uint64_t end = tail;
+  uint32_t w;
+
+  do
+    {
+      _ccze_ring_get (end, &w, sizeof (w));
+      end += sizeof (w) + (w & CCZE_RING_LEN);
+    }
+  while ((w & CCZE_RING_MORE) && end < ring->head);
+
+  if (!__atomic_compare_exchange_n (&ring->tail, &tail, end, 0,
+				    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+    return;
+  if (w & CCZE_RING_MORE)
+    skipping = 1;
+  else
+    __atomic_add_fetch (&ring->dropped, 1, __ATOMIC_RELEASE);
+}
+
+/* Make room for NEED bytes, the way the policy says. Returns non-zero
+   if the colorizer is gone. */
+static int
+_ccze_ring_room (size_t need)
+{
+  uint64_t head = ring->head, tail;
+  char c;
+
+  while (head + need - (tail = __atomic_load_n (&ring->tail,
+						 __ATOMIC_ACQUIRE)) >
+	 ring->size)
+    {
+      if (ring_policy == CCZE_RING_BLOCK)
+	{
+	  __atomic_store_n (&ring->waiting, 1, __ATOMIC_SEQ_CST);
+	  if (__atomic_load_n (&ring->tail, __ATOMIC_SEQ_CST) != tail)
+	    continue;
+	  if (read (wakeup_fd, &c, 1) == 0)
+	    return -1;
+	}
+      else
+	_ccze_ring_drop (tail);
+    }
+  __atomic_store_n (&ring->waiting, 0, __ATOMIC_SEQ_CST);
+  return 0;
+}
+
+/* Add a piece of a line, FLAGS telling which. */
+static int
+_ccze_ring_push (const char *str, size_t len, uint32_t flags)
+{
+  uint32_t l = (uint32_t)len | flags;
+
+  if (!skipping && _ccze_ring_room (sizeof (l) + len))
+    return -1;
+  if (skipping)
+    {
+      if (!(flags & CCZE_RING_MORE))
+	{
+	  skipping = 0;
+	  __atomic_add_fetch (&ring->dropped, 1, __ATOMIC_RELEASE);
+	}
+      return 0;
+    }
+  _ccze_ring_put (ring->head, &l, sizeof (l));
+  _ccze_ring_put (ring->head + sizeof (l), str, len);
+  __atomic_store_n (&ring->head, ring->head + sizeof (l) + len,
+		    __ATOMIC_RELEASE);
+  return 0;
+}
+
+/* The reader: split what comes from FD into lines, and add them to
+   the ring, until the end of the input. */
+static void __attribute__ ((noreturn))
+_ccze_ring_reader (int fd)
+{
+  char *buf = (char *)ccze_malloc (2 * CCZE_RING_RECORD_MAX);
+  size_t len = 0, start;
+  ssize_t n;
+  uint32_t cont = 0;
+  char c = 0;
+
+  for (;;)
+    {
+      n = read (fd, buf + len, 2 * CCZE_RING_RECORD_MAX - len);
+      if (n < 0 && errno == EINTR)
+	continue;
+      if (n <= 0)
+	break;
+      len += n;
+
+      for (start = 0; start < len; )
+	{
+	  char *nl = (char *)memchr (buf + start, '\n', len - start);
+	  size_t l = (nl) ? (size_t)(nl - buf) + 1 - start : len - start;
+	  uint32_t more = 0;
+
+	  if (l > CCZE_RING_RECORD_MAX)
+	    {
+	      l = CCZE_RING_RECORD_MAX;
+	      more = CCZE_RING_MORE;
+	    }
+	  else if (!nl)
+	    break;
+	  if (_ccze_ring_push (buf + start, l, more | cont))
+	    _exit (0);
+	  cont = (more) ? CCZE_RING_CONT : 0;
+	  start += l;
+	}
+      memmove (buf, buf + start, len - start);
+      len -= start;
+      write (notify_fd, &c, 1);
+    }
+
+  if (len)
+    _ccze_ring_push (buf, len, cont);
+  __atomic_store_n (&ring->eof, 1, __ATOMIC_RELEASE);
+  _exit (0);
+}
+
+/* Start reading FD ahead, into a ring of SIZE bytes (rounded up to a
+   power of two). Returns the descriptor to wait on for lines, or -1
+   if there is to be no ring. */
+int
+ccze_ring_start (int fd, size_t size, ccze_ring_policy_t policy)
+{
+  int notify[2], wakeup[2];
+  size_t s = 65536;
+
+  while (s < size)
+    s *= 2;
+  ring = (ccze_ring_t *)mmap (NULL, sizeof (ccze_ring_t) + s,
+			      PROT_READ | PROT_WRITE,
+			      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (ring == (ccze_ring_t *)MAP_FAILED)
+    {
+      ring = NULL;
+      return -1;
+    }
+  memset (ring, 0, sizeof (ccze_ring_t));
+  ring->size = s;
+  ring_policy = policy;
+
+  if (pipe (notify))
+    goto fail;
+  if (pipe (wakeup))
+    {
+      close (notify[0]);
+      close (notify[1]);
+      goto fail;
+    }
+
+  if ((reader = fork ()) == 0)
+    {
+      close (notify[0]);
+      close (wakeup[1]);
+      notify_fd = notify[1];
+      wakeup_fd = wakeup[0];
+      /* A full pipe already says there is something to read. */
+      fcntl (notify_fd, F_SETFL, O_NONBLOCK);
+      signal (SIGHUP, SIG_IGN);
+      _ccze_ring_reader (fd);
+    }
+
+  close (notify[1]);
+  if (reader < 0)
+    {
+      close (notify[0]);
+      close (wakeup[0]);
+      close (wakeup[1]);
+      goto fail;
+    }
+  /* The read end of the wakeup pipe is kept open, so that waking a
+     reader already gone cannot kill us with SIGPIPE. */
+  close (fd);
+  notify_fd = notify[0];
+  wakeup_fd = wakeup[1];
+  fcntl (notify_fd, F_SETFL, O_NONBLOCK);
+  fcntl (wakeup_fd, F_SETFL, O_NONBLOCK);
+  return notify_fd;
+
+ fail:
+  munmap (ring, sizeof (ccze_ring_t) + s);
+  ring = NULL;
+  return -1;
+}
+
+/* Whether there are lines in the ring, or dropped ones to tell of. */
+int
+ccze_ring_pending (void)
+{
+  return (ring &&
+	  (__atomic_load_n (&ring->head, __ATOMIC_ACQUIRE) !=
+	   __atomic_load_n (&ring->tail, __ATOMIC_ACQUIRE) ||
+	   __atomic_load_n (&ring->dropped, __ATOMIC_ACQUIRE) != reported));
+}
+
+/* Copy whole records into BUF, which has room for LEN bytes, at least
+   CCZE_RING_RECORD_MAX of them. If lines were dropped before the next
+   one, stop there, and add how many to *DROPPED; if the rest of the
+   line the last call ended in the middle of was dropped, stop too,
+   and set *CUT, for the caller to throw away its start. Returns the
+   number of bytes copied, 0 at the end of the input, and -1, with
+   errno set to EAGAIN, if there is nothing yet: the descriptor
+   ccze_ring_start returned becomes readable when there is. */
+ssize_t
+ccze_ring_read (char *buf, size_t len, unsigned long *dropped, int *cut)
+{
+  unsigned long gap = 0;
+  uint64_t d;
+  size_t n;
+  char tmp[256];
+  ssize_t r;
+
+  *cut = 0;
+  for (;;)
+    {
+      /* Once the end is known, so is the last line. */
+      int eof = __atomic_load_n (&ring->eof, __ATOMIC_ACQUIRE);
+      uint64_t head = __atomic_load_n (&ring->head, __ATOMIC_ACQUIRE);
+      uint64_t tail = __atomic_load_n (&ring->tail, __ATOMIC_ACQUIRE);
+
+      n = 0;
+      while (tail < head)
+	{
+	  uint32_t w, l;
+
+	  d = __atomic_load_n (&ring->dropped, __ATOMIC_ACQUIRE);
+	  if (d != reported)
+	    {
+	      gap = (unsigned long)(d - reported);
+	      reported = d;
+	      break;
+	    }
+	  _ccze_ring_get (tail, &w, sizeof (w));
+	  l = w & CCZE_RING_LEN;
+	  if (l > CCZE_RING_RECORD_MAX || sizeof (w) + l > head - tail)
+	    {
+	      /* Being dropped by the reader as we look. */
+	      tail = __atomic_load_n (&ring->tail, __ATOMIC_ACQUIRE);
+	      continue;
+	    }
+	  if (midline && !(w & CCZE_RING_CONT))
+	    {
+	      midline = 0;
+	      *cut = 1;
+	      break;
+	    }
+	  if (n + l > len)
+	    break;
+	  /* If the reader dropped it meanwhile, the copy may be torn,
+	     and the CAS fails. */
+	  _ccze_ring_get (tail + sizeof (w), buf + n, l);
+	  if (__atomic_compare_exchange_n (&ring->tail, &tail,
+					   tail + sizeof (w) + l, 0,
+					   __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+	    {
+	      n += l;
+	      tail += sizeof (w) + l;
+	      midline = ((w & CCZE_RING_MORE) != 0);
+	    }
+	}
+      /* Lines may have been dropped with nothing after them yet. */
+      d = __atomic_load_n (&ring->dropped, __ATOMIC_ACQUIRE);
+      if (!n && !gap && d != reported)
+	{
+	  gap = (unsigned long)(d - reported);
+	  reported = d;
+	}
+
+      if (n || gap || *cut)
+	{
+	  *dropped += gap;
+	  if (__atomic_exchange_n (&ring->waiting, 0, __ATOMIC_SEQ_CST))
+	    write (wakeup_fd, "", 1);
+	  return n;
+	}
+      if (eof && tail >= head)
+	return 0;
+
+      /* Nothing in the ring: take what the reader said of it, as it
+	 may be about lines already taken, and look again. */
+      if ((r = read (notify_fd, tmp, sizeof (tmp))) > 0)
+	continue;
+      if (r < 0)
+	return -1;
+      if (!__atomic_load_n (&ring->eof, __ATOMIC_ACQUIRE) &&
+	  __atomic_load_n (&ring->head, __ATOMIC_ACQUIRE) == tail)
+	return 0;
+    }
+}
+
+/* The number of lines dropped so far. */
+unsigned long
+ccze_ring_dropped (void)
+{
+  return (ring) ? (unsigned long)__atomic_load_n (&ring->dropped,
+						  __ATOMIC_ACQUIRE) : 0;
+}
+
+void
+ccze_ring_stop (void)
+{
+  if (reader > 0)
+    {
+      kill (reader, SIGTERM);
+      waitpid (reader, NULL, 0);
+      reader = -1;
+    }
+}
@@ -0,0 +1,651 @@
+/* -*- mode: c; c-file-style: "gnu" -*-
+ * ccze-scroll.c -- Scrollback buffer and pager for the curses mode
+ * Copyright (C) 2003 Gergely Nagy <algernon@bonehunter.rulez.org>
+ *
+ * This file is part of ccze.
+ *
+ * ccze is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ccze is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include <ccze.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ccze-private.h"
+
+/* One retained line: the header is followed by NRUNS runs, then by LEN
+   bytes of text, all in one allocation. FILTER_GEN tells which filter
+   FILTER_MATCH belongs to. */
+typedef struct
+{
+  size_t len;
+  size_t nruns;
+  unsigned int filter_gen;
+  int filter_match;
+} ccze_scroll_line_t;
+
+#define SCROLL_LINE_RUNS(l) ((ccze_run_t *)((l) + 1))
+#define SCROLL_LINE_TEXT(l) ((char *)(SCROLL_LINE_RUNS (l) + (l)->nruns))
+#define SCROLL_LINE_SIZE(l) (sizeof (ccze_scroll_line_t) + \
+			     (l)->nruns * sizeof (ccze_run_t) + (l)->len)
+
+/* How many lines to filter or search through between two looks at
+   the input. */
+#define SCROLL_WORK_CHUNK 2048
+
+static ccze_scroll_line_t **ring;
+static size_t ring_alloc, ring_head, ring_count;
+static size_t scroll_used, scroll_cap;
+
+/* Number of lines between the bottom of the view and the end of the
+   buffer. Zero means we are at the end. */
+static size_t scroll_offset;
+static int scroll_paused, scroll_eof;
+
+/* The live filter (&pattern) and the search (/pattern). Positions are
+   kept as distances from the end of the buffer, so they survive
+   eviction of old lines. */
+static pcre *filter_re, *search_re;
+static pcre_extra *filter_hints, *search_hints;
+static unsigned int filter_gen;
+static size_t filter_todo;
+static size_t search_from;
+static int search_pending, search_dir;
+static char *scroll_msg;
+
+/* The prompt for / and &, while it is being typed. */
+static int prompt_type, prompt_follow;
+static char prompt[256];
+static size_t prompt_len;
+
+#define RING_AT(i) ring[(ring_head + (i)) % ring_alloc]
+
+void
+ccze_scroll_init (size_t cap)
+{
+  scroll_cap = cap;
+  scroll_used = 0;
+  scroll_offset = 0;
+  scroll_paused = 0;
+  scroll_eof = 0;
+  ring_head = ring_count = 0;
+  ring_alloc = 1024;
+  ring = (ccze_scroll_line_t **)ccze_calloc (ring_alloc,
+					     sizeof (ccze_scroll_line_t *));
+}
+
+void
+ccze_scroll_shutdown (void)
+{
+  size_t i;
+
+  if (!ring)
+    return;
+  for (i = 0; i < ring_count; i++)
+    free (RING_AT (i));
+  free (ring);
+  ring = NULL;
+  ring_alloc = ring_head = ring_count = 0;
+  scroll_used = 0;
+
+  free (filter_re);
+  free (filter_hints);
+  free (search_re);
+  free (search_hints);
+  filter_re = search_re = NULL;
+  filter_hints = search_hints = NULL;
+}
+
+static int
+_ccze_scroll_match (pcre *re, pcre_extra *hints, const char *text,
+		    size_t len)
+{
+  int offsets[3];
+
+  return pcre_exec (re, hints, text, (int)len, 0, 0, offsets, 3) >= 0;
+}
+
+/* Whether line I passes the filter. Lines the filter has not seen yet
+   are not shown until the background scan gets to them. */
+static int
+_ccze_scroll_visible (size_t i)
+{
+  ccze_scroll_line_t *l = RING_AT (i);
+
+  if (!filter_re)
+    return 1;
+  return (l->filter_gen == filter_gen && l->filter_match);
+}
+
+static void
+_ccze_scroll_filter_one (ccze_scroll_line_t *l)
+{
+  l->filter_gen = filter_gen;
+  l->filter_match = (filter_re) ?
+    _ccze_scroll_match (filter_re, filter_hints, SCROLL_LINE_TEXT (l),
+			l->len) : 1;
+}
+
+static void
+_ccze_scroll_evict (void)
+{
+  ccze_scroll_line_t *l = RING_AT (0);
+
+  scroll_used -= SCROLL_LINE_SIZE (l);
+  free (l);
+  ring_head = (ring_head + 1) % ring_alloc;
+  ring_count--;
+}
+
+static void
+_ccze_scroll_grow (void)
+{
+  ccze_scroll_line_t **nring;
+  size_t i;
+
+  nring = (ccze_scroll_line_t **)ccze_calloc (ring_alloc * 2,
+					      sizeof (ccze_scroll_line_t *));
+  for (i = 0; i < ring_count; i++)
+    nring[i] = RING_AT (i);
+  free (ring);
+  ring = nring;
+  ring_head = 0;
+  ring_alloc *= 2;
+}
+
+static void
+_ccze_scroll_clamp (void)
+{
+  if (ring_count == 0)
+    scroll_offset = 0;
+  else if (scroll_offset > ring_count - 1)
+    scroll_offset = ring_count - 1;
+  if (filter_todo > ring_count)
+    filter_todo = ring_count;
+  if (search_from > ring_count)
+    search_from = ring_count;
+}
+
+static ccze_scroll_line_t *
+_ccze_scroll_push (const char *text, size_t len, const ccze_run_t *runs,
+		   size_t nruns)
+{
+  ccze_scroll_line_t *l;
+  size_t size;
+
+  size = sizeof (ccze_scroll_line_t) + nruns * sizeof (ccze_run_t) + len;
+  if (!ring || size > scroll_cap)
+    return NULL;
+
+  while (ring_count > 0 && scroll_used + size > scroll_cap)
+    _ccze_scroll_evict ();
+  if (ring_count == ring_alloc)
+    _ccze_scroll_grow ();
+
+  l = (ccze_scroll_line_t *)ccze_malloc (size);
+  l->len = len;
+  l->nruns = nruns;
+  memcpy (SCROLL_LINE_RUNS (l), runs, nruns * sizeof (ccze_run_t));
+  memcpy (SCROLL_LINE_TEXT (l), text, len);
+  _ccze_scroll_filter_one (l);
+
+  RING_AT (ring_count) = l;
+  ring_count++;
+  scroll_used += size;
+
+  /* Keep the view pinned to the same lines while we are not
+     following the end. */
+  if (!ccze_scroll_following ())
+    scroll_offset++;
+  if (search_pending)
+    search_from++;
+  if (filter_todo)
+    filter_todo++;
+  _ccze_scroll_clamp ();
+
+  return l;
+}
+
+int
+ccze_scroll_following (void)
+{
+  return !scroll_paused && scroll_offset == 0 && !prompt_type;
+}
+
+/* Find the first match of the search in TEXT at or after FROM. */
+static int
+_ccze_scroll_search_next (const char *text, size_t len, size_t from,
+			  size_t *start, size_t *end)
+{
+  int offsets[3];
+
+  while (from <= len &&
+	 pcre_exec (search_re, search_hints, text, (int)len, (int)from, 0,
+		    offsets, 3) >= 0)
+    {
+      if (offsets[1] > offsets[0])
+	{
+	  *start = offsets[0];
+	  *end = offsets[1];
+	  return 1;
+	}
+      from = offsets[1] + 1;
+    }
+  *start = *end = len;
+  return 0;
+}
+
+/* Draw a line at the cursor, with search matches highlighted over the
+   colors of the runs. */
+static void
+_ccze_scroll_draw (const char *text, size_t len, const ccze_run_t *runs,
+		   size_t nruns)
+{
+  size_t i, off = 0, mstart = len, mend = len;
+
+  if (!search_re)
+    {
+      ccze_print_runs (text, runs, nruns);
+      addstr ("\n");
+      return;
+    }
+
+  _ccze_scroll_search_next (text, len, 0, &mstart, &mend);
+  for (i = 0; i < nruns; i++)
+    {
+      size_t pos = off, rend = off + runs[i].len;
+      int attr = ccze_color (runs[i].color);
+
+      while (pos < rend)
+	{
+	  size_t seg;
+
+	  if (pos >= mend)
+	    _ccze_scroll_search_next (text, len, mend, &mstart, &mend);
+	  if (pos < mstart)
+	    {
+	      seg = ((mstart < rend) ? mstart : rend) - pos;
+	      attrset (attr);
+	    }
+	  else
+	    {
+	      seg = ((mend < rend) ? mend : rend) - pos;
+	      attrset (attr | A_REVERSE);
+	    }
+	  addnstr (text + pos, (int)seg);
+	  pos += seg;
+	}
+      off = rend;
+    }
+  attrset (A_NORMAL);
+  addstr ("\n");
+}
+
+void
+ccze_scroll_line (const char *text, size_t len, const ccze_run_t *runs,
+		  size_t nruns)
+{
+  ccze_scroll_line_t *l = _ccze_scroll_push (text, len, runs, nruns);
+  int visible;
+
+  if (!ccze_scroll_following ())
+    return;
+
+  if (l)
+    visible = l->filter_match;
+  else
+    visible = !filter_re ||
+      _ccze_scroll_match (filter_re, filter_hints, text, len);
+
+  if (visible)
+    _ccze_scroll_draw (text, len, runs, nruns);
+}
+
+void
+ccze_scroll_eof (void)
+{
+  scroll_eof = 1;
+  if (!ccze_scroll_following ())
+    ccze_scroll_redraw ();
+}
+
+static size_t
+_ccze_scroll_page (void)
+{
+  return (LINES > 2) ? (size_t)(LINES - 2) : 1;
+}
+
+/* Walk N visible lines back from END (an exclusive index). */
+static size_t
+_ccze_scroll_back (size_t end, size_t n)
+{
+  while (end > 0 && n > 0)
+    {
+      end--;
+      if (_ccze_scroll_visible (end))
+	n--;
+    }
+  return end;
+}
+
+/* Walk N visible lines forward from END. */
+static size_t
+_ccze_scroll_forward (size_t end, size_t n)
+{
+  while (end < ring_count && n > 0)
+    {
+      if (_ccze_scroll_visible (end))
+	n--;
+      end++;
+    }
+  return end;
+}
+
+static void
+_ccze_scroll_status (size_t end)
+{
+  char *filter = (filter_re) ? ", filtered" : "";
+
+  attrset (A_REVERSE);
+  move (LINES - 1, 0);
+  clrtoeol ();
+  if (prompt_type)
+    mvprintw (LINES - 1, 0, "%c%.*s", prompt_type, (int)prompt_len, prompt);
+  else if (scroll_msg)
+    mvprintw (LINES - 1, 0, "-- %s --", scroll_msg);
+  else
+    mvprintw (LINES - 1, 0, "-- %s: line %lu of %lu (%lu kB)%s%s%s --",
+	      (scroll_paused) ? "Paused" : "Scrollback",
+	      (unsigned long)end, (unsigned long)ring_count,
+	      (unsigned long)(scroll_used / 1024), filter,
+	      (search_pending || filter_todo) ? ", searching" : "",
+	      (scroll_eof) ? ", end of input" : "");
+  attrset (A_NORMAL);
+}
+
+void
+ccze_scroll_redraw (void)
+{
+  size_t start, end, i;
+  size_t page = (LINES > 1) ? (size_t)(LINES - 1) : 1;
+
+  if (!ring)
+    return;
+
+  erase ();
+  move (0, 0);
+
+  end = ring_count - scroll_offset;
+  start = _ccze_scroll_back (end, page);
+  for (i = start; i < end; i++)
+    {
+      ccze_scroll_line_t *l = RING_AT (i);
+
+      if (_ccze_scroll_visible (i))
+	_ccze_scroll_draw (SCROLL_LINE_TEXT (l), l->len,
+			   SCROLL_LINE_RUNS (l), l->nruns);
+    }
+
+  if (!ccze_scroll_following () || scroll_msg)
+    _ccze_scroll_status (end);
+  refresh ();
+}
+
+static int
+_ccze_scroll_compile (const char *pattern, pcre **re, pcre_extra **hints)
+{
+  const char *error;
+  int errptr;
+  pcre *nre;
+
+  nre = pcre_compile (pattern, 0, &error, &errptr, NULL);
+  if (!nre)
+    return -1;
+
+  free (*re);
+  free (*hints);
+  *re = nre;
+  *hints = pcre_study (nre, 0, &error);
+  return 0;
+}
+
+/* Search DIR (-1 is towards older lines) from the bottom of the
+   view. */
+static void
+_ccze_scroll_search_start (int dir)
+{
+  if (!search_re)
+    return;
+  search_dir = dir;
+  search_from = scroll_offset + ((dir < 0) ? 1 : 0);
+  search_pending = 1;
+  scroll_msg = NULL;
+}
+
+static void
+_ccze_scroll_prompt_done (void)
+{
+  int type = prompt_type;
+
+  prompt[prompt_len] = '\0';
+  prompt_type = 0;
+  scroll_msg = NULL;
+
+  if (type == '&')
+    {
+      if (!prompt_len)
+	{
+	  free (filter_re);
+	  free (filter_hints);
+	  filter_re = NULL;
+	  filter_hints = NULL;
+	}
+      else if (_ccze_scroll_compile (prompt, &filter_re, &filter_hints))
+	{
+	  scroll_msg = "Invalid pattern";
+	  return;
+	}
+      /* Re-filter everything, newest lines first. */
+      filter_gen++;
+      filter_todo = ring_count;
+      scroll_offset = 0;
+      return;
+    }
+
+  if (!prompt_len)
+    {
+      free (search_re);
+      free (search_hints);
+      search_re = NULL;
+      search_hints = NULL;
+      search_pending = 0;
+      return;
+    }
+  if (_ccze_scroll_compile (prompt, &search_re, &search_hints))
+    {
+      scroll_msg = "Invalid pattern";
+      return;
+    }
+  scroll_paused = 1;
+  _ccze_scroll_search_start (-1);
+}
+
+static void
+_ccze_scroll_prompt_key (int key)
+{
+  switch (key)
+    {
+    case '\r':
+    case '\n':
+    case KEY_ENTER:
+      _ccze_scroll_prompt_done ();
+      break;
+    case 27: /* Escape */
+      prompt_type = 0;
+      break;
+    case KEY_BACKSPACE:
+    case 127:
+    case 8:
+      if (prompt_len)
+	prompt_len--;
+      else
+	prompt_type = 0;
+      break;
+    default:
+      if (key >= ' ' && key < 256 && prompt_len < sizeof (prompt) - 1)
+	prompt[prompt_len++] = (char)key;
+      break;
+    }
+}
+
+int
+ccze_scroll_key (int key)
+{
+  size_t page = _ccze_scroll_page ();
+  size_t end = ring_count - scroll_offset;
+
+  if (prompt_type)
+    {
+      _ccze_scroll_prompt_key (key);
+      /* Lines that came in while typing were held back; catch up with
+	 them unless a search moved the view. */
+      if (!prompt_type && prompt_follow && !scroll_paused)
+	scroll_offset = 0;
+      _ccze_scroll_clamp ();
+      ccze_scroll_redraw ();
+      return 1;
+    }
+
+  switch (key)
+    {
+    case KEY_PPAGE:
+    case 'b':
+      scroll_offset = ring_count - _ccze_scroll_back (end, page);
+      break;
+    case KEY_NPAGE:
+    case ' ':
+      scroll_offset = ring_count - _ccze_scroll_forward (end, page);
+      break;
+    case KEY_UP:
+    case 'k':
+      scroll_offset = ring_count - _ccze_scroll_back (end, 1);
+      break;
+    case KEY_DOWN:
+    case 'j':
+      scroll_offset = ring_count - _ccze_scroll_forward (end, 1);
+      break;
+    case KEY_HOME:
+    case 'g':
+      scroll_offset = ring_count - _ccze_scroll_forward (0, page);
+      break;
+    case KEY_END:
+    case 'G':
+      scroll_offset = 0;
+      scroll_paused = 0;
+      break;
+    case 'p':
+      scroll_paused = !scroll_paused;
+      if (!scroll_paused)
+	scroll_offset = 0;
+      break;
+    case '/':
+    case '&':
+      prompt_follow = ccze_scroll_following ();
+      prompt_type = key;
+      prompt_len = 0;
+      break;
+    case 'n':
+      scroll_paused = 1;
+      _ccze_scroll_search_start (-1);
+      break;
+    case 'N':
+      scroll_paused = 1;
+      _ccze_scroll_search_start (1);
+      break;
+    case 'q':
+      return -1;
+    case KEY_RESIZE:
+      break;
+    default:
+      return 0;
+    }
+
+  if (key != KEY_RESIZE)
+    scroll_msg = NULL;
+  _ccze_scroll_clamp ();
+  ccze_scroll_redraw ();
+  return 1;
+}
+
+int
+ccze_scroll_busy (void)
+{
+  return (search_pending || filter_todo);
+}
+
+/* Do a bit of the pending filtering or searching. This is called from
+   the main loop between reads, so that a search through a large
+   scrollback never holds up the input. */
+void
+ccze_scroll_work (void)
+{
+  size_t n = SCROLL_WORK_CHUNK;
+  /* The screen is only redrawn if this changed what is on it. */
+  int changed = (filter_todo != 0);
+
+  while (filter_todo && n--)
+    {
+      ccze_scroll_line_t *l = RING_AT (ring_count - filter_todo);
+
+      if (l->filter_gen != filter_gen)
+	_ccze_scroll_filter_one (l);
+      filter_todo--;
+    }
+
+  /* Filtering goes first: the search skips lines filtered out. */
+  while (!filter_todo && search_pending && n--)
+    {
+      size_t i;
+      ccze_scroll_line_t *l;
+
+      if ((search_dir < 0 && search_from >= ring_count) ||
+	  (search_dir > 0 && search_from == 0))
+	{
+	  search_pending = 0;
+	  scroll_msg = "Pattern not found";
+	  changed = 1;
+	  break;
+	}
+
+      i = (search_dir < 0) ? ring_count - 1 - search_from :
+	ring_count - search_from;
+      l = RING_AT (i);
+      if (_ccze_scroll_visible (i) &&
+	  _ccze_scroll_match (search_re, search_hints, SCROLL_LINE_TEXT (l),
+			      l->len))
+	{
+	  /* Show the match on the bottom line of the page. */
+	  search_pending = 0;
+	  scroll_offset = ring_count - 1 - i;
+	  changed = 1;
+	  break;
+	}
+      search_from += (search_dir < 0) ? 1 : -1;
+    }
+
+  _ccze_scroll_clamp ();
+  if (changed)
+    ccze_scroll_redraw ();
+}
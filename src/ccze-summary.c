@@ -0,0 +1,440 @@
+/* -*- mode: c; c-file-style: "gnu" -*-
+ * ccze-summary.c -- Statistics instead of colorized output
+ * Copyright (C) 2003 Gergely Nagy <algernon@bonehunter.rulez.org>
+ *
+ * This file is part of ccze.
+ *
+ * ccze is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ccze is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include <ccze.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ccze-private.h"
+
+/* How many of the most frequent hosts, processes and so on to list. */
+#define CCZE_SUMMARY_TOP 10
+
+/* A string to count table, with open addressing. */
+typedef struct
+{
+  char *key;
+  unsigned long hash;
+  unsigned long count;
+} ccze_summary_entry_t;
+
+typedef struct
+{
+  ccze_summary_entry_t *entries;
+  size_t size, used;
+} ccze_summary_table_t;
+
+static ccze_summary_table_t sum_plugins, sum_hosts, sum_procs, sum_codes;
+static ccze_summary_table_t sum_errors;
+static unsigned long sum_classes[CCZE_COLOR_LAST];
+static unsigned long sum_lines, sum_unhandled;
+static int sum_bucket;
+
+/* The date strings of log lines repeat a lot, remember the last one
+   parsed. */
+static char last_date[64];
+static time_t last_time = (time_t)-1;
+
+void
+ccze_summary_init (int bucket)
+{
+  sum_bucket = (bucket > 0) ? bucket : 3600;
+}
+
+static unsigned long
+_ccze_summary_hash (const char *str, size_t len)
+{
+  unsigned long h = 2166136261UL;
+  size_t i;
+
+  for (i = 0; i < len; i++)
+    h = (h ^ (unsigned char)str[i]) * 16777619UL;
+  return h;
+}
+
+static void
+_ccze_summary_table_grow (ccze_summary_table_t *t)
+{
+  ccze_summary_entry_t *old = t->entries;
+  size_t i, oldsize = t->size;
+
+  t->size = (oldsize) ? oldsize * 2 : 64;
+  t->entries = (ccze_summary_entry_t *)ccze_calloc
+    (t->size, sizeof (ccze_summary_entry_t));
+  for (i = 0; i < oldsize; i++)
+    if (old[i].key)
+      {
+	size_t j = old[i].hash & (t->size - 1);
+
+	while (t->entries[j].key)
+	  j = (j + 1) & (t->size - 1);
+	t->entries[j] = old[i];
+      }
+  free (old);
+}
+
+/* Add COUNT to the counter of the LEN bytes long KEY. */
+static void
+_ccze_summary_count (ccze_summary_table_t *t, const char *key, size_t len,
+		     unsigned long count)
+{
+  unsigned long h;
+  size_t i;
+
+  /* Empty fields, as logged. */
+  if (!len || (len == 1 && *key == '-'))
+    return;
+
+  h = _ccze_summary_hash (key, len);
+  if ((t->used + 1) * 2 > t->size)
+    _ccze_summary_table_grow (t);
+
+  for (i = h & (t->size - 1); t->entries[i].key;
+       i = (i + 1) & (t->size - 1))
+    if (t->entries[i].hash == h && !strncmp (t->entries[i].key, key, len) &&
+	t->entries[i].key[len] == '\0')
+      {
+	t->entries[i].count += count;
+	return;
+      }
+
+  t->entries[i].key = (char *)ccze_malloc (len + 1);
+  memcpy (t->entries[i].key, key, len);
+  t->entries[i].key[len] = '\0';
+  t->entries[i].hash = h;
+  t->entries[i].count = count;
+  t->used++;
+}
+
+static void
+_ccze_summary_table_free (ccze_summary_table_t *t)
+{
+  size_t i;
+
+  for (i = 0; i < t->size; i++)
+    free (t->entries[i].key);
+  free (t->entries);
+  t->entries = NULL;
+  t->size = t->used = 0;
+}
+
+void
+ccze_summary_shutdown (void)
+{
+  _ccze_summary_table_free (&sum_plugins);
+  _ccze_summary_table_free (&sum_hosts);
+  _ccze_summary_table_free (&sum_procs);
+  _ccze_summary_table_free (&sum_codes);
+  _ccze_summary_table_free (&sum_errors);
+}
+
+static time_t
+_ccze_summary_date (const char *str, size_t len)
+{
+  if (len >= sizeof (last_date))
+    return (time_t)-1;
+  if (strncmp (last_date, str, len) || last_date[len] != '\0')
+    {
+      memcpy (last_date, str, len);
+      last_date[len] = '\0';
+      last_time = ccze_date_parse (last_date);
+    }
+  return last_time;
+}
+
+/* Count a finished LINE, instead of outputting it. */
+void
+ccze_summary_line (const ccze_line_t *line)
+{
+  size_t i, off = 0, date = 0, datelen = 0;
+  unsigned long errors = 0;
+  const char **plugins;
+  int d, nplugins;
+
+  sum_lines++;
+  plugins = ccze_plugin_line_handlers (&nplugins);
+  for (d = 0; d < nplugins; d++)
+    _ccze_summary_count (&sum_plugins, plugins[d], strlen (plugins[d]), 1);
+  if (!nplugins)
+    sum_unhandled++;
+
+  for (i = 0; i < line->nruns; i++)
+    {
+      const ccze_run_t *r = &line->runs[i];
+      size_t len = r->len, start = off;
+
+      while (i + 1 < line->nruns && (line->runs[i + 1].flags & CCZE_RUN_CONT))
+	len += line->runs[++i].len;
+      off += len;
+
+      if (r->flags & CCZE_RUN_NBSP)
+	continue;
+      sum_classes[r->color]++;
+
+      switch (r->color)
+	{
+	case CCZE_COLOR_HOST:
+	  _ccze_summary_count (&sum_hosts, line->text + start, len, 1);
+	  break;
+	case CCZE_COLOR_PROC:
+	  /* Without the colon syslog puts after it. */
+	  if (len > 1 && line->text[start + len - 1] == ':')
+	    len--;
+	  if (len > 1 || line->text[start] != ':')
+	    _ccze_summary_count (&sum_procs, line->text + start, len, 1);
+	  break;
+	case CCZE_COLOR_HTTPCODES:
+	  _ccze_summary_count (&sum_codes, line->text + start, len, 1);
+	  break;
+	case CCZE_COLOR_DATE:
+	  if (!datelen)
+	    {
+	      date = start;
+	      datelen = len;
+	    }
+	  break;
+	case CCZE_COLOR_ERROR:
+	case CCZE_COLOR_BADWORD:
+	  errors++;
+	  break;
+	default:
+	  break;
+	}
+    }
+
+  /* The dates are only parsed for lines with errors. */
+  if (errors)
+    {
+      time_t t = (datelen) ?
+	_ccze_summary_date (line->text + date, datelen) : (time_t)-1;
+      char key[32];
+      int klen;
+
+      if (t != (time_t)-1)
+	t -= t % sum_bucket;
+      klen = snprintf (key, sizeof (key), "%ld", (long)t);
+      _ccze_summary_count (&sum_errors, key, klen, errors);
+    }
+}
+
+/* The counters of one process can be written to a pipe, and merged
+   into another's: one line per counter, as a kind letter, the count
+   and the key. */
+static void
+_ccze_summary_table_write (FILE *f, char kind, const ccze_summary_table_t *t)
+{
+  size_t i;
+
+  for (i = 0; i < t->size; i++)
+    if (t->entries[i].key)
+      fprintf (f, "%c %lu %s\n", kind, t->entries[i].count,
+	       t->entries[i].key);
+}
+
+void
+ccze_summary_write (FILE *f)
+{
+  int i;
+
+  fprintf (f, "L %lu\nU %lu\n", sum_lines, sum_unhandled);
+  for (i = 0; i < CCZE_COLOR_LAST; i++)
+    if (sum_classes[i])
+      fprintf (f, "C %lu %d\n", sum_classes[i], i);
+  _ccze_summary_table_write (f, 'p', &sum_plugins);
+  _ccze_summary_table_write (f, 'h', &sum_hosts);
+  _ccze_summary_table_write (f, 'P', &sum_procs);
+  _ccze_summary_table_write (f, 'c', &sum_codes);
+  _ccze_summary_table_write (f, 'e', &sum_errors);
+}
+
+void
+ccze_summary_merge (FILE *f)
+{
+  char *buf = NULL, *key;
+  size_t alloc = 0;
+  ssize_t len;
+  unsigned long count;
+  int col;
+
+  while ((len = getline (&buf, &alloc, f)) > 0)
+    {
+      if (buf[len - 1] == '\n')
+	buf[--len] = '\0';
+      if (len < 4)
+	continue;
+      count = strtoul (buf + 2, &key, 10);
+      if (*key == ' ')
+	key++;
+
+      switch (buf[0])
+	{
+	case 'L':
+	  sum_lines += count;
+	  break;
+	case 'U':
+	  sum_unhandled += count;
+	  break;
+	case 'C':
+	  col = atoi (key);
+	  if (col >= 0 && col < CCZE_COLOR_LAST)
+	    sum_classes[col] += count;
+	  break;
+	case 'p':
+	  _ccze_summary_count (&sum_plugins, key, strlen (key), count);
+	  break;
+	case 'h':
+	  _ccze_summary_count (&sum_hosts, key, strlen (key), count);
+	  break;
+	case 'P':
+	  _ccze_summary_count (&sum_procs, key, strlen (key), count);
+	  break;
+	case 'c':
+	  _ccze_summary_count (&sum_codes, key, strlen (key), count);
+	  break;
+	case 'e':
+	  _ccze_summary_count (&sum_errors, key, strlen (key), count);
+	  break;
+	default:
+	  break;
+	}
+    }
+  free (buf);
+}
+
+static int
+_ccze_summary_by_count (const void *a, const void *b)
+{
+  const ccze_summary_entry_t *ea = *(ccze_summary_entry_t *const *)a;
+  const ccze_summary_entry_t *eb = *(ccze_summary_entry_t *const *)b;
+
+  if (ea->count != eb->count)
+    return (ea->count < eb->count) ? 1 : -1;
+  return strcmp (ea->key, eb->key);
+}
+
+static int
+_ccze_summary_by_time (const void *a, const void *b)
+{
+  long ta = atol ((*(ccze_summary_entry_t *const *)a)->key);
+  long tb = atol ((*(ccze_summary_entry_t *const *)b)->key);
+
+  return (ta > tb) - (ta < tb);
+}
+
+static ccze_summary_entry_t **
+_ccze_summary_sort (const ccze_summary_table_t *t,
+		    int (*cmp) (const void *, const void *))
+{
+  ccze_summary_entry_t **list;
+  size_t i, n = 0;
+
+  list = (ccze_summary_entry_t **)ccze_calloc (t->used + 1,
+					       sizeof (ccze_summary_entry_t *));
+  for (i = 0; i < t->size; i++)
+    if (t->entries[i].key)
+      list[n++] = &t->entries[i];
+  qsort (list, n, sizeof (ccze_summary_entry_t *), cmp);
+  return list;
+}
+
+static void
+_ccze_summary_report_table (const char *title, const ccze_summary_table_t *t,
+			    size_t top)
+{
+  ccze_summary_entry_t **list;
+  size_t i;
+
+  if (!t->used)
+    return;
+  printf ("\n%s:\n", title);
+  list = _ccze_summary_sort (t, _ccze_summary_by_count);
+  for (i = 0; i < t->used && (!top || i < top); i++)
+    printf ("%10lu  %s\n", list[i]->count, list[i]->key);
+  if (top && t->used > top)
+    printf ("%10s  (%lu more)\n", "", (unsigned long)(t->used - top));
+  free (list);
+}
+
+void
+ccze_summary_report (void)
+{
+  static const struct
+  {
+    ccze_color_t col;
+    const char *name;
+  } proxy[] = {
+    {CCZE_COLOR_PROXY_HIT, "HIT"},
+    {CCZE_COLOR_PROXY_MISS, "MISS"},
+    {CCZE_COLOR_PROXY_DENIED, "DENIED"}
+  };
+  unsigned long proxy_total = 0;
+  ccze_summary_entry_t **list;
+  size_t i;
+
+  printf ("Lines: %lu\n", sum_lines);
+  if (sum_unhandled)
+    printf ("Not recognised by any plugin: %lu\n", sum_unhandled);
+
+  _ccze_summary_report_table ("Lines per plugin", &sum_plugins, 0);
+  _ccze_summary_report_table ("Top hosts", &sum_hosts, CCZE_SUMMARY_TOP);
+  _ccze_summary_report_table ("Top processes", &sum_procs,
+			      CCZE_SUMMARY_TOP);
+  _ccze_summary_report_table ("HTTP status codes", &sum_codes,
+			      CCZE_SUMMARY_TOP);
+
+  for (i = 0; i < sizeof (proxy) / sizeof (proxy[0]); i++)
+    proxy_total += sum_classes[proxy[i].col];
+  if (proxy_total)
+    {
+      printf ("\nProxy results:\n");
+      for (i = 0; i < sizeof (proxy) / sizeof (proxy[0]); i++)
+	printf ("%10lu  %-6s %5.1f%%\n", sum_classes[proxy[i].col],
+		proxy[i].name,
+		100.0 * sum_classes[proxy[i].col] / proxy_total);
+    }
+
+  printf ("\nWords per color class:\n");
+  for (i = 0; i < CCZE_COLOR_STATIC_BLACK; i++)
+    if (sum_classes[i])
+      printf ("%10lu  %s\n", sum_classes[i],
+	      ccze_color_lookup_name ((ccze_color_t)i));
+
+  if (sum_errors.used)
+    {
+      printf ("\nErrors per %d seconds:\n", sum_bucket);
+      list = _ccze_summary_sort (&sum_errors, _ccze_summary_by_time);
+      for (i = 0; i < sum_errors.used; i++)
+	{
+	  time_t t = (time_t)atol (list[i]->key);
+	  char date[64];
+
+	  if (t == (time_t)-1)
+	    strcpy (date, "(undated)");
+	  else
+	    strftime (date, sizeof (date), "%Y-%m-%d %H:%M:%S",
+		      localtime (&t));
+	  printf ("%10lu  %s\n", list[i]->count, date);
+	}
+      free (list);
+    }
+}
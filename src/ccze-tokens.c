@@ -0,0 +1,172 @@
+/* -*- mode: c; c-file-style: "gnu" -*-
+ * ccze-tokens.c -- Binary token stream output
+ * Copyright (C) 2003 Gergely Nagy <algernon@bonehunter.rulez.org>
+ *
+ * This file is part of ccze.
+ *
+ * ccze is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ccze is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include <ccze.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ccze-private.h"
+
+/* The token stream is the colorized log, as text and color runs, for
+   ccze-render to turn into any of the output modes later, without
+   parsing the log again. It starts with CCZE_TOKENS_MAGIC, then comes
+   a series of blocks, each one being:
+
+     "CZB1"
+     uint32 body size
+     uint32 number of lines
+     uint64 number of the first line in the stream
+     uint32 offset of each line in the body
+     body
+
+   All the numbers are little endian. A line in the body is the number
+   of runs, the runs, then the text, with no terminator:
+
+     varint nruns
+     nruns * (byte color | CCZE_TOKENS_NBSP, varint length)
+     text, as long as the runs together
+
+   Blocks can be skipped by their size, and the lines within one found
+   by their offset, so a reader can start anywhere without decoding
+   what comes before. */
+
+static unsigned char *body;
+static size_t body_len, body_alloc;
+static uint32_t *offsets;
+static size_t nlines, offsets_alloc;
+static uint64_t first_line;
+static int header_done;
+
+static void
+_ccze_tokens_reserve (size_t len)
+{
+  if (body_len + len > body_alloc)
+    {
+      while (body_len + len > body_alloc)
+	body_alloc = (body_alloc) ? body_alloc * 2 : 65536;
+      body = (unsigned char *)ccze_realloc (body, body_alloc);
+    }
+}
+
+static void
+_ccze_tokens_varint (size_t v)
+{
+  while (v >= 0x80)
+    {
+      body[body_len++] = (unsigned char)(v | 0x80);
+      v >>= 7;
+    }
+  body[body_len++] = (unsigned char)v;
+}
+
+static void
+_ccze_tokens_le (unsigned char *buf, uint64_t v, int bytes)
+{
+  int i;
+
+  for (i = 0; i < bytes; i++)
+    buf[i] = (unsigned char)(v >> (8 * i));
+}
+
+/* Write out the lines collected so far as a block. */
+void
+ccze_tokens_flush (void)
+{
+  unsigned char hdr[20], off[4];
+  size_t i;
+
+  if (!header_done)
+    {
+      fwrite (CCZE_TOKENS_MAGIC, 1, 8, ccze_out);
+      header_done = 1;
+    }
+  if (!nlines)
+    return;
+
+  memcpy (hdr, "CZB1", 4);
+  _ccze_tokens_le (hdr + 4, body_len, 4);
+  _ccze_tokens_le (hdr + 8, nlines, 4);
+  _ccze_tokens_le (hdr + 12, first_line, 8);
+  fwrite (hdr, 1, sizeof (hdr), ccze_out);
+  for (i = 0; i < nlines; i++)
+    {
+      _ccze_tokens_le (off, offsets[i], 4);
+      fwrite (off, 1, sizeof (off), ccze_out);
+    }
+  fwrite (body, 1, body_len, ccze_out);
+  fflush (ccze_out);
+
+  first_line += nlines;
+  nlines = 0;
+  body_len = 0;
+}
+
+void
+ccze_tokens_line (const char *text, size_t len, const ccze_run_t *runs,
+		  size_t nruns)
+{
+  size_t i, n = 0;
+
+  if (nlines >= offsets_alloc)
+    {
+      offsets_alloc = (offsets_alloc) ? offsets_alloc * 2 : 1024;
+      offsets = (uint32_t *)ccze_realloc (offsets,
+					  offsets_alloc * sizeof (uint32_t));
+    }
+  offsets[nlines++] = (uint32_t)body_len;
+
+  /* Runs split for their length are joined again. */
+  for (i = 0; i < nruns; i++)
+    if (!(runs[i].flags & CCZE_RUN_CONT))
+      n++;
+
+  _ccze_tokens_reserve (10 + n * 11 + len);
+  _ccze_tokens_varint (n);
+  for (i = 0; i < nruns; i++)
+    {
+      size_t rlen = runs[i].len, first = i;
+
+      while (i + 1 < nruns && (runs[i + 1].flags & CCZE_RUN_CONT))
+	rlen += runs[++i].len;
+      body[body_len++] = runs[first].color |
+	((runs[first].flags & CCZE_RUN_NBSP) ? CCZE_TOKENS_NBSP : 0);
+      _ccze_tokens_varint (rlen);
+    }
+  memcpy (body + body_len, text, len);
+  body_len += len;
+
+  if (nlines >= CCZE_TOKENS_BLOCK_LINES ||
+      body_len >= CCZE_TOKENS_BLOCK_SIZE)
+    ccze_tokens_flush ();
+}
+
+void
+ccze_tokens_shutdown (void)
+{
+  ccze_tokens_flush ();
+  free (body);
+  free (offsets);
+  body = NULL;
+  offsets = NULL;
+  body_alloc = offsets_alloc = 0;
+}
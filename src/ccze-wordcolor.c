@@ -217,7 +217,7 @@ ccze_wordcolor_process (const char *msg, int wcol, int slookup)
   char *word;
   char *msg2;
 
-  if (msg)
+  if (msg && !ccze_filter_rejected ())
     msg2 = strdup (msg);
   else
     return;
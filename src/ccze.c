@@ -26,10 +26,17 @@
 #endif
 #include <ccze.h>
 #include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
 #include <time.h>
 #include <unistd.h>
 
@@ -47,39 +54,66 @@
 
 #define ESC 0x1b
 
-/* ccze somehow swaped cyan and magenta */
-static int ccze_raw_ansi_color[] = {30, 31, 32, 33, 34, 36, 35, 37};
-
-ccze_config_t ccze_config = {
-  .scroll = 1,
-  .convdate = 0,
-  .remfac = 0,
-  .wcol = 1,
-  .slookup = 1,
-  .rcfile = NULL,
-  .cssfile = NULL,
-  .transparent = 1,
-  .pluginlist_len = 0,
-  .pluginlist_alloc = 10,
-  .color_argv_len = 0,
-  .color_argv_alloc = 10,
-  .mode = CCZE_MODE_CURSES
-};
-
 static short colors[] = {COLOR_BLACK, COLOR_RED, COLOR_GREEN, COLOR_YELLOW,
 			 COLOR_BLUE, COLOR_CYAN, COLOR_MAGENTA, COLOR_WHITE};
 static volatile sig_atomic_t sighup_received = 0;
+static FILE *ccze_tty = NULL;
+
+typedef struct
+{
+  int fd;
+  char *buf;
+  size_t alloc, len, pos;
+  off_t offset, left;
+  int eof;
+  /* With --buffer, the lines come from the ring, and this many were
+     dropped before the ones in the buffer. */
+  int ring;
+  unsigned long dropped;
+} ccze_input_t;
+static ccze_input_t input;
+
+/* With --jobs, the worker processes' pipes in the one that started
+   them, and the pipe back to it in a worker. */
+static int *workers = NULL;
+static int nworkers = 0;
+static int worker_fd = -1;
+
+/* The socket of cczed, with --remote. */
+static char *remote = NULL;
 
 #ifndef HAVE_ARGP_PARSE
 const char *argp_program_name = "ccze";
 #endif
 const char *argp_program_version = "ccze 0.2." PATCHLEVEL;
 const char *argp_program_bug_address = "<algernon@bonehunter.rulez.org>";
+/* Options without a short form. */
+enum
+{
+  CCZE_OPT_ONLY = 256,
+  CCZE_OPT_HOST,
+  CCZE_OPT_PROCESS,
+  CCZE_OPT_HANDLED_BY,
+  CCZE_OPT_HIGHLIGHT,
+  CCZE_OPT_HIGHLIGHT_REGEX,
+  CCZE_OPT_COLLAPSE,
+  CCZE_OPT_COLLAPSE_TIME,
+  CCZE_OPT_INDEX,
+  CCZE_OPT_FROM,
+  CCZE_OPT_TO,
+  CCZE_OPT_SUMMARY,
+  CCZE_OPT_JOBS,
+  CCZE_OPT_REMOTE,
+  CCZE_OPT_BUFFER,
+  CCZE_OPT_OVERFLOW
+};
+
 static struct argp_option options[] = {
   {"rcfile", 'F', "FILE", 0, "Read configuration from FILE", 1},
   {"html", 'h', NULL, 0, "Generate HTML output", 1},
   {"options", 'o', "OPTIONS...", 0, "Toggle some options\n"
-   "(such as scroll, wordcolor and lookups, transparent, or cssfile)", 1},
+   "(such as scroll, wordcolor and lookups, transparent, cssfile, "
+   "scrollback, hashcolor, mailq, or localtime)", 1},
   {"convert-date", 'C', NULL, 0, "Convert UNIX timestamps to readable format", 1},
   {"plugin", 'p', "PLUGIN", 0, "Load PLUGIN", 1},
   {"remove-facility", 'r', NULL, 0,
@@ -90,12 +124,48 @@ static struct argp_option options[] = {
   {"raw-ansi", 'A', NULL, 0, "Generate raw ANSI output", 1},
   {"list-plugins", 'l', NULL, 0, "List available plugins", 1},
   {"mode", 'm', "MODE", 0, "Change the output mode\n"
-   "(Available modes are curses, ansi and html.)", 1},
+   "(Available modes are curses, ansi, html, json and tokens.)", 1},
+  {"only", CCZE_OPT_ONLY, "CLASS,...", 0,
+   "Only show lines containing any of the color CLASSes", 2},
+  {"host", CCZE_OPT_HOST, "PATTERN,...", 0,
+   "Only show lines from hosts matching PATTERN", 2},
+  {"process", CCZE_OPT_PROCESS, "PATTERN,...", 0,
+   "Only show lines from processes matching PATTERN", 2},
+  {"handled-by", CCZE_OPT_HANDLED_BY, "PLUGIN,...", 0,
+   "Only show lines handled by PLUGIN", 2},
+  {"highlight", CCZE_OPT_HIGHLIGHT, "COLOR=TEXT", 0,
+   "Highlight TEXT with COLOR", 1},
+  {"highlight-regex", CCZE_OPT_HIGHLIGHT_REGEX, "COLOR=REGEX", 0,
+   "Highlight matches of REGEX with COLOR", 1},
+  {"collapse", CCZE_OPT_COLLAPSE, "LINES", OPTION_ARG_OPTIONAL,
+   "Collapse repeats of any of the last LINES (16) different lines", 1},
+  {"collapse-time", CCZE_OPT_COLLAPSE_TIME, "SECONDS", 0,
+   "Output the count of collapsed lines every SECONDS (10)", 1},
+  {"index", CCZE_OPT_INDEX, "LINES", OPTION_ARG_OPTIONAL,
+   "Build or update the time index of FILE, with an entry every LINES "
+   "(4096) lines", 3},
+  {"from", CCZE_OPT_FROM, "TIME", 0,
+   "Only show lines dated TIME or later", 3},
+  {"to", CCZE_OPT_TO, "TIME", 0,
+   "Only show lines dated TIME or earlier", 3},
+  {"summary", CCZE_OPT_SUMMARY, "SECONDS", OPTION_ARG_OPTIONAL,
+   "Print statistics instead of the log, counting errors per SECONDS "
+   "(3600)", 3},
+  {"jobs", CCZE_OPT_JOBS, "N", 0,
+   "Gather the statistics of FILE with N processes", 3},
+  {"remote", CCZE_OPT_REMOTE, "SOCKET", OPTION_ARG_OPTIONAL,
+   "Have the cczed listening on SOCKET colorize the logs", 1},
+  {"buffer", CCZE_OPT_BUFFER, "SIZE", OPTION_ARG_OPTIONAL,
+   "Read piped input ahead, into a buffer of SIZE (4M)", 1},
+  {"overflow", CCZE_OPT_OVERFLOW, "POLICY", 0,
+   "When the buffer is full, block, drop the oldest lines, or drop them "
+   "and tell how many (block, drop or summary)", 1},
   {NULL, 0, NULL, 0,  NULL, 0}
 };
 static error_t parse_opt (int key, char *arg, struct argp_state *state);
 static struct argp argp =
-  {options, parse_opt, 0, "ccze -- cheer up 'yer logs.", NULL, NULL, NULL};
+  {options, parse_opt, "[FILE]", "ccze -- cheer up 'yer logs.", NULL, NULL,
+   NULL};
 
 enum
 {
@@ -109,6 +179,14 @@ enum
   CCZE_O_SUBOPT_NOCSSFILE,
   CCZE_O_SUBOPT_TRANSPARENT,
   CCZE_O_SUBOPT_NOTRANSPARENT,
+  CCZE_O_SUBOPT_SCROLLBACK,
+  CCZE_O_SUBOPT_NOSCROLLBACK,
+  CCZE_O_SUBOPT_HASHCOLOR,
+  CCZE_O_SUBOPT_NOHASHCOLOR,
+  CCZE_O_SUBOPT_MAILQ,
+  CCZE_O_SUBOPT_NOMAILQ,
+  CCZE_O_SUBOPT_LOCALTIME,
+  CCZE_O_SUBOPT_NOLOCALTIME,
   CCZE_O_SUBOPT_END
 };
 
@@ -123,6 +201,14 @@ static char *o_subopts[] = {
   [CCZE_O_SUBOPT_NOCSSFILE] = "nocssfile",
   [CCZE_O_SUBOPT_TRANSPARENT] = "transparent",
   [CCZE_O_SUBOPT_NOTRANSPARENT] = "notransparent",
+  [CCZE_O_SUBOPT_SCROLLBACK] = "scrollback",
+  [CCZE_O_SUBOPT_NOSCROLLBACK] = "noscrollback",
+  [CCZE_O_SUBOPT_HASHCOLOR] = "hashcolor",
+  [CCZE_O_SUBOPT_NOHASHCOLOR] = "nohashcolor",
+  [CCZE_O_SUBOPT_MAILQ] = "mailq",
+  [CCZE_O_SUBOPT_NOMAILQ] = "nomailq",
+  [CCZE_O_SUBOPT_LOCALTIME] = "localtime",
+  [CCZE_O_SUBOPT_NOLOCALTIME] = "nolocaltime",
   [CCZE_O_SUBOPT_END] = NULL
 };
 
@@ -132,6 +218,8 @@ enum
   CCZE_M_SUBOPT_ANSI,
   CCZE_M_SUBOPT_HTML,
   CCZE_M_SUBOPT_DEBUG,
+  CCZE_M_SUBOPT_JSON,
+  CCZE_M_SUBOPT_TOKENS,
   CCZE_M_SUBOPT_END
 };
 
@@ -140,48 +228,58 @@ static char *m_subopts[] = {
   [CCZE_M_SUBOPT_ANSI] = "ansi",
   [CCZE_M_SUBOPT_HTML] = "html",
   [CCZE_M_SUBOPT_DEBUG] = "debug",
+  [CCZE_M_SUBOPT_JSON] = "json",
+  [CCZE_M_SUBOPT_TOKENS] = "tokens",
   [CCZE_M_SUBOPT_END] = NULL
 };
 
 static char *empty_subopts[] = { NULL };
 
-static char *_strbrk_string;
-static size_t _strbrk_string_len;
-
-char *
-ccze_strbrk (char *str, char delim)
+/* Parse a size in bytes, with an optional k, M or G suffix. Returns
+   (size_t)-1 if STR is not one. */
+size_t
+ccze_parse_size (const char *str)
 {
-  char *found;
-      
-  if (str)
-    {
-      _strbrk_string = str;
-      _strbrk_string_len = strlen (str);
-      found = str;
-    }
-  else
-    found = _strbrk_string + 1;
-  
-  if (!_strbrk_string_len)
-    return NULL;
-  while (_strbrk_string_len >= 1 &&
-	 *_strbrk_string != delim)
+  char *end;
+  size_t size;
+
+  if (*str < '0' || *str > '9')
+    return (size_t)-1;
+  size = strtoul (str, &end, 10);
+
+  switch (*end)
     {
-      _strbrk_string++;
-      _strbrk_string_len--;
+    case 'g':
+    case 'G':
+      size *= 1024;
+      /* fall through */
+    case 'm':
+    case 'M':
+      size *= 1024;
+      /* fall through */
+    case 'k':
+    case 'K':
+      size *= 1024;
+      end++;
+      break;
+    default:
+      break;
     }
-  if (_strbrk_string_len > 0)
-    *_strbrk_string = '\0';
-  return found;
+  return (*end == '\0') ? size : (size_t)-1;
 }
 
-char *
-xstrdup (const char *str)
+/* Parse a count of at least one, below INT_MAX. Returns 0 if STR is
+   not one. */
+static int
+_ccze_parse_count (const char *str)
 {
-  if (!str)
-    return NULL;
-  else
-    return strdup (str);
+  char *end;
+  unsigned long n;
+
+  if (*str < '0' || *str > '9')
+    return 0;
+  n = strtoul (str, &end, 10);
+  return (*end == '\0' && n < INT_MAX) ? (int)n : 0;
 }
 
 static error_t
@@ -209,7 +307,7 @@ parse_opt (int key, char *arg, struct argp_state *state)
 	}
       break;
     case 'a':
-      plugin = strtok (optarg, "=");
+      plugin = strtok (arg, "=");
       value = strtok (NULL, "\n");
       ccze_plugin_argv_set (plugin, value);
       break;
@@ -249,7 +347,7 @@ parse_opt (int key, char *arg, struct argp_state *state)
       ccze_config.remfac = 1;
       break;
     case 'm':
-      subopts = optarg;
+      subopts = arg;
       while (*subopts != '\0')
 	{
 	  switch (getsubopt (&subopts, m_subopts, &value))
@@ -266,6 +364,12 @@ parse_opt (int key, char *arg, struct argp_state *state)
 	    case CCZE_M_SUBOPT_DEBUG:
 	      ccze_config.mode = CCZE_MODE_DEBUG;
 	      break;
+	    case CCZE_M_SUBOPT_JSON:
+	      ccze_config.mode = CCZE_MODE_JSON;
+	      break;
+	    case CCZE_M_SUBOPT_TOKENS:
+	      ccze_config.mode = CCZE_MODE_TOKENS;
+	      break;
 	    default:
 	      argp_error (state, "unrecognised mode: `%s'", value);
 	      break;
@@ -273,7 +377,7 @@ parse_opt (int key, char *arg, struct argp_state *state)
 	}
       break;
     case 'o':
-      subopts = optarg;
+      subopts = arg;
       while (*subopts != '\0')
 	{
 	  switch (getsubopt (&subopts, o_subopts, &value))
@@ -309,6 +413,33 @@ parse_opt (int key, char *arg, struct argp_state *state)
 	    case CCZE_O_SUBOPT_NOTRANSPARENT:
 	      ccze_config.transparent = 0;
 	      break;
+	    case CCZE_O_SUBOPT_SCROLLBACK:
+	      if (value &&
+		  (ccze_config.scrollback = ccze_parse_size (value)) ==
+		  (size_t)-1)
+		argp_error (state, "invalid scrollback size: `%s'", value);
+	      break;
+	    case CCZE_O_SUBOPT_NOSCROLLBACK:
+	      ccze_config.scrollback = 0;
+	      break;
+	    case CCZE_O_SUBOPT_HASHCOLOR:
+	      ccze_config.hashcolor = 1;
+	      break;
+	    case CCZE_O_SUBOPT_NOHASHCOLOR:
+	      ccze_config.hashcolor = 0;
+	      break;
+	    case CCZE_O_SUBOPT_MAILQ:
+	      ccze_config.mailq = (value && !strcmp (value, "summary")) ? 2 : 1;
+	      break;
+	    case CCZE_O_SUBOPT_NOMAILQ:
+	      ccze_config.mailq = 0;
+	      break;
+	    case CCZE_O_SUBOPT_LOCALTIME:
+	      ccze_config.localdate = 1;
+	      break;
+	    case CCZE_O_SUBOPT_NOLOCALTIME:
+	      ccze_config.localdate = 0;
+	      break;
 	    default:
 	      argp_error (state, "unrecognised option: `%s'", value);
 	      break;
@@ -318,204 +449,104 @@ parse_opt (int key, char *arg, struct argp_state *state)
     case 'C':
       ccze_config.convdate = 1;
       break;
-    default:
-      return ARGP_ERR_UNKNOWN;
-    }
-  return 0;
-}
-
-ccze_color_t
-ccze_http_action (const char *method)
-{
-  if (!strcasecmp ("GET", method))
-    return CCZE_COLOR_HTTP_GET;
-  else if (!strcasecmp ("POST", method))
-    return CCZE_COLOR_HTTP_POST;
-  else if (!strcasecmp ("HEAD", method))
-    return CCZE_COLOR_HTTP_HEAD;
-  else if (!strcasecmp ("PUT", method))
-    return CCZE_COLOR_HTTP_PUT;
-  else if (!strcasecmp ("CONNECT", method))
-    return CCZE_COLOR_HTTP_CONNECT;
-  else if (!strcasecmp ("TRACE", method))
-    return CCZE_COLOR_HTTP_TRACE;
-  else
-    return CCZE_COLOR_UNKNOWN;
-}
-
-void
-ccze_print_date (const char *date)
-{
-  time_t ltime;
-  char tmp[128];
-  
-  if (ccze_config.convdate)
-    {
-      ltime = atol (date);
-      if (ltime < 0)
+    case CCZE_OPT_HIGHLIGHT:
+    case CCZE_OPT_HIGHLIGHT_REGEX:
+      /* These are applied together with the -c options, as if they
+	 were in the rc file. */
+      asprintf (&value, "%s %s", (key == CCZE_OPT_HIGHLIGHT) ?
+		"highlight" : "highlight_regex", arg);
+      ccze_config.color_argv[ccze_config.color_argv_len++] = value;
+      if (ccze_config.color_argv_len >= ccze_config.color_argv_alloc)
 	{
-	  ccze_addstr (CCZE_COLOR_DATE, date);
-	  return;
+	  ccze_config.color_argv_alloc *= 2;
+	  ccze_config.color_argv =
+	    (char **)ccze_realloc (ccze_config.color_argv,
+				   ccze_config.color_argv_alloc *
+				   sizeof (char *));
 	}
-      strftime (tmp, sizeof (tmp) - 1, "%b %e %T", gmtime (&ltime));
-      ccze_addstr (CCZE_COLOR_DATE, tmp);
-    }
-  else
-    ccze_addstr (CCZE_COLOR_DATE, date);
-}
-
-void
-ccze_newline (void)
-{
-  switch (ccze_config.mode)
-    {
-    case CCZE_MODE_HTML:
-      printf ("<br>\n");
       break;
-    case CCZE_MODE_DEBUG:
-    case CCZE_MODE_RAW_ANSI:
-      printf ("\n");
+    case CCZE_OPT_COLLAPSE:
+      ccze_config.collapse = (arg) ? _ccze_parse_count (arg) : 16;
+      if (!ccze_config.collapse)
+	argp_error (state, "invalid collapse window: `%s'", arg);
       break;
-    case CCZE_MODE_CURSES:
-      addstr ("\n");
+    case CCZE_OPT_COLLAPSE_TIME:
+      if (!(ccze_config.collapse_time = _ccze_parse_count (arg)))
+	argp_error (state, "invalid collapse time: `%s'", arg);
       break;
-    default:
+    case CCZE_OPT_INDEX:
+      ccze_config.mode = CCZE_MODE_INDEX;
+      ccze_config.index_interval = (arg) ? strtoul (arg, NULL, 10) : 4096;
+      if (!ccze_config.index_interval)
+	argp_error (state, "invalid index interval: `%s'", arg);
       break;
-    }
-}
-
-static char *
-ccze_str_htmlencode (const char *src)
-{
-    char *buf, *dest;
-    unsigned char c;
-
-    dest = (char *)ccze_malloc (strlen (src) * 5 + 1);
-
-    if (!dest)
-      return NULL;
-
-    buf = dest;
-    while ((c = *src++))
-      {
-        switch (c)
-	  {
-	  case '>':
-            *dest++ = '&';
-            *dest++ = 'g';
-            *dest++ = 't';
-            *dest++ = ';';
-            break;
-	  case '<':
-            *dest++ = '&';
-            *dest++ = 'l';
-            *dest++ = 't';
-            *dest++ = ';';
-            break;
-	  case '&':
-            *dest++ = '&';
-            *dest++ = 'a';
-            *dest++ = 'm';
-            *dest++ = 'p';
-            *dest++ = ';';
-            break;
-	  default:
-            *dest++ = c;
-	  }
-      }
-    *dest = '\0';
-    return buf;
-}
-
-static void
-ccze_addstr_internal (ccze_color_t col, const char *str, int enc)
-{
-  switch (ccze_config.mode)
-    {
-    case CCZE_MODE_HTML:
-      if (str)
-	{
-	  char *d;
-
-	  if (enc)
-	    d = ccze_str_htmlencode (str);
-	  else
-	    d = strdup (str);
-	  printf ("<font class=\"ccze_%s\">%s</font>",
-		  ccze_color_lookup_name (col), d);
-	  free (d);
-	}
+    case CCZE_OPT_FROM:
+      if ((ccze_config.from = ccze_date_parse (arg)) == (time_t)-1)
+	argp_error (state, "invalid date: `%s'", arg);
       break;
-    case CCZE_MODE_RAW_ANSI:
-      if (str)
-	{
-	  int c = ccze_color (col);
-
-	  printf("%c[22m", ESC); /* default */
-
-	  if (c & 0x1000) /* Bold */
-	    {
-	      printf("%c[1m", ESC);
-	      c ^= 0x1000;
-	    }
-	  
-	  if (c & 0x2000) /* Underline */
-	    {
-	      printf("%c[4m", ESC);
-	      c ^= 0x2000;
-	    }
-	  
-	  if (c & 0x4000) /* Reverse */
-	    {
-	      printf("%c[5m", ESC);
-	      c ^= 0x4000;
-	    }
-	  
-	  if (c & 0x8000) /* Blink */
-	    {
-	      printf("%c[7m", ESC);
-	      c ^= 0x8000;
-	    }
-
-	  if (c >> 8 > 0 || !ccze_config.transparent)
-	    printf("%c[%dm", ESC, ccze_raw_ansi_color[c >> 8] + 10);
-	  printf ("%c[%dm%s%c[0m", ESC, ccze_raw_ansi_color[c & 0xf], str, ESC);
-	}
+    case CCZE_OPT_TO:
+      if ((ccze_config.to = ccze_date_parse (arg)) == (time_t)-1)
+	argp_error (state, "invalid date: `%s'", arg);
       break;
-    case CCZE_MODE_DEBUG:
-      if (str)
-	{
-	  char *cn = ccze_color_lookup_name (col);
-	  printf ("<%s>%s</%s>", cn, str, cn);
-	}
+    case ARGP_KEY_ARG:
+      if (ccze_config.infile)
+	argp_error (state, "only one FILE can be given");
+      ccze_config.infile = strdup (arg);
       break;
-    case CCZE_MODE_CURSES:
-      attrset (ccze_color (col));
-      addstr (str);
+    case CCZE_OPT_SUMMARY:
+      ccze_config.mode = CCZE_MODE_SUMMARY;
+      if (arg && (ccze_config.summary_bucket = atoi (arg)) <= 0)
+	argp_error (state, "invalid time bucket: `%s'", arg);
       break;
-    default:
+    case CCZE_OPT_JOBS:
+      if ((ccze_config.jobs = atoi (arg)) <= 0)
+	argp_error (state, "invalid number of jobs: `%s'", arg);
       break;
-    }
-}
-
-void
-ccze_addstr (ccze_color_t col, const char *str)
-{
-  ccze_addstr_internal (col, str, 1);
-}
-
-void
-ccze_space (void)
-{
-  switch (ccze_config.mode)
-    {
-    case CCZE_MODE_HTML:
-      ccze_addstr_internal (CCZE_COLOR_DEFAULT, "&nbsp;", 0);
+    case CCZE_OPT_REMOTE:
+      remote = strdup ((arg) ? arg : CCZE_REMOTE_SOCKET);
       break;
-    default:
-      ccze_addstr (CCZE_COLOR_DEFAULT, " ");
+    case CCZE_OPT_BUFFER:
+      ccze_config.buffer = (arg) ? ccze_parse_size (arg) : 4 * 1024 * 1024;
+      if (!ccze_config.buffer || ccze_config.buffer == (size_t)-1)
+	argp_error (state, "invalid buffer size: `%s'", arg);
       break;
+    case CCZE_OPT_OVERFLOW:
+      if (!strcmp (arg, "block"))
+	ccze_config.overflow = CCZE_RING_BLOCK;
+      else if (!strcmp (arg, "drop"))
+	ccze_config.overflow = CCZE_RING_DROP;
+      else if (!strcmp (arg, "summary"))
+	ccze_config.overflow = CCZE_RING_SUMMARY;
+      else
+	argp_error (state, "invalid overflow policy: `%s'", arg);
+      break;
+    case ARGP_KEY_END:
+      /* cczed does not do curses. */
+      if (remote && ccze_config.mode == CCZE_MODE_CURSES)
+	ccze_config.mode = CCZE_MODE_RAW_ANSI;
+      if (ccze_config.mode == CCZE_MODE_INDEX && !ccze_config.infile)
+	argp_error (state, "--index needs a FILE");
+      /* Collapsed lines would be missing from the counts. */
+      if (ccze_config.mode == CCZE_MODE_SUMMARY)
+	ccze_config.collapse = 0;
+      break;
+    case CCZE_OPT_ONLY:
+      if (ccze_filter_add (CCZE_FILTER_CLASS, arg))
+	argp_error (state, "unknown color class in `%s'", arg);
+      break;
+    case CCZE_OPT_HOST:
+      ccze_filter_add (CCZE_FILTER_HOST, arg);
+      break;
+    case CCZE_OPT_PROCESS:
+      ccze_filter_add (CCZE_FILTER_PROCESS, arg);
+      break;
+    case CCZE_OPT_HANDLED_BY:
+      ccze_filter_add (CCZE_FILTER_PLUGIN, arg);
+      break;
+    default:
+      return ARGP_ERR_UNKNOWN;
     }
+  return 0;
 }
 
 static void sigint_handler (int sig) __attribute__ ((noreturn));
@@ -533,13 +564,25 @@ sigint_handler (int sig)
     case CCZE_MODE_RAW_ANSI:
       printf("%c[0m", ESC);
       break;
+    case CCZE_MODE_SUMMARY:
+      ccze_summary_report ();
+      ccze_summary_shutdown ();
+      break;
+    case CCZE_MODE_TOKENS:
+      ccze_tokens_shutdown ();
+      break;
     default:
       break;
     }
 
+  ccze_ring_stop ();
+  if (ccze_ring_dropped ())
+    fprintf (stderr, "ccze: %lu lines dropped\n", ccze_ring_dropped ());
+
   if (sig)
     {
       ccze_wordcolor_shutdown ();
+      ccze_highlight_shutdown ();
       ccze_plugin_shutdown ();
     }
   
@@ -558,49 +601,356 @@ static void
 sighup_handler (int sig)
 {
   sighup_received = 1;
-  signal (SIGHUP, sighup_handler);
 }
 
 static void
-ccze_main (void)
+_ccze_input_init (int fd)
 {
-  char *subject = NULL;
-  size_t subjlen = 0;
-  int i, j;
-  char *homerc, *home;
-  ccze_plugin_t **plugins;
+  input.fd = fd;
+  input.alloc = 65536;
+  input.len = input.pos = 0;
+  input.offset = input.left = -1;
+  input.eof = 0;
+  input.ring = 0;
+  input.dropped = 0;
+  input.buf = (char *)ccze_malloc (input.alloc);
+}
 
-  sighup_received = 0;
-  ccze_color_init ();
-  ccze_plugin_init ();
+/* Read whatever is available from the input into the buffer. Returns
+   the number of bytes read, 0 on end of file. */
+static ssize_t
+_ccze_input_fill (void)
+{
+  size_t want;
+  ssize_t n;
+  int cut = 0;
 
-  if (ccze_config.rcfile)
-    ccze_color_load (ccze_config.rcfile);
-  else
+  if (input.pos > 0)
+    {
+      memmove (input.buf, input.buf + input.pos, input.len - input.pos);
+      input.len -= input.pos;
+      input.pos = 0;
+    }
+  /* The ring hands over whole lines, up to CCZE_RING_RECORD_MAX. */
+  if (input.len + 1 >= input.alloc ||
+      (input.ring && input.alloc - input.len - 1 < CCZE_RING_RECORD_MAX))
     {
-      ccze_color_load (SYSCONFDIR "/colorizerc");
-      ccze_color_load (SYSCONFDIR "/cczerc");
-      home = getenv ("HOME");
-      if (home)
+      input.alloc *= 2;
+      input.buf = (char *)ccze_realloc (input.buf, input.alloc);
+    }
+
+  want = input.alloc - input.len - 1;
+  if (input.left >= 0 && (off_t)want > input.left)
+    want = (size_t)input.left;
+
+  do
+    if (!want)
+      n = 0;
+    else if (input.ring)
+      n = ccze_ring_read (input.buf + input.len, want, &input.dropped, &cut);
+    else if (input.offset >= 0)
+      n = pread (input.fd, input.buf + input.len, want, input.offset);
+    else
+      n = read (input.fd, input.buf + input.len, want);
+  while (n < 0 && errno == EINTR && !sighup_received);
+
+  if (n > 0)
+    {
+      input.len += n;
+      if (input.offset >= 0)
+	input.offset += n;
+      if (input.left >= 0)
+	input.left -= n;
+    }
+  /* The rest of the line the buffer ends with was dropped, so the
+     start of it goes too. */
+  if (cut)
+    while (input.len > input.pos && input.buf[input.len - 1] != '\n')
+      input.len--;
+  if ((n == 0 && !input.dropped && !cut) ||
+      (n < 0 && errno != EINTR && errno != EAGAIN))
+    input.eof = 1;
+  return n;
+}
+
+/* With --overflow=summary, tell where lines were dropped, once the
+   lines before are out. */
+static void
+_ccze_input_dropped (void)
+{
+  char msg[64];
+  int len;
+
+  if (ccze_config.overflow == CCZE_RING_SUMMARY)
+    {
+      len = snprintf (msg, sizeof (msg), "[dropped %lu lines]",
+		      input.dropped);
+      ccze_plugin_line_start ();
+      ccze_line_add (CCZE_COLOR_REPEAT, msg, len, 0);
+      ccze_line_flush ();
+    }
+  input.dropped = 0;
+}
+
+/* Return the next complete line from the buffer, or NULL if there is
+   none yet. At end of file, an unterminated last line is returned as
+   well. */
+static char *
+_ccze_input_line (void)
+{
+  char *start = input.buf + input.pos, *nl;
+
+  if (input.pos >= input.len)
+    return NULL;
+
+  nl = (char *)memchr (start, '\n', input.len - input.pos);
+  if (!nl)
+    {
+      if (!input.eof)
+	return NULL;
+      input.buf[input.len] = '\0';
+      input.pos = input.len;
+      return start;
+    }
+  nl[0] = '\0';
+  input.pos = nl - input.buf + 1;
+  return start;
+}
+
+/* Wait at most TIMEOUT milliseconds (forever, if negative) for input.
+   Returns non-zero if there is some. */
+static int
+_ccze_input_ready (int timeout)
+{
+  struct pollfd fd;
+
+  if ((timeout < 0 && !input.ring) || ccze_ring_pending ())
+    return 1;
+  fd.fd = input.fd;
+  fd.events = POLLIN;
+  return (poll (&fd, 1, timeout) != 0);
+}
+
+/* Wait until either the input or the keyboard has something for us,
+   and handle the keys. Returns -1 if the user wants to quit, 1 if
+   there is input to read, 0 otherwise. */
+static int
+_ccze_wait_input (void)
+{
+  struct pollfd fds[2];
+  int nfds = 0, key;
+
+  if (!input.eof)
+    {
+      fds[nfds].fd = input.fd;
+      fds[nfds].events = POLLIN;
+      nfds++;
+    }
+  fds[nfds].fd = fileno (ccze_tty);
+  fds[nfds].events = POLLIN;
+  fds[nfds].revents = 0;
+  nfds++;
+
+  /* While a search or filter is in progress, do not block: it is
+     worked on a chunk at a time between reads. Nor past the time
+     the count of collapsed lines is due. */
+  if (poll (fds, nfds, (ccze_scroll_busy () || ccze_ring_pending ()) ? 0 :
+	    ccze_collapse_timeout ()) < 0)
+    {
+      if (errno == EINTR && !ccze_scroll_following ())
+	ccze_scroll_redraw ();
+      return 0;
+    }
+
+  while ((key = getch ()) != ERR)
+    if (ccze_scroll_key (key) < 0)
+      return -1;
+
+  if (ccze_scroll_busy ())
+    ccze_scroll_work ();
+  ccze_collapse_expire (0);
+
+  return (!input.eof && ((fds[0].revents & (POLLIN | POLLHUP | POLLERR)) ||
+			  ccze_ring_pending ()));
+}
+
+/* The offset of the first line starting at or after OFF in the file
+   open on FD. */
+static off_t
+_ccze_line_start (int fd, off_t off, off_t size)
+{
+  char buf[4096], *nl;
+  ssize_t n;
+
+  if (off == 0)
+    return 0;
+  off--;
+  while (off < size && (n = pread (fd, buf, sizeof (buf), off)) > 0)
+    {
+      if ((nl = (char *)memchr (buf, '\n', n)) != NULL)
+	return off + (nl - buf) + 1;
+      off += n;
+    }
+  return size;
+}
+
+/* Split the rest of the input between JOBS processes. This one keeps
+   the first part; each of the others reads one of the rest, and sends
+   its counters back through a pipe, to be merged by
+   _ccze_summary_collect(). They all share the file offset, so they
+   read with pread(). The last parts are handed out first, so that a
+   part no process could be started for is simply read by the one
+   before it. */
+static void
+_ccze_summary_fork (int jobs)
+{
+  struct stat st;
+  off_t start, end, *bounds;
+  int k, p[2];
+
+  if (fstat (input.fd, &st) || !S_ISREG (st.st_mode))
+    return;
+  start = lseek (input.fd, 0, SEEK_CUR) - (input.len - input.pos);
+  if (start < 0 || st.st_size <= start)
+    return;
+
+  bounds = (off_t *)ccze_calloc (jobs + 1, sizeof (off_t));
+  for (k = 0; k < jobs; k++)
+    bounds[k] = _ccze_line_start (input.fd, start + (st.st_size - start) /
+				  jobs * k, st.st_size);
+  bounds[0] = start;
+  bounds[jobs] = st.st_size;
+
+  end = bounds[jobs];
+  workers = (int *)ccze_calloc (jobs, sizeof (int));
+  for (k = jobs - 1; k > 0; k--)
+    {
+      if (bounds[k] >= end || pipe (p))
+	continue;
+      switch (fork ())
 	{
-	  asprintf (&homerc, "%s/.colorizerc", home);
-	  ccze_color_load (homerc);
-	  free (homerc);
-	  asprintf (&homerc, "%s/.cczerc", home);
-	  ccze_color_load (homerc);
-	  free (homerc);
+	case -1:
+	  close (p[0]);
+	  close (p[1]);
+	  continue;
+	case 0:
+	  signal (SIGINT, SIG_DFL);
+	  close (p[0]);
+	  while (nworkers > 0)
+	    close (workers[--nworkers]);
+	  worker_fd = p[1];
+	  input.len = input.pos = 0;
+	  input.offset = bounds[k];
+	  input.left = end - bounds[k];
+	  free (bounds);
+	  return;
+	default:
+	  close (p[1]);
+	  workers[nworkers++] = p[0];
+	  end = bounds[k];
+	  break;
 	}
     }
 
-  while (ccze_config.color_argv_len > 0)
+  /* Whatever was already read past the first part is dropped. */
+  if ((off_t)(input.len - input.pos) > end - start)
+    input.len = input.pos + (end - start);
+  input.offset = start + (input.len - input.pos);
+  input.left = end - input.offset;
+  free (bounds);
+}
+
+static void
+_ccze_summary_collect (void)
+{
+  FILE *f;
+
+  if (worker_fd >= 0)
     {
-      ccze_color_parse (ccze_config.color_argv[ccze_config.color_argv_len - 1]);
-      free (ccze_config.color_argv[--ccze_config.color_argv_len]);
+      if ((f = fdopen (worker_fd, "w")) != NULL)
+	{
+	  ccze_summary_write (f);
+	  fclose (f);
+	}
+      _exit (0);
     }
+
+  while (nworkers > 0)
+    if ((f = fdopen (workers[--nworkers], "r")) != NULL)
+      {
+	ccze_summary_merge (f);
+	fclose (f);
+      }
+  while (wait (NULL) > 0)
+    ;
+  free (workers);
+  workers = NULL;
+}
+
+/* Set up the colors and highlights, from the rc files and the -c
+   options. */
+static void
+_ccze_colors_load (void)
+{
+  int i;
+
+  ccze_color_init ();
+  ccze_hashcolor_reset ();
+  ccze_rc_load (ccze_config.rcfile);
+  /* The parser cuts the line up, and the options are needed again
+     upon reload. */
+  for (i = ccze_config.color_argv_len - 1; i >= 0; i--)
+    {
+      char *tmp = strdup (ccze_config.color_argv[i]);
+
+      ccze_color_parse (tmp);
+      free (tmp);
+    }
+  ccze_highlight_setup ();
+}
+
+/* Upon SIGHUP, reread the rc files, and load whatever new plugins
+   there are. This is done between two lines, so every line is
+   colored either with the old colors or the new ones. The plugins
+   already loaded, their compiled patterns and the lookup caches are
+   kept, and so is the terminal. */
+static void
+_ccze_reload (void)
+{
+  sighup_received = 0;
+  ccze_highlight_shutdown ();
+  _ccze_colors_load ();
+  ccze_plugin_reload ();
+  if (ccze_config.mode == CCZE_MODE_CURSES)
+    ccze_scroll_redraw ();
+}
+
+static void
+ccze_main (void)
+{
+  int i, j;
+  ccze_plugin_t **plugins;
+  struct sigaction sa;
+
+  ccze_plugin_init ();
+  _ccze_colors_load ();
   
   if (ccze_config.mode == CCZE_MODE_CURSES)
     {
-      initscr ();
+      /* The keyboard is only available for the pager if the logs
+	 come from somewhere else. */
+      if (!ccze_tty && ccze_config.scrollback && !isatty (input.fd))
+	ccze_tty = fopen ("/dev/tty", "r");
+      if (ccze_tty)
+	{
+	  newterm (NULL, stdout, ccze_tty);
+	  cbreak ();
+	  noecho ();
+	  keypad (stdscr, TRUE);
+	  nodelay (stdscr, TRUE);
+	}
+      else
+	initscr ();
       signal (SIGWINCH, sigwinch_handler);
       nonl ();
       if (ccze_config.scroll)
@@ -650,7 +1000,11 @@ ccze_main (void)
     }
   
   signal (SIGINT, sigint_handler);
-  signal (SIGHUP, sighup_handler);
+  /* Not restarted: a read waiting for more of the log has to return,
+     for the reload not to wait for the next line. */
+  memset (&sa, 0, sizeof (sa));
+  sa.sa_handler = sighup_handler;
+  sigaction (SIGHUP, &sa, NULL);
   
   ccze_wordcolor_setup ();
 
@@ -683,64 +1037,89 @@ ccze_main (void)
     }
   
   ccze_plugin_setup ();
-  
-  while ((getline (&subject, &subjlen, stdin) != -1) && !sighup_received)
+
+  if (ccze_config.mode == CCZE_MODE_INDEX)
     {
-      int handled = 0;
-      int status = 0;
-      char *rest = NULL, *rest2 = NULL;
-      char *tmp = strchr (subject, '\n');
-      unsigned int remfac_tmp;
+      if (ccze_index_build (ccze_config.infile,
+			    ccze_config.index_interval))
+	{
+	  fprintf (stderr, "ccze: Cannot index %s: %s\n",
+		   ccze_config.infile, strerror (errno));
+	  exit (1);
+	}
+      sigint_handler (0);
+    }
+
+  /* Skip to the start of the time range. */
+  if (ccze_config.from != (time_t)-1)
+    {
+      off_t off = ccze_index_seek (ccze_config.infile, input.fd,
+				   ccze_config.from);
+
+      if (off > 0)
+	lseek (input.fd, off, SEEK_SET);
+    }
 
-      if (tmp)
-	tmp[0] = '\0';
+  if (ccze_config.mode == CCZE_MODE_SUMMARY && ccze_config.jobs > 1)
+    _ccze_summary_fork (ccze_config.jobs);
 
-      if (ccze_config.remfac && (sscanf (subject, "<%u>", &remfac_tmp) > 0))
+  for (;;)
+    {
+      char *line;
+
+      while (!sighup_received && !ccze_filter_done () &&
+	     (line = _ccze_input_line ()) != NULL)
+	ccze_process_line (plugins, line);
+      if (input.dropped && input.pos >= input.len)
+	_ccze_input_dropped ();
+      if (ccze_filter_done () && !input.eof)
 	{
-	  tmp = strdup (strchr (subject, '>') + 1);
-	  free (subject);
-	  subject = tmp;
+	  input.eof = 1;
+	  if (ccze_tty)
+	    ccze_scroll_eof ();
 	}
-
-      subjlen = strlen (subject);
-      ccze_plugin_run (plugins, subject, subjlen, &rest,
-		       CCZE_PLUGIN_TYPE_FULL, &handled, &status);
-      
-      if (rest)
+      if (input.eof)
+	ccze_collapse_expire (1);
+      if (ccze_config.mode == CCZE_MODE_CURSES)
+	refresh ();
+      else if (ccze_config.mode == CCZE_MODE_TOKENS)
+	ccze_tokens_flush ();
+      if (sighup_received)
 	{
-	  handled = 0;
-	  ccze_plugin_run (plugins, rest, strlen (rest), &rest2,
-			   CCZE_PLUGIN_TYPE_PARTIAL, &handled, &status);
-	  if (handled == 0)
-	    ccze_wordcolor_process (rest, ccze_config.wcol,
-				    ccze_config.slookup);
-	  else
-	    ccze_wordcolor_process (rest2, ccze_config.wcol,
-				    ccze_config.slookup);
-	  ccze_newline ();
-	  free (rest);
-	  free (rest2);
+	  _ccze_reload ();
+	  plugins = ccze_plugins ();
+	  continue;
 	}
 
-      if (status == 0)
+      if (ccze_tty)
 	{
-	  ccze_wordcolor_process (subject, ccze_config.wcol,
-				  ccze_config.slookup);
-	  ccze_newline ();
+	  int r = _ccze_wait_input ();
+
+	  if (r < 0)
+	    break;
+	  if (r == 0)
+	    continue;
+	}
+      else if (input.eof)
+	break;
+      else if (!_ccze_input_ready (ccze_collapse_timeout ()))
+	{
+	  ccze_collapse_expire (0);
+	  continue;
 	}
 
-      if (ccze_config.mode == CCZE_MODE_CURSES)
-	refresh ();
+      if (_ccze_input_fill () <= 0 && input.eof && ccze_tty)
+	ccze_scroll_eof ();
     }
 
-  if (ccze_config.mode == CCZE_MODE_CURSES)
-    refresh ();
+  if (input.eof && (workers || worker_fd >= 0))
+    _ccze_summary_collect ();
 }
 
 int
 main (int argc, char **argv)
 {
-      
+  ccze_out = stdout;
   ccze_config.pluginlist = (char **)ccze_calloc (ccze_config.pluginlist_alloc,
 						 sizeof (char *));
   ccze_config.color_argv = (char **)ccze_calloc (ccze_config.color_argv_alloc,
@@ -748,12 +1127,59 @@ main (int argc, char **argv)
   ccze_plugin_argv_init ();
   argp_parse (&argp, argc, argv, 0, 0, NULL);
 
-  do
+  if (ccze_config.infile && ccze_config.mode != CCZE_MODE_INDEX)
     {
-      ccze_main ();
-      ccze_wordcolor_shutdown ();
-      ccze_plugin_shutdown ();
-    } while (sighup_received);
+      int fd = open (ccze_config.infile, O_RDONLY);
+
+      if (fd < 0)
+	{
+	  fprintf (stderr, "ccze: Cannot open %s: %s\n",
+		   ccze_config.infile, strerror (errno));
+	  exit (1);
+	}
+      _ccze_input_init (fd);
+    }
+  else
+    _ccze_input_init (STDIN_FILENO);
+
+  if (remote)
+    {
+      signal (SIGINT, sigint_handler);
+      if (ccze_remote (remote, input.fd))
+	exit (1);
+      sigint_handler (0);
+    }
+
+  /* Only pipes and sockets have a writer to keep from waiting. */
+  if (ccze_config.buffer && ccze_config.mode != CCZE_MODE_INDEX)
+    {
+      struct stat st;
+      int fd;
+
+      if (!fstat (input.fd, &st) &&
+	  (S_ISFIFO (st.st_mode) || S_ISSOCK (st.st_mode)) &&
+	  (fd = ccze_ring_start (input.fd, ccze_config.buffer,
+				 ccze_config.overflow)) >= 0)
+	{
+	  input.fd = fd;
+	  input.ring = 1;
+	}
+    }
+
+  if (ccze_config.from != (time_t)-1 || ccze_config.to != (time_t)-1)
+    ccze_filter_range (ccze_config.from, ccze_config.to);
+  ccze_line_init ();
+  if (ccze_config.mode == CCZE_MODE_CURSES)
+    ccze_scroll_init (ccze_config.scrollback);
+  if (ccze_config.collapse)
+    ccze_collapse_init (ccze_config.collapse, ccze_config.collapse_time);
+  if (ccze_config.mode == CCZE_MODE_SUMMARY)
+    ccze_summary_init (ccze_config.summary_bucket);
+
+  ccze_main ();
+  ccze_wordcolor_shutdown ();
+  ccze_highlight_shutdown ();
+  ccze_plugin_shutdown ();
 
   sigint_handler (0);
   
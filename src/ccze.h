@@ -122,9 +122,31 @@ int ccze_color_keyword_lookup (const char *key);
 /* Helpers */
 ccze_color_t ccze_http_action (const char *method);
 void ccze_print_date (const char *date);
+int ccze_syslog_pri (const char *str, size_t *len);
 char *ccze_strbrk (char *str, char delim);
 char *xstrdup (const char *str);
 
+/* Color maps */
+typedef struct ccze_colormap ccze_colormap_t;
+typedef ccze_color_t (*ccze_colormap_fallback_t) (const char *token);
+
+ccze_colormap_t *ccze_colormap_new (const char *name, int nocase,
+				    ccze_colormap_fallback_t fallback);
+void ccze_colormap_add (ccze_colormap_t *map, const char *token,
+			ccze_color_t col);
+ccze_color_t ccze_colormap_lookup (ccze_colormap_t *map, const char *token);
+
+/* Key=value pairs */
+typedef struct
+{
+  char *key;
+  char *value;
+  int quoted;
+} ccze_kv_t;
+
+char *ccze_kv_next (char *str, char delim, ccze_kv_t *kv);
+void ccze_kv_add (const ccze_kv_t *kv, int slookup);
+
 /* Display */
 void ccze_addstr (ccze_color_t col, const char *str);
 void ccze_newline (void);
@@ -159,6 +181,7 @@ typedef struct
 
 char **ccze_plugin_argv_get (const char *name);
 const char *ccze_plugin_name_get (void);
+void ccze_plugin_continuation (const char *regex);
 
 #define CCZE_ABI_VERSION 2
 
@@ -0,0 +1,499 @@
+/* -*- mode: c; c-file-style: "gnu" -*-
+ * cczed.c -- Colorize logs for many clients, with one warm engine
+ * Copyright (C) 2003 Gergely Nagy <algernon@bonehunter.rulez.org>
+ *
+ * This file is part of ccze.
+ *
+ * ccze is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ccze is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include <ccze.h>
+#ifdef HAVE_ARGP_H
+# include <argp.h>
+#endif
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "ccze-compat.h"
+#include "ccze-private.h"
+
+/* The log a client sent is read into a buffer of this size, and a
+   line longer than that is colorized in pieces of it; no more is read
+   while this much of the output is waiting to be sent back. So a
+   client costs these two buffers and a context, however much it
+   sends, and memory grows with the number of clients by that much. */
+#define CCZED_BUFSIZE (64 * 1024)
+#define CCZED_BACKLOG (256 * 1024)
+
+const char *argp_program_name = "cczed";
+const char *argp_program_version = "cczed (ccze 0.2." PATCHLEVEL ")";
+const char *argp_program_bug_address = "<algernon@bonehunter.rulez.org>";
+static struct argp_option options[] = {
+  {NULL, 0, NULL, 0, "", 1},
+  {"rcfile", 'F', "FILE", 0, "Read configuration from FILE", 1},
+  {"socket", 'S', "SOCKET", 0, "Listen on SOCKET", 1},
+  {"workers", 'w', "N", 0, "Serve clients with N processes", 1},
+  {NULL, 0, NULL, 0,  NULL, 0}
+};
+
+static error_t parse_opt (int key, char *arg, struct argp_state *state);
+static struct argp argp =
+  {options, parse_opt, NULL, "cczed -- colorize logs for ccze --remote",
+   NULL, NULL, NULL};
+
+static char *rcfile = NULL;
+static char *sockpath = CCZE_REMOTE_SOCKET;
+static int nworkers = 0;
+
+typedef struct
+{
+  int fd;
+  ccze_ctx_t *ctx;
+  char *in;
+  size_t inlen;
+  /* How much of an unterminated line the context is holding. */
+  size_t partial;
+  int eof;
+  char *out;
+  size_t outlen, outpos, outalloc;
+
+  /* For the report. */
+  char who[64];
+  size_t lines, bytes_in, bytes_out;
+  struct timeval start;
+} cczed_client_t;
+
+static cczed_client_t **clients = NULL;
+static size_t nclients = 0, clients_alloc = 0;
+
+/* Every client has a context of its own, so that one's stack trace
+   cannot swallow the lines of another. This one is only there to keep
+   the plugins loaded while no client is. */
+static ccze_ctx_t *warm;
+
+/* The processes serving the clients, all forked from the one that
+   warmed the engine up, so they share it until they write to it. */
+static pid_t *workers;
+
+static volatile sig_atomic_t report_wanted = 0, quit_wanted = 0;
+static volatile sig_atomic_t child_gone = 0;
+
+static error_t
+parse_opt (int key, char *arg, struct argp_state *state)
+{
+  switch (key)
+    {
+    case 'F':
+      rcfile = arg;
+      break;
+    case 'S':
+      sockpath = arg;
+      break;
+    case 'w':
+      if ((nworkers = atoi (arg)) <= 0)
+	argp_error (state, "invalid number of workers: `%s'", arg);
+      break;
+    default:
+      return ARGP_ERR_UNKNOWN;
+    }
+  return 0;
+}
+
+static void
+sigusr1_handler (int sig)
+{
+  report_wanted = 1;
+}
+
+static void
+sigterm_handler (int sig)
+{
+  quit_wanted = 1;
+}
+
+static void
+sigchld_handler (int sig)
+{
+  child_gone = 1;
+}
+
+static void
+_cczed_report (const cczed_client_t *c, const char *what)
+{
+  struct timeval now;
+  double secs;
+
+  gettimeofday (&now, NULL);
+  secs = (now.tv_sec - c->start.tv_sec) +
+    (now.tv_usec - c->start.tv_usec) / 1000000.0;
+  fprintf (stderr, "cczed: %s %s: %lu lines, %lu bytes in, %lu out, "
+	   "%.2fs, %.0f lines/s\n", c->who, what, (unsigned long)c->lines,
+	   (unsigned long)c->bytes_in, (unsigned long)c->bytes_out, secs,
+	   (secs > 0) ? c->lines / secs : 0.0);
+}
+
+static void
+_cczed_sink (const char *buf, size_t len, void *data)
+{
+  cczed_client_t *c = (cczed_client_t *)data;
+
+  if (c->outlen + len > c->outalloc)
+    {
+      if (c->outpos > 0)
+	{
+	  memmove (c->out, c->out + c->outpos, c->outlen - c->outpos);
+	  c->outlen -= c->outpos;
+	  c->outpos = 0;
+	}
+      while (c->outlen + len > c->outalloc)
+	c->outalloc = (c->outalloc) ? c->outalloc * 2 : CCZED_BUFSIZE;
+      c->out = (char *)ccze_realloc (c->out, c->outalloc);
+    }
+  memcpy (c->out + c->outlen, buf, len);
+  c->outlen += len;
+  c->bytes_out += len;
+}
+
+static void
+_cczed_accept (int lsock)
+{
+  cczed_client_t *c;
+  int fd;
+#ifdef SO_PEERCRED
+  struct ucred cred;
+  socklen_t credlen = sizeof (cred);
+#endif
+
+  if ((fd = accept (lsock, NULL, NULL)) < 0)
+    return;
+  fcntl (fd, F_SETFL, fcntl (fd, F_GETFL) | O_NONBLOCK);
+
+  c = (cczed_client_t *)ccze_calloc (1, sizeof (cczed_client_t));
+  c->fd = fd;
+  c->in = (char *)ccze_malloc (CCZED_BUFSIZE);
+  gettimeofday (&c->start, NULL);
+  snprintf (c->who, sizeof (c->who), "client %d", fd);
+#ifdef SO_PEERCRED
+  if (!getsockopt (fd, SOL_SOCKET, SO_PEERCRED, &cred, &credlen))
+    snprintf (c->who, sizeof (c->who), "pid %ld (uid %ld)",
+	      (long)cred.pid, (long)cred.uid);
+#endif
+
+  if (nclients == clients_alloc)
+    {
+      clients_alloc = (clients_alloc) ? clients_alloc * 2 : 16;
+      clients = (cczed_client_t **)ccze_realloc
+	(clients, clients_alloc * sizeof (cczed_client_t *));
+    }
+  clients[nclients++] = c;
+}
+
+static void
+_cczed_close (size_t i, const char *what)
+{
+  cczed_client_t *c = clients[i];
+
+  _cczed_report (c, what);
+  close (c->fd);
+  ccze_ctx_free (c->ctx);
+  free (c->in);
+  free (c->out);
+  free (c);
+  clients[i] = clients[--nclients];
+}
+
+/* Colorize whatever the client sent, and at its end, an unterminated
+   last line too. Returns -1 if the client did not start with a valid
+   request. */
+static int
+_cczed_process (cczed_client_t *c)
+{
+  char *nl;
+  size_t n;
+
+  if (!c->ctx)
+    {
+      ccze_ctx_config_t config;
+
+      if (!(nl = (char *)memchr (c->in, '\n', c->inlen)))
+	return (c->eof || c->inlen == CCZED_BUFSIZE) ? -1 : 0;
+      *nl = '\0';
+      if (ccze_remote_parse (c->in, &config) < 0)
+	return -1;
+      config.rcfile = rcfile;
+      if (!(c->ctx = ccze_ctx_new (&config)))
+	return -1;
+
+      n = nl - c->in + 1;
+      memmove (c->in, c->in + n, c->inlen - n);
+      c->inlen -= n;
+    }
+
+  /* The context keeps an unterminated line until its end comes, or
+     until it is as long as a buffer, so that a client sending no
+     newline cannot have it grow without end. */
+  c->lines += ccze_colorize (c->ctx, c->in, c->inlen, _cczed_sink, c);
+  if ((nl = (char *)memrchr (c->in, '\n', c->inlen)) != NULL)
+    c->partial = c->inlen - (nl - c->in + 1);
+  else
+    c->partial += c->inlen;
+  c->inlen = 0;
+  if (c->eof || c->partial >= CCZED_BUFSIZE)
+    {
+      c->lines += ccze_ctx_flush (c->ctx, _cczed_sink, c);
+      c->partial = 0;
+    }
+  return 0;
+}
+
+static int
+_cczed_listen (const char *path)
+{
+  struct sockaddr_un addr;
+  struct stat st;
+  int sock;
+
+  memset (&addr, 0, sizeof (addr));
+  addr.sun_family = AF_UNIX;
+  strncpy (addr.sun_path, path, sizeof (addr.sun_path) - 1);
+
+  /* A socket left behind by a cczed that is gone. */
+  if (!lstat (path, &st) && S_ISSOCK (st.st_mode))
+    unlink (path);
+
+  if ((sock = socket (AF_UNIX, SOCK_STREAM, 0)) < 0 ||
+      bind (sock, (struct sockaddr *)&addr, sizeof (addr)) < 0 ||
+      listen (sock, SOMAXCONN) < 0)
+    return -1;
+  /* Anyone may have their logs colorized. */
+  chmod (path, 0666);
+  return sock;
+}
+
+/* Serve clients, accepting them on LSOCK, until told to quit. */
+static void
+_cczed_serve (int lsock)
+{
+  struct pollfd *fds = NULL;
+  size_t fds_alloc = 0, i;
+  int k;
+
+  while (!quit_wanted)
+    {
+      if (nclients + 1 > fds_alloc)
+	{
+	  fds_alloc = nclients + 16;
+	  fds = (struct pollfd *)ccze_realloc
+	    (fds, fds_alloc * sizeof (struct pollfd));
+	}
+      fds[0].fd = lsock;
+      fds[0].events = POLLIN;
+      for (i = 0; i < nclients; i++)
+	{
+	  cczed_client_t *c = clients[i];
+
+	  fds[i + 1].fd = c->fd;
+	  fds[i + 1].events = 0;
+	  if (c->outpos < c->outlen)
+	    fds[i + 1].events |= POLLOUT;
+	  if (!c->eof && c->inlen < CCZED_BUFSIZE &&
+	      c->outlen - c->outpos < CCZED_BACKLOG)
+	    fds[i + 1].events |= POLLIN;
+	}
+
+      if (poll (fds, nclients + 1, -1) < 0 && errno != EINTR)
+	break;
+
+      if (report_wanted)
+	{
+	  report_wanted = 0;
+	  fprintf (stderr, "cczed[%ld]: %lu clients\n", (long)getpid (),
+		   (unsigned long)nclients);
+	  for (i = 0; i < nclients; i++)
+	    _cczed_report (clients[i], "so far");
+	}
+
+      /* Clients are served in the order they are in the table; a
+	 closed one is replaced by the last, so walk backwards. No more
+	 than a buffer is read from any of them before the others had
+	 their turn. */
+      for (k = (int)nclients - 1; k >= 0; k--)
+	{
+	  cczed_client_t *c = clients[k];
+	  short revents = fds[k + 1].revents;
+	  ssize_t n;
+
+	  if (revents & POLLOUT)
+	    {
+	      n = write (c->fd, c->out + c->outpos, c->outlen - c->outpos);
+	      if (n < 0 && errno != EAGAIN && errno != EINTR)
+		{
+		  _cczed_close (k, "lost");
+		  continue;
+		}
+	      if (n > 0 && (c->outpos += n) == c->outlen)
+		c->outpos = c->outlen = 0;
+	    }
+	  if (revents & (POLLIN | POLLHUP | POLLERR))
+	    {
+	      n = read (c->fd, c->in + c->inlen, CCZED_BUFSIZE - c->inlen);
+	      if (n > 0)
+		{
+		  c->inlen += n;
+		  c->bytes_in += n;
+		}
+	      else if (n == 0 || (errno != EAGAIN && errno != EINTR))
+		c->eof = 1;
+	      if (_cczed_process (c) < 0)
+		{
+		  _cczed_close (k, "sent a bad request");
+		  continue;
+		}
+	    }
+	  if (c->eof && !c->inlen && c->outpos == c->outlen)
+	    _cczed_close (k, "done");
+	}
+
+      /* Every worker is woken up by a new client, and all but one of
+	 them find it already taken. */
+      if (fds[0].revents & POLLIN)
+	_cczed_accept (lsock);
+    }
+
+  while (nclients > 0)
+    _cczed_close (nclients - 1, "cut off");
+  free (fds);
+}
+
+/* Start a worker serving the clients on LSOCK. Returns its pid, or -1
+   if it could not be started. */
+static pid_t
+_cczed_spawn (int lsock, const sigset_t *mask)
+{
+  pid_t pid;
+
+  if ((pid = fork ()) != 0)
+    return pid;
+
+  signal (SIGCHLD, SIG_DFL);
+  sigprocmask (SIG_SETMASK, mask, NULL);
+  _cczed_serve (lsock);
+  ccze_ctx_free (warm);
+  _exit (0);
+}
+
+int
+main (int argc, char *argv[])
+{
+  struct sigaction sa;
+  sigset_t block, old;
+  pid_t pid;
+  int lsock, k, alive;
+
+  ccze_out = stdout;
+  argp_parse (&argp, argc, argv, 0, 0, NULL);
+  if (nworkers <= 0 && (nworkers = sysconf (_SC_NPROCESSORS_ONLN)) <= 0)
+    nworkers = 1;
+
+  if ((lsock = _cczed_listen (sockpath)) < 0)
+    {
+      fprintf (stderr, "cczed: Cannot listen on %s: %s\n", sockpath,
+	       strerror (errno));
+      return 1;
+    }
+  /* The workers all wait for new clients, and only one gets each. */
+  fcntl (lsock, F_SETFL, fcntl (lsock, F_GETFL) | O_NONBLOCK);
+
+  /* Warm the engine up with what plain ccze --remote asks for. */
+  {
+    ccze_ctx_config_t config;
+
+    ccze_ctx_config_init (&config);
+    config.rcfile = rcfile;
+    warm = ccze_ctx_new (&config);
+  }
+
+  /* Not restarted, and only let through while waiting below, so that
+     none of them is missed. */
+  memset (&sa, 0, sizeof (sa));
+  sa.sa_handler = sigusr1_handler;
+  sigaction (SIGUSR1, &sa, NULL);
+  sa.sa_handler = sigterm_handler;
+  sigaction (SIGINT, &sa, NULL);
+  sigaction (SIGTERM, &sa, NULL);
+  sa.sa_handler = sigchld_handler;
+  sigaction (SIGCHLD, &sa, NULL);
+  signal (SIGPIPE, SIG_IGN);
+
+  sigemptyset (&block);
+  sigaddset (&block, SIGUSR1);
+  sigaddset (&block, SIGINT);
+  sigaddset (&block, SIGTERM);
+  sigaddset (&block, SIGCHLD);
+  sigprocmask (SIG_BLOCK, &block, &old);
+
+  workers = (pid_t *)ccze_calloc (nworkers, sizeof (pid_t));
+  while (!quit_wanted)
+    {
+      /* Start the workers, and another for any that died. */
+      for (k = 0; k < nworkers; k++)
+	if (workers[k] <= 0 && (workers[k] = _cczed_spawn (lsock, &old)) < 0)
+	  fprintf (stderr, "cczed: Cannot start a worker: %s\n",
+		   strerror (errno));
+
+      sigsuspend (&old);
+
+      if (child_gone)
+	{
+	  child_gone = 0;
+	  while ((pid = waitpid (-1, NULL, WNOHANG)) > 0)
+	    for (k = 0; k < nworkers; k++)
+	      if (workers[k] == pid)
+		workers[k] = 0;
+	}
+      if (report_wanted)
+	{
+	  report_wanted = 0;
+	  for (k = 0; k < nworkers; k++)
+	    if (workers[k] > 0)
+	      kill (workers[k], SIGUSR1);
+	}
+    }
+
+  close (lsock);
+  unlink (sockpath);
+  for (k = 0, alive = 0; k < nworkers; k++)
+    if (workers[k] > 0)
+      {
+	kill (workers[k], SIGTERM);
+	alive++;
+      }
+  while (alive > 0 && waitpid (-1, NULL, 0) > 0)
+    alive--;
+  free (workers);
+  ccze_ctx_free (warm);
+  return 0;
+}
@@ -0,0 +1,84 @@
+/* -*- mode: c; c-file-style: "gnu" -*-
+ * libccze.h -- Colorize logs from within other programs
+ * Copyright (C) 2003 Gergely Nagy <algernon@bonehunter.rulez.org>
+ *
+ * This file is part of ccze.
+ *
+ * ccze is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ccze is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#ifndef _LIBCCZE_H
+#define _LIBCCZE_H 1
+
+#include <stddef.h>
+
+/* The plugin interface is in ccze.h; this is all a program needs to
+   have its logs colorized.
+
+   The library is not reentrant yet (see TODO). Underneath is the
+   same engine ccze itself drives, and there is only one of it in a
+   process, so no two calls may be in progress at the same time, even
+   with different contexts: a program with threads has to take turns.
+   The plugins are loaded with the first context and unloaded with the
+   last.
+
+   What contexts are for is colorizing more than one stream in turn.
+   A context holds the settings and colors of its stream, whatever
+   part of a line it was given but has not seen the end of yet, and
+   the multi-line record (a stack trace, say) its last line may be
+   continuing, and these are swapped in whenever it is used. */
+
+typedef enum
+{
+  CCZE_OUTPUT_ANSI,
+  CCZE_OUTPUT_HTML,
+  CCZE_OUTPUT_DEBUG,
+  CCZE_OUTPUT_JSON
+} ccze_output_t;
+
+typedef struct
+{
+  ccze_output_t output;
+  /* The rc file to read, or NULL for the same ones ccze reads. */
+  const char *rcfile;
+  int wordcolor;
+  int lookups;
+  int convdate;
+  int remfac;
+  int transparent;
+  int hashcolor;
+} ccze_ctx_config_t;
+
+typedef struct ccze_ctx ccze_ctx_t;
+
+/* Where the output goes: LEN bytes at BUF, which are only valid
+   during the call. DATA is whatever was given to ccze_colorize(). */
+typedef void (*ccze_sink_t) (const char *buf, size_t len, void *data);
+
+/* The defaults of ccze -A. */
+void ccze_ctx_config_init (ccze_ctx_config_t *config);
+
+ccze_ctx_t *ccze_ctx_new (const ccze_ctx_config_t *config);
+void ccze_ctx_free (ccze_ctx_t *ctx);
+
+/* Colorize every complete line among the LEN bytes at IN, and keep
+   the rest for the next call. HTML output is only the lines, without
+   a document around them. Returns the number of lines colorized. */
+int ccze_colorize (ccze_ctx_t *ctx, const char *in, size_t len,
+		   ccze_sink_t sink, void *data);
+/* Colorize what is left of an unterminated last line. */
+int ccze_ctx_flush (ccze_ctx_t *ctx, ccze_sink_t sink, void *data);
+
+#endif /* !_LIBCCZE_H */
@@ -20,6 +20,7 @@
  */
 
 #include <ccze.h>
+#include <ctype.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -29,7 +30,100 @@ static int ccze_httpd_handle (const char *str, size_t length, char **rest);
 
 static pcre *reg_httpd_access, *reg_httpd_error;
 static pcre_extra *hints_httpd_access, *hints_httpd_error;
+static ccze_colormap_t *httpd_levels;
 
+/* With -a httpd='LOGFORMAT', access lines are split by the LogFormat
+   of the server (Apache's %-directives, or nginx's $variables) instead
+   of the regex: it is compiled into steps, each either literal text
+   the line must have there, or a field, which ends where the literal
+   after it begins. Lines that do not fit are left to the regex. */
+typedef enum
+{
+  HTTPD_LITERAL,
+  HTTPD_FIELD_TEXT,		/* Anything */
+  HTTPD_FIELD_NUMBER,		/* Digits and dots, or "-" */
+  HTTPD_FIELD_STATUS,		/* Three digits */
+  HTTPD_FIELD_DATE,		/* [...], or anything */
+  HTTPD_FIELD_REQUEST		/* Colored by the method it starts with */
+} httpd_step_kind_t;
+
+typedef struct
+{
+  httpd_step_kind_t kind;
+  ccze_color_t color;
+  size_t litlen;
+  char *lit;
+} httpd_step_t;
+
+typedef struct
+{
+  const char *name;
+  httpd_step_kind_t kind;
+  ccze_color_t color;
+} httpd_directive_t;
+
+static const httpd_directive_t httpd_directives[] = {
+  /* Apache */
+  {"a", HTTPD_FIELD_TEXT, CCZE_COLOR_HOST},
+  {"A", HTTPD_FIELD_TEXT, CCZE_COLOR_HOST},
+  {"b", HTTPD_FIELD_NUMBER, CCZE_COLOR_GETSIZE},
+  {"B", HTTPD_FIELD_NUMBER, CCZE_COLOR_GETSIZE},
+  {"D", HTTPD_FIELD_NUMBER, CCZE_COLOR_GETTIME},
+  {"f", HTTPD_FIELD_TEXT, CCZE_COLOR_DIR},
+  {"h", HTTPD_FIELD_TEXT, CCZE_COLOR_HOST},
+  {"H", HTTPD_FIELD_TEXT, CCZE_COLOR_PROT},
+  {"I", HTTPD_FIELD_NUMBER, CCZE_COLOR_GETSIZE},
+  {"k", HTTPD_FIELD_NUMBER, CCZE_COLOR_NUMBERS},
+  {"l", HTTPD_FIELD_TEXT, CCZE_COLOR_IDENT},
+  {"L", HTTPD_FIELD_TEXT, CCZE_COLOR_UNIQN},
+  {"m", HTTPD_FIELD_REQUEST, CCZE_COLOR_DEFAULT},
+  {"O", HTTPD_FIELD_NUMBER, CCZE_COLOR_GETSIZE},
+  {"p", HTTPD_FIELD_NUMBER, CCZE_COLOR_NUMBERS},
+  {"P", HTTPD_FIELD_NUMBER, CCZE_COLOR_PID},
+  {"q", HTTPD_FIELD_TEXT, CCZE_COLOR_URI},
+  {"r", HTTPD_FIELD_REQUEST, CCZE_COLOR_DEFAULT},
+  {"s", HTTPD_FIELD_STATUS, CCZE_COLOR_HTTPCODES},
+  {"S", HTTPD_FIELD_NUMBER, CCZE_COLOR_GETSIZE},
+  {"t", HTTPD_FIELD_DATE, CCZE_COLOR_DATE},
+  {"T", HTTPD_FIELD_NUMBER, CCZE_COLOR_GETTIME},
+  {"u", HTTPD_FIELD_TEXT, CCZE_COLOR_USER},
+  {"U", HTTPD_FIELD_TEXT, CCZE_COLOR_URI},
+  {"v", HTTPD_FIELD_TEXT, CCZE_COLOR_HOST},
+  {"V", HTTPD_FIELD_TEXT, CCZE_COLOR_HOST},
+  /* nginx */
+  {"body_bytes_sent", HTTPD_FIELD_NUMBER, CCZE_COLOR_GETSIZE},
+  {"bytes_sent", HTTPD_FIELD_NUMBER, CCZE_COLOR_GETSIZE},
+  {"host", HTTPD_FIELD_TEXT, CCZE_COLOR_HOST},
+  {"msec", HTTPD_FIELD_NUMBER, CCZE_COLOR_DATE},
+  {"pid", HTTPD_FIELD_NUMBER, CCZE_COLOR_PID},
+  {"remote_addr", HTTPD_FIELD_TEXT, CCZE_COLOR_HOST},
+  {"remote_user", HTTPD_FIELD_TEXT, CCZE_COLOR_USER},
+  {"request", HTTPD_FIELD_REQUEST, CCZE_COLOR_DEFAULT},
+  {"request_id", HTTPD_FIELD_TEXT, CCZE_COLOR_UNIQN},
+  {"request_length", HTTPD_FIELD_NUMBER, CCZE_COLOR_GETSIZE},
+  {"request_method", HTTPD_FIELD_REQUEST, CCZE_COLOR_DEFAULT},
+  {"request_time", HTTPD_FIELD_NUMBER, CCZE_COLOR_GETTIME},
+  {"request_uri", HTTPD_FIELD_TEXT, CCZE_COLOR_URI},
+  {"server_name", HTTPD_FIELD_TEXT, CCZE_COLOR_HOST},
+  {"server_protocol", HTTPD_FIELD_TEXT, CCZE_COLOR_PROT},
+  {"status", HTTPD_FIELD_STATUS, CCZE_COLOR_HTTPCODES},
+  {"time_iso8601", HTTPD_FIELD_DATE, CCZE_COLOR_DATE},
+  {"time_local", HTTPD_FIELD_DATE, CCZE_COLOR_DATE},
+  {"upstream_response_time", HTTPD_FIELD_TEXT, CCZE_COLOR_GETTIME},
+  {"uri", HTTPD_FIELD_TEXT, CCZE_COLOR_URI},
+  {NULL, HTTPD_FIELD_TEXT, CCZE_COLOR_DEFAULT}
+};
+
+static httpd_step_t *httpd_steps;
+static size_t httpd_nsteps;
+/* Where each step begins in the line being split, and where the
+   last one ends. */
+static size_t *httpd_offsets;
+static char *httpd_line;
+static size_t httpd_line_alloc;
+
+/* Error log levels are looked up in the "httpd_level" color map;
+   this is what colors the ones not in it. */
 static ccze_color_t
 _ccze_httpd_error (const char *level)
 {
@@ -110,7 +204,7 @@ ccze_httpd_error_log_process (const char *str, int *offsets, int match)
   ccze_addstr (CCZE_COLOR_DATE, date);
   ccze_space ();
 
-  lcol = _ccze_httpd_error (level);
+  lcol = ccze_colormap_lookup (httpd_levels, level);
   ccze_addstr (lcol, level);
   ccze_space ();
 
@@ -125,10 +219,261 @@ ccze_httpd_error_log_process (const char *str, int *offsets, int match)
   return NULL;
 }
 
+static httpd_step_t *
+_ccze_httpd_step_add (httpd_step_kind_t kind, ccze_color_t color)
+{
+  httpd_steps = (httpd_step_t *)ccze_realloc
+    (httpd_steps, (httpd_nsteps + 1) * sizeof (httpd_step_t));
+  httpd_steps[httpd_nsteps].kind = kind;
+  httpd_steps[httpd_nsteps].color = color;
+  httpd_steps[httpd_nsteps].lit = NULL;
+  httpd_steps[httpd_nsteps].litlen = 0;
+  return &httpd_steps[httpd_nsteps++];
+}
+
+static void
+_ccze_httpd_literal_add (char c)
+{
+  httpd_step_t *step;
+
+  if (httpd_nsteps && httpd_steps[httpd_nsteps - 1].kind == HTTPD_LITERAL)
+    step = &httpd_steps[httpd_nsteps - 1];
+  else
+    step = _ccze_httpd_step_add (HTTPD_LITERAL, CCZE_COLOR_DEFAULT);
+  step->lit = (char *)ccze_realloc (step->lit, step->litlen + 2);
+  step->lit[step->litlen++] = c;
+  step->lit[step->litlen] = '\0';
+}
+
+/* A field for the directive NAME (LEN bytes), or for the request
+   header or nginx variable HEADER, if that is not NULL. */
+static void
+_ccze_httpd_field_add (const char *name, size_t len, const char *header,
+		       size_t hlen)
+{
+  const httpd_directive_t *d;
+
+  if (header)
+    {
+      ccze_color_t color = CCZE_COLOR_DEFAULT;
+
+      if (hlen == 7 && !strncasecmp (header, "referer", 7))
+	color = CCZE_COLOR_URI;
+      else if (hlen > 3 && !strncasecmp (header + hlen - 3, "-id", 3))
+	color = CCZE_COLOR_UNIQN;
+      else if (hlen > 3 && !strncasecmp (header + hlen - 3, "_id", 3))
+	color = CCZE_COLOR_UNIQN;
+      _ccze_httpd_step_add (HTTPD_FIELD_TEXT, color);
+      return;
+    }
+
+  for (d = httpd_directives; d->name; d++)
+    if (strlen (d->name) == len && !strncmp (d->name, name, len))
+      break;
+  _ccze_httpd_step_add (d->kind, d->color);
+}
+
+/* Compile FORMAT into httpd_steps. */
+static void
+_ccze_httpd_format_compile (const char *format)
+{
+  const char *p = format, *name, *arg;
+  size_t alen;
+
+  while (*p)
+    {
+      if (*p == '%' && p[1] == '%')
+	{
+	  _ccze_httpd_literal_add ('%');
+	  p += 2;
+	}
+      else if (*p == '%' && p[1])
+	{
+	  /* %[!][status codes][<>]{argument}letter */
+	  p++;
+	  p += strspn (p, "!,0123456789<>");
+	  arg = NULL;
+	  alen = 0;
+	  if (*p == '{' && strchr (p, '}'))
+	    {
+	      arg = p + 1;
+	      alen = strchr (p, '}') - arg;
+	      p = arg + alen + 1;
+	    }
+	  if (!*p)
+	    break;
+	  if (*p == 'i' && arg)
+	    _ccze_httpd_field_add (p, 1, arg, alen);
+	  else
+	    _ccze_httpd_field_add (p, 1, NULL, 0);
+	  p++;
+	}
+      else if (*p == '$' && (isalpha ((unsigned char)p[1]) || p[1] == '{'))
+	{
+	  /* $variable or ${variable} */
+	  int braced = (*++p == '{');
+
+	  name = p + braced;
+	  alen = 0;
+	  while (isalnum ((unsigned char)name[alen]) || name[alen] == '_')
+	    alen++;
+	  p = name + alen + (braced && name[alen] == '}');
+	  if (alen > 5 && !strncmp (name, "http_", 5))
+	    _ccze_httpd_field_add (name, alen, name + 5, alen - 5);
+	  else
+	    _ccze_httpd_field_add (name, alen, NULL, 0);
+	}
+      else
+	_ccze_httpd_literal_add (*p++);
+    }
+
+  httpd_offsets = (size_t *)ccze_malloc ((httpd_nsteps + 1) *
+					 sizeof (size_t));
+}
+
+/* Where the field starting at STR ends: at STOP, not counting escaped
+   ones, or at the end of the line if STOP is NUL. */
+static const char *
+_ccze_httpd_field_end (const char *str, const char *end, char stop)
+{
+  if (!stop)
+    return end;
+  while (str < end && *str != stop)
+    {
+      if (*str == '\\' && str + 1 < end)
+	str++;
+      str++;
+    }
+  return str;
+}
+
+/* Split STR by httpd_steps into httpd_offsets. Returns the length of
+   the part that fits, or 0 if the line does not. */
+static size_t
+_ccze_httpd_format_split (const char *str, size_t length)
+{
+  const char *p = str, *end = str + length, *fend;
+  size_t i, j, flen;
+
+  for (i = 0; i < httpd_nsteps; i++)
+    {
+      httpd_step_t *step = &httpd_steps[i];
+      char stop = ' ';
+
+      httpd_offsets[i] = p - str;
+      if (step->kind == HTTPD_LITERAL)
+	{
+	  if ((size_t)(end - p) < step->litlen ||
+	      memcmp (p, step->lit, step->litlen))
+	    return 0;
+	  p += step->litlen;
+	  continue;
+	}
+
+      if (i + 1 == httpd_nsteps)
+	stop = '\0';
+      else if (httpd_steps[i + 1].kind == HTTPD_LITERAL)
+	stop = httpd_steps[i + 1].lit[0];
+
+      if (step->kind == HTTPD_FIELD_DATE && p < end && *p == '[')
+	{
+	  fend = memchr (p, ']', end - p);
+	  if (!fend)
+	    return 0;
+	  fend++;
+	}
+      else
+	fend = _ccze_httpd_field_end (p, end, stop);
+      flen = fend - p;
+
+      switch (step->kind)
+	{
+	case HTTPD_FIELD_NUMBER:
+	  if (flen == 0)
+	    return 0;
+	  if (flen == 1 && *p == '-')
+	    break;
+	  for (j = 0; j < flen; j++)
+	    if (!isdigit ((unsigned char)p[j]) && p[j] != '.')
+	      return 0;
+	  break;
+	case HTTPD_FIELD_STATUS:
+	  if (flen != 3 || !isdigit ((unsigned char)p[0]) ||
+	      !isdigit ((unsigned char)p[1]) || !isdigit ((unsigned char)p[2]))
+	    return 0;
+	  break;
+	case HTTPD_FIELD_DATE:
+	  if (flen == 0)
+	    return 0;
+	  break;
+	default:
+	  break;
+	}
+      p = fend;
+    }
+  httpd_offsets[i] = p - str;
+  return p - str;
+}
+
+/* Color LINE, as _ccze_httpd_format_split() has split it. */
+static void
+_ccze_httpd_format_process (char *line)
+{
+  size_t i;
+
+  for (i = 0; i < httpd_nsteps; i++)
+    {
+      char *field = line + httpd_offsets[i];
+      char *fend = line + httpd_offsets[i + 1], save = *fend;
+      ccze_color_t color = httpd_steps[i].color;
+
+      if (httpd_steps[i].kind == HTTPD_LITERAL)
+	{
+	  /* Spaces as spaces, and the rest as they are. */
+	  while (field < fend)
+	    {
+	      char *sp = field;
+
+	      if (*field == ' ')
+		{
+		  ccze_space ();
+		  field++;
+		  continue;
+		}
+	      while (sp < fend && *sp != ' ')
+		sp++;
+	      save = *sp;
+	      *sp = '\0';
+	      ccze_addstr (CCZE_COLOR_DEFAULT, field);
+	      *sp = save;
+	      field = sp;
+	    }
+	  continue;
+	}
+
+      if (field == fend)
+	continue;
+      *fend = '\0';
+      if (httpd_steps[i].kind == HTTPD_FIELD_REQUEST)
+	{
+	  char *sp = strchr (field, ' ');
+
+	  if (sp)
+	    *sp = '\0';
+	  color = ccze_http_action (field);
+	  if (sp)
+	    *sp = ' ';
+	}
+      ccze_addstr (color, field);
+      *fend = save;
+    }
+}
+
 static void
 ccze_httpd_setup (void)
 {
   const char *error;
+  char **argv;
   int errptr;
 
   reg_httpd_access = pcre_compile
@@ -138,10 +483,42 @@ ccze_httpd_setup (void)
      0, &error, &errptr, NULL);
   hints_httpd_access = pcre_study (reg_httpd_access, 0, &error);
 
+  httpd_levels = ccze_colormap_new ("httpd_level", 0, _ccze_httpd_error);
+  ccze_colormap_add (httpd_levels, "debug", CCZE_COLOR_DEBUG);
+  ccze_colormap_add (httpd_levels, "info", CCZE_COLOR_DEBUG);
+  ccze_colormap_add (httpd_levels, "notice", CCZE_COLOR_DEBUG);
+  ccze_colormap_add (httpd_levels, "warn", CCZE_COLOR_WARNING);
+  ccze_colormap_add (httpd_levels, "error", CCZE_COLOR_ERROR);
+  ccze_colormap_add (httpd_levels, "crit", CCZE_COLOR_ERROR);
+  ccze_colormap_add (httpd_levels, "alert", CCZE_COLOR_ERROR);
+  ccze_colormap_add (httpd_levels, "emerg", CCZE_COLOR_ERROR);
+
   reg_httpd_error = pcre_compile
     ("^(\\[\\w{3}\\s\\w{3}\\s{1,2}\\d{1,2}\\s\\d{2}:\\d{2}:\\d{2}\\s"
      "\\d{4}\\])\\s(\\[\\w*\\])\\s(.*)$", 0, &error, &errptr, NULL);
   hints_httpd_error = pcre_study (reg_httpd_error, 0, &error);
+
+  argv = ccze_plugin_argv_get (ccze_plugin_name_get ());
+  if (argv && argv[1])
+    {
+      /* The arguments were split at whitespace: put them together. */
+      size_t len = 0;
+      char *format;
+      int i;
+
+      for (i = 1; argv[i]; i++)
+	len += strlen (argv[i]) + 1;
+      format = (char *)ccze_malloc (len);
+      format[0] = '\0';
+      for (i = 1; argv[i]; i++)
+	{
+	  if (i > 1)
+	    strcat (format, " ");
+	  strcat (format, argv[i]);
+	}
+      _ccze_httpd_format_compile (format);
+      free (format);
+    }
 }
 
 static void
@@ -151,12 +528,45 @@ ccze_httpd_shutdown (void)
   free (hints_httpd_access);
   free (reg_httpd_error);
   free (hints_httpd_error);
+
+  while (httpd_nsteps > 0)
+    free (httpd_steps[--httpd_nsteps].lit);
+  free (httpd_steps);
+  free (httpd_offsets);
+  free (httpd_line);
+  httpd_steps = NULL;
+  httpd_offsets = NULL;
+  httpd_line = NULL;
+  httpd_line_alloc = 0;
 }
 
 static int
 ccze_httpd_handle (const char *str, size_t length, char **rest)
 {
   int match, offsets[99];
+  size_t len;
+
+  if (httpd_nsteps && (len = _ccze_httpd_format_split (str, length)) > 0)
+    {
+      if (length + 1 > httpd_line_alloc)
+	{
+	  httpd_line_alloc = length + 1;
+	  httpd_line = (char *)ccze_realloc (httpd_line, httpd_line_alloc);
+	}
+      memcpy (httpd_line, str, length);
+      httpd_line[length] = '\0';
+      _ccze_httpd_format_process (httpd_line);
+
+      /* Whatever the format does not cover is left to the rest. */
+      if (len < length)
+	*rest = strdup (httpd_line + len);
+      else
+	{
+	  *rest = NULL;
+	  ccze_newline ();
+	}
+      return 1;
+    }
 
   if ((match = pcre_exec (reg_httpd_access, hints_httpd_access,
 			  str, length, 0, 0, offsets, 99)) >= 0)
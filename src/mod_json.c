@@ -0,0 +1,513 @@
+/* -*- mode: c; c-file-style: "gnu" -*-
+ * mod_json.c -- JSON lines and logfmt colorizer for CCZE
+ * Copyright (C) 2003 Gergely Nagy <algernon@bonehunter.rulez.org>
+ *
+ * This file is part of ccze.
+ *
+ * ccze is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * ccze is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+
+#include <ccze.h>
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+
+static void ccze_json_setup (void);
+static void ccze_json_shutdown (void);
+static int ccze_json_handle (const char *str, size_t length, char **rest);
+
+/* Lines that are a JSON object, or logfmt key=value pairs. Nothing is
+   built from them: the line is scanned once to see if it is one of
+   these, and once more to color it. The bulk of a JSON line is in its
+   strings, which are skipped with strcspn(), that the C library does
+   many bytes at a time.
+
+   Values are colored by their type - numbers, strings, and true,
+   false and null - except for those of the keys below, which are
+   colored by what they mean. */
+typedef enum
+{
+  JSON_KEY_NONE,
+  JSON_KEY_TIME,
+  JSON_KEY_LEVEL,
+  JSON_KEY_MSG,
+  JSON_KEY_HOST,
+  JSON_KEY_PROC,
+  JSON_KEY_PID,
+  JSON_KEY_ERR
+} json_key_t;
+
+static const struct
+{
+  const char *name;
+  json_key_t key;
+} json_keys[] = {
+  {"ts", JSON_KEY_TIME}, {"time", JSON_KEY_TIME},
+  {"timestamp", JSON_KEY_TIME}, {"@timestamp", JSON_KEY_TIME},
+  {"level", JSON_KEY_LEVEL}, {"lvl", JSON_KEY_LEVEL},
+  {"severity", JSON_KEY_LEVEL}, {"msg", JSON_KEY_MSG},
+  {"message", JSON_KEY_MSG}, {"host", JSON_KEY_HOST},
+  {"hostname", JSON_KEY_HOST}, {"app", JSON_KEY_PROC},
+  {"service", JSON_KEY_PROC}, {"logger", JSON_KEY_PROC},
+  {"pid", JSON_KEY_PID}, {"err", JSON_KEY_ERR}, {"error", JSON_KEY_ERR}
+};
+
+static const struct
+{
+  const char *name;
+  ccze_color_t col;
+} json_levels[] = {
+  {"emerg", CCZE_COLOR_ERROR}, {"alert", CCZE_COLOR_ERROR},
+  {"crit", CCZE_COLOR_ERROR}, {"critical", CCZE_COLOR_ERROR},
+  {"fatal", CCZE_COLOR_ERROR}, {"panic", CCZE_COLOR_ERROR},
+  {"err", CCZE_COLOR_ERROR}, {"error", CCZE_COLOR_ERROR},
+  {"warn", CCZE_COLOR_WARNING}, {"warning", CCZE_COLOR_WARNING},
+  {"notice", CCZE_COLOR_GOODWORD}, {"info", CCZE_COLOR_GOODWORD},
+  {"debug", CCZE_COLOR_DEBUG}, {"trace", CCZE_COLOR_DEBUG}
+};
+
+/* Objects nested deeper than this are not taken for a log line. */
+#define JSON_MAX_DEPTH 64
+
+#define JSON_SPACE(c) ((c) == ' ' || (c) == '\t' || (c) == '\r' || \
+		       (c) == '\n')
+#define JSON_DIGIT(c) ((c) >= '0' && (c) <= '9')
+
+typedef struct
+{
+  char *p;
+  int emit;
+  int depth;
+} json_scan_t;
+
+static char *json_line;
+static size_t json_line_alloc;
+
+/* Add the LEN bytes at STR, which need not be NUL-terminated. */
+static void
+_ccze_json_add (ccze_color_t col, char *str, size_t len)
+{
+  char save = str[len];
+
+  str[len] = '\0';
+  ccze_addstr (col, str);
+  str[len] = save;
+}
+
+static json_key_t
+_ccze_json_key (const char *name, size_t len)
+{
+  size_t i;
+
+  for (i = 0; i < sizeof (json_keys) / sizeof (json_keys[0]); i++)
+    if (!strncasecmp (json_keys[i].name, name, len) &&
+	json_keys[i].name[len] == '\0')
+      return json_keys[i].key;
+  return JSON_KEY_NONE;
+}
+
+static ccze_color_t
+_ccze_json_level (const char *name, size_t len)
+{
+  size_t i;
+
+  for (i = 0; i < sizeof (json_levels) / sizeof (json_levels[0]); i++)
+    if (!strncasecmp (json_levels[i].name, name, len) &&
+	json_levels[i].name[len] == '\0')
+      return json_levels[i].col;
+  return CCZE_COLOR_KEYWORD;
+}
+
+/* The color of a string value of KEY. */
+static ccze_color_t
+_ccze_json_string_color (json_key_t key, const char *str, size_t len)
+{
+  switch (key)
+    {
+    case JSON_KEY_TIME:
+      return CCZE_COLOR_DATE;
+    case JSON_KEY_LEVEL:
+      return _ccze_json_level (str, len);
+    case JSON_KEY_MSG:
+      return CCZE_COLOR_SUBJECT;
+    case JSON_KEY_HOST:
+      return CCZE_COLOR_HOST;
+    case JSON_KEY_PROC:
+      return CCZE_COLOR_PROC;
+    case JSON_KEY_PID:
+      return CCZE_COLOR_PID;
+    case JSON_KEY_ERR:
+      return CCZE_COLOR_ERROR;
+    default:
+      return CCZE_COLOR_DEFAULT;
+    }
+}
+
+/* The color of a number value of KEY. */
+static ccze_color_t
+_ccze_json_number_color (json_key_t key)
+{
+  switch (key)
+    {
+    case JSON_KEY_TIME:
+      return CCZE_COLOR_DATE;
+    case JSON_KEY_PID:
+      return CCZE_COLOR_PID;
+    default:
+      return CCZE_COLOR_NUMBERS;
+    }
+}
+
+/* The length of the JSON number at STR, or 0. */
+static size_t
+_ccze_json_number (const char *str)
+{
+  const char *p = str;
+
+  if (*p == '-')
+    p++;
+  if (!JSON_DIGIT (*p))
+    return 0;
+  while (JSON_DIGIT (*p))
+    p++;
+  if (*p == '.')
+    {
+      if (!JSON_DIGIT (p[1]))
+	return 0;
+      for (p++; JSON_DIGIT (*p); p++)
+	;
+    }
+  if (*p == 'e' || *p == 'E')
+    {
+      p++;
+      if (*p == '+' || *p == '-')
+	p++;
+      if (!JSON_DIGIT (*p))
+	return 0;
+      while (JSON_DIGIT (*p))
+	p++;
+    }
+  return p - str;
+}
+
+/* The length of true, false or null at STR, or 0. */
+static size_t
+_ccze_json_literal (const char *str)
+{
+  if (!strncmp (str, "true", 4) || !strncmp (str, "null", 4))
+    return 4;
+  if (!strncmp (str, "false", 5))
+    return 5;
+  return 0;
+}
+
+static void
+_ccze_json_space (json_scan_t *s)
+{
+  char *start = s->p;
+
+  while (JSON_SPACE (*s->p))
+    s->p++;
+  if (s->emit && s->p > start)
+    _ccze_json_add (CCZE_COLOR_DEFAULT, start, s->p - start);
+}
+
+static void
+_ccze_json_punct (json_scan_t *s)
+{
+  if (s->emit)
+    _ccze_json_add (CCZE_COLOR_DEFAULT, s->p, 1);
+  s->p++;
+}
+
+/* Find the end of the string at S->p. Its contents are stored in
+   *STR and *LEN. */
+static int
+_ccze_json_string_end (json_scan_t *s, char **str, size_t *len)
+{
+  char *q = s->p + 1;
+
+  for (;;)
+    {
+      q += strcspn (q, "\"\\");
+      if (*q == '"')
+	break;
+      if (*q == '\0' || q[1] == '\0')
+	return -1;
+      q += 2;
+    }
+  *str = s->p + 1;
+  *len = q - s->p - 1;
+  return 0;
+}
+
+static void
+_ccze_json_quoted (json_scan_t *s, ccze_color_t col, char *str, size_t len)
+{
+  if (s->emit)
+    {
+      _ccze_json_add (CCZE_COLOR_DEFAULT, s->p, 1);
+      _ccze_json_add (col, str, len);
+      _ccze_json_add (CCZE_COLOR_DEFAULT, str + len, 1);
+    }
+  s->p = str + len + 1;
+}
+
+static int _ccze_json_value (json_scan_t *s, json_key_t key);
+
+static int
+_ccze_json_object (json_scan_t *s)
+{
+  char *name;
+  size_t len;
+
+  if (++s->depth > JSON_MAX_DEPTH)
+    return -1;
+  _ccze_json_punct (s);
+  _ccze_json_space (s);
+  if (*s->p == '}')
+    {
+      _ccze_json_punct (s);
+      s->depth--;
+      return 0;
+    }
+
+  for (;;)
+    {
+      if (*s->p != '"' || _ccze_json_string_end (s, &name, &len))
+	return -1;
+      _ccze_json_quoted (s, CCZE_COLOR_FIELD, name, len);
+      _ccze_json_space (s);
+      if (*s->p != ':')
+	return -1;
+      _ccze_json_punct (s);
+      _ccze_json_space (s);
+      if (_ccze_json_value (s, _ccze_json_key (name, len)))
+	return -1;
+      _ccze_json_space (s);
+      if (*s->p == '}')
+	break;
+      if (*s->p != ',')
+	return -1;
+      _ccze_json_punct (s);
+      _ccze_json_space (s);
+    }
+  _ccze_json_punct (s);
+  s->depth--;
+  return 0;
+}
+
+static int
+_ccze_json_array (json_scan_t *s)
+{
+  if (++s->depth > JSON_MAX_DEPTH)
+    return -1;
+  _ccze_json_punct (s);
+  _ccze_json_space (s);
+  if (*s->p != ']')
+    for (;;)
+      {
+	if (_ccze_json_value (s, JSON_KEY_NONE))
+	  return -1;
+	_ccze_json_space (s);
+	if (*s->p == ']')
+	  break;
+	if (*s->p != ',')
+	  return -1;
+	_ccze_json_punct (s);
+	_ccze_json_space (s);
+      }
+  _ccze_json_punct (s);
+  s->depth--;
+  return 0;
+}
+
+/* The value at S->p, of KEY. */
+static int
+_ccze_json_value (json_scan_t *s, json_key_t key)
+{
+  char *str;
+  size_t len;
+
+  switch (*s->p)
+    {
+    case '{':
+      return _ccze_json_object (s);
+    case '[':
+      return _ccze_json_array (s);
+    case '"':
+      if (_ccze_json_string_end (s, &str, &len))
+	return -1;
+      _ccze_json_quoted (s, _ccze_json_string_color (key, str, len),
+			 str, len);
+      return 0;
+    default:
+      if ((len = _ccze_json_number (s->p)))
+	{
+	  if (s->emit)
+	    _ccze_json_add (_ccze_json_number_color (key), s->p, len);
+	}
+      else if ((len = _ccze_json_literal (s->p)))
+	{
+	  if (s->emit)
+	    _ccze_json_add (CCZE_COLOR_KEYWORD, s->p, len);
+	}
+      else
+	return -1;
+      s->p += len;
+      return 0;
+    }
+}
+
+static int
+_ccze_json_scan (char *line, int emit)
+{
+  json_scan_t s;
+
+  s.p = line;
+  s.emit = emit;
+  s.depth = 0;
+
+  _ccze_json_space (&s);
+  if (*s.p != '{' || _ccze_json_object (&s))
+    return -1;
+  _ccze_json_space (&s);
+  return (*s.p) ? -1 : 0;
+}
+
+/* Whether STR is a logfmt key. */
+static int
+_ccze_json_logfmt_key (const char *str)
+{
+  if (!((*str >= 'a' && *str <= 'z') || (*str >= 'A' && *str <= 'Z') ||
+	*str == '_' || *str == '@'))
+    return 0;
+  return (strspn (str, "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ"
+		  "0123456789_.-/@") == strlen (str));
+}
+
+/* The pair in KV: the keys above are colored by what they mean, the
+   rest the same as in any other key=value list. */
+static void
+_ccze_json_logfmt_pair (const ccze_kv_t *kv)
+{
+  json_key_t key = _ccze_json_key (kv->key, strlen (kv->key));
+  size_t len;
+  ccze_color_t col;
+
+  if (key == JSON_KEY_NONE || !kv->value)
+    {
+      ccze_kv_add (kv, 1);
+      return;
+    }
+
+  ccze_addstr (CCZE_COLOR_FIELD, kv->key);
+  ccze_addstr (CCZE_COLOR_DEFAULT, "=");
+  len = strlen (kv->value);
+  if (!kv->quoted && len && _ccze_json_number (kv->value) == len)
+    col = _ccze_json_number_color (key);
+  else if (!kv->quoted && len && _ccze_json_literal (kv->value) == len)
+    col = CCZE_COLOR_KEYWORD;
+  else
+    col = _ccze_json_string_color (key, kv->value, len);
+
+  if (kv->quoted)
+    ccze_addstr (CCZE_COLOR_DEFAULT, "\"");
+  ccze_addstr (col, kv->value);
+  if (kv->quoted)
+    ccze_addstr (CCZE_COLOR_DEFAULT, "\"");
+}
+
+/* A logfmt line: at least two key=value pairs, separated by spaces,
+   the first word being one of them, and every other one a key. */
+static int
+_ccze_json_logfmt (char *line, int emit)
+{
+  ccze_kv_t kv;
+  char *p = line;
+  int pairs = 0, first = 1;
+
+  do
+    {
+      p = ccze_kv_next (p, ' ', &kv);
+      if (first && !emit && (!kv.value || !*kv.key))
+	return -1;
+      first = 0;
+
+      if (!emit)
+	{
+	  if (!*kv.key && !kv.value)
+	    continue;
+	  if (!_ccze_json_logfmt_key (kv.key) ||
+	      (kv.value && !kv.quoted && strchr (kv.value, '"')))
+	    return -1;
+	  pairs += (kv.value != NULL);
+	  continue;
+	}
+
+      _ccze_json_logfmt_pair (&kv);
+      if (p)
+	ccze_space ();
+    } while (p);
+
+  return (emit || pairs >= 2) ? 0 : -1;
+}
+
+static void
+ccze_json_setup (void)
+{
+}
+
+static void
+ccze_json_shutdown (void)
+{
+  free (json_line);
+  json_line = NULL;
+  json_line_alloc = 0;
+}
+
+static int
+ccze_json_handle (const char *str, size_t length, char **rest)
+{
+  int json;
+
+  if (length + 1 > json_line_alloc)
+    {
+      json_line_alloc = length + 1;
+      json_line = (char *)ccze_realloc (json_line, json_line_alloc);
+    }
+  memcpy (json_line, str, length);
+  json_line[length] = '\0';
+
+  json = (json_line[strspn (json_line, " \t")] == '{');
+  if ((json) ? _ccze_json_scan (json_line, 0) :
+      _ccze_json_logfmt (json_line, 0))
+    return 0;
+
+  /* Scanning it for logfmt cut the line up. */
+  if (!json)
+    memcpy (json_line, str, length);
+  if (json)
+    _ccze_json_scan (json_line, 1);
+  else
+    _ccze_json_logfmt (json_line, 1);
+  ccze_newline ();
+
+  *rest = NULL;
+  return 1;
+}
+
+CCZE_DEFINE_PLUGIN (json, FULL, "Coloriser for JSON lines and logfmt logs.");
@@ -56,9 +56,12 @@ ccze_php_setup (void)
   const char *error;
   int errptr;
 
-  reg_php = pcre_compile ("^(\\[\\d+-...-\\d+ \\d+:\\d+:\\d+\\]) PHP (.*)$",
-			  0, &error, &errptr, NULL);
+  reg_php = pcre_compile ("^(\\[\\d+-...-\\d+ \\d+:\\d+:\\d+(?: \\S+)?\\]) "
+			  "PHP (.*)$", 0, &error, &errptr, NULL);
   hints_php = pcre_study (reg_php, 0, &error);
+
+  /* The stack trace after an uncaught exception. */
+  ccze_plugin_continuation ("^(Stack trace:|#\\d+ |  thrown in )");
 }
 
 static void
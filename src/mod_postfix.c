@@ -31,53 +31,37 @@ static int ccze_postfix_handle (const char *str, size_t length, char **rest);
 
 static pcre *reg_postfix;
 
-static int
-_ccze_postfix_process_one (const char *s, char **rest)
-{
-  char *field, *value;
-  size_t i;
-  
-  if (!strchr (s, '='))
-    return 1;
-
-  field = strndup (s, strchr (s, '=') - s);
-  i = strlen (s);
-  i -= strlen (field) + 1;
-  value = strndup (&s[strlen (field) + 1], i);
-  
-  ccze_addstr (CCZE_COLOR_FIELD, field);
-  ccze_addstr (CCZE_COLOR_DEFAULT, "=");
-  ccze_wordcolor_process_one (value, 1);
-
-  return 0;
-}
-
 static char *
 ccze_postfix_process (const char *str, int *offsets, int match)
 {
-  char *spoolid, *s, *rest, *tmp;
-  int r;
+  char *spoolid, *s, *p;
+  ccze_kv_t kv;
   
   pcre_get_substring (str, offsets, match, 1, (const char **)&spoolid);
   pcre_get_substring (str, offsets, match, 2, (const char **)&s);
-  pcre_get_substring (str, offsets, match, 4, (const char **)&rest);
 
   ccze_addstr (CCZE_COLOR_UNIQN, spoolid);
   ccze_addstr (CCZE_COLOR_DEFAULT, ": ");
 
-  tmp = ccze_strbrk (s, ',');
-  
+  /* The pairs are separated by commas; the first piece that is not a
+     pair ends the list. */
+  p = s;
   do
     {
-      r = _ccze_postfix_process_one (tmp, &rest);
-      if (r)
-	ccze_addstr (CCZE_COLOR_DEFAULT, tmp);
-      else
-	tmp = ccze_strbrk (NULL, ',');
-      if (tmp)
+      p = ccze_kv_next (p, ',', &kv);
+      if (!kv.value)
+	{
+	  ccze_addstr (CCZE_COLOR_DEFAULT, kv.key);
+	  ccze_addstr (CCZE_COLOR_DEFAULT, ",");
+	  break;
+	}
+      ccze_kv_add (&kv, 1);
+      if (p)
 	ccze_addstr (CCZE_COLOR_DEFAULT, ",");
-    } while (!r && (tmp != NULL));
-  
+    } while (p);
+
+  free (spoolid);
+  free (s);
   return NULL;
 }
 
@@ -29,38 +29,23 @@ static int ccze_procmail_handle (const char *str, size_t length, char **rest);
 
 static pcre *reg_procmail;
 static pcre_extra *hints_procmail;
+static ccze_colormap_t *procmail_headers;
 
 static char *
 ccze_procmail_process (const char *str, int *offsets, int match)
 {
   char *header = NULL, *value = NULL, *space1 = NULL;
   char *space2 = NULL, *extra = NULL;
-  int handled = 0;
-  ccze_color_t col = CCZE_COLOR_UNKNOWN;
+  ccze_color_t col;
 
   pcre_get_substring (str, offsets, match, 1, (const char **)&space1);
   pcre_get_substring (str, offsets, match, 2, (const char **)&header);
   pcre_get_substring (str, offsets, match, 3, (const char **)&value);
   pcre_get_substring (str, offsets, match, 4, (const char **)&space2);
   pcre_get_substring (str, offsets, match, 5, (const char **)&extra);
-  
-  if (!strcasecmp ("from", header) || !strcasecmp (">from", header))
-    {
-      col = CCZE_COLOR_EMAIL;
-      handled = 1;
-    }
-  if (!strcasecmp ("subject:", header))
-    {
-      col = CCZE_COLOR_SUBJECT;
-      handled = 1;
-    }
-  if (!strcasecmp ("folder:", header))
-    {
-      col = CCZE_COLOR_DIR;
-      handled = 1;
-    }
 
-  if (!handled)
+  col = ccze_colormap_lookup (procmail_headers, header);
+  if (col == CCZE_COLOR_UNKNOWN)
     {
       free (header);
       free (value);
@@ -102,6 +87,12 @@ ccze_procmail_setup (void)
     ("^(\\s*)(>?From|Subject:|Folder:)?\\s(\\S+)(\\s+)?(.*)", 0,
      &error, &errptr, NULL);
   hints_procmail = pcre_study (reg_procmail, 0, &error);
+
+  procmail_headers = ccze_colormap_new ("procmail", 1, NULL);
+  ccze_colormap_add (procmail_headers, "From", CCZE_COLOR_EMAIL);
+  ccze_colormap_add (procmail_headers, ">From", CCZE_COLOR_EMAIL);
+  ccze_colormap_add (procmail_headers, "Subject:", CCZE_COLOR_SUBJECT);
+  ccze_colormap_add (procmail_headers, "Folder:", CCZE_COLOR_DIR);
 }
 
 static void
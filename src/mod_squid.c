@@ -27,8 +27,10 @@ static void ccze_squid_setup (void);
 static void ccze_squid_shutdown (void);
 static int ccze_squid_handle (const char *str, size_t length, char **rest);
 
-static pcre *reg_squid_access, *reg_squid_store, *reg_squid_cache;
-static pcre_extra *hints_squid_access, *hints_squid_store, *hints_squid_cache;
+static pcre *reg_squid_cache;
+static pcre_extra *hints_squid_cache;
+static char *squid_line;
+static size_t squid_line_alloc;
 
 static ccze_color_t
 _ccze_proxy_action (const char *action)
@@ -81,74 +83,355 @@ _ccze_proxy_tag (const char *tag)
   return CCZE_COLOR_UNKNOWN;
 }
 
+/* The codes squid is known to log are looked up in color maps, with
+   the colors the functions above give them. Anything else, and the
+   codes from the rc files, are still handed to those. */
+static const char * const squid_actions[] = {
+  "TCP_HIT", "TCP_MISS", "TCP_REFRESH_HIT", "TCP_REF_FAIL_HIT",
+  "TCP_REFRESH_MISS", "TCP_REFRESH_UNMODIFIED", "TCP_REFRESH_MODIFIED",
+  "TCP_REFRESH_FAIL_OLD", "TCP_REFRESH_FAIL_ERR", "TCP_REFRESH_IGNORED",
+  "TCP_CLIENT_REFRESH", "TCP_CLIENT_REFRESH_MISS", "TCP_IMS_HIT",
+  "TCP_IMS_MISS", "TCP_INM_HIT", "TCP_SWAPFAIL", "TCP_SWAPFAIL_MISS",
+  "TCP_NEGATIVE_HIT", "TCP_MEM_HIT", "TCP_OFFLINE_HIT", "TCP_STALE_HIT",
+  "TCP_DENIED", "TCP_DENIED_REPLY", "TCP_REDIRECT", "TCP_TUNNEL",
+  "UDP_HIT", "UDP_HIT_OBJ", "UDP_MISS", "UDP_MISS_NOFETCH", "UDP_DENIED",
+  "UDP_INVALID", "NONE", "NONE_NONE", "ERR_CLIENT_ABORT",
+  "ERR_NO_CLIENTS", "ERR_READ_ERROR", "ERR_CONNECT_FAIL",
+  "ERR_READ_TIMEOUT", "ERR_LIFETIME_EXP", "ERR_NO_CLIENTS_BIG_OBJ",
+  NULL
+};
+
+static const char * const squid_hierarchies[] = {
+  "NONE", "DIRECT", "HIER_NONE", "HIER_DIRECT", "SIBLING_HIT",
+  "PARENT_HIT", "DEFAULT_PARENT", "SINGLE_PARENT", "FIRST_UP_PARENT",
+  "NO_PARENT_DIRECT", "FIRST_PARENT_MISS", "CLOSEST_PARENT_MISS",
+  "CLOSEST_PARENT", "CLOSEST_DIRECT", "NO_DIRECT_FAIL", "SOURCE_FASTEST",
+  "ROUNDROBIN_PARENT", "CACHE_DIGEST_HIT", "CD_PARENT_HIT",
+  "CD_SIBLING_HIT", "NO_CACHE_DIGEST_DIRECT", "CARP", "ANY_PARENT",
+  "USERHASH_PARENT", "SOURCEHASH_PARENT", "PINNED", "ORIGINAL_DST",
+  "TIMEOUT_DIRECT", "TIMEOUT_FIRST_PARENT_MISS",
+  "TIMEOUT_CLOSEST_PARENT_MISS", "TIMEOUT_CARP", "TIMEOUT_ANY_PARENT",
+  NULL
+};
+
+static const char * const squid_tags[] = {
+  "CREATE", "SWAPIN", "SWAPOUT", "RELEASE", "SO_FAIL", NULL
+};
+
+static ccze_colormap_t *squid_action_codes, *squid_hierarchy_codes;
+static ccze_colormap_t *squid_tag_codes;
+
+static ccze_colormap_t *
+_ccze_squid_codes (const char *name, const char * const *codes,
+		   ccze_colormap_fallback_t color)
+{
+  ccze_colormap_t *map = ccze_colormap_new (name, 0, color);
+
+  for (; *codes; codes++)
+    ccze_colormap_add (map, *codes, color (*codes));
+  return map;
+}
+
+/* The access and store logs are columns separated by whitespace, so
+   they are split by hand, taking exactly what the regexes used to:
+   \s, \d and \w below are pcre's, regardless of the locale. */
+#define SQUID_SPACE(c) ((c) == ' ' || ((c) >= '\t' && (c) <= '\r'))
+#define SQUID_DIGIT(c) ((c) >= '0' && (c) <= '9')
+#define SQUID_WORD(c) (SQUID_DIGIT (c) || (c) == '_' || \
+		       ((c) >= 'a' && (c) <= 'z') || ((c) >= 'A' && (c) <= 'Z'))
+#define SQUID_HEX(c) (SQUID_DIGIT (c) || ((c) >= 'A' && (c) <= 'F'))
+
+typedef enum
+{
+  SQUID_CLASS_SPACE,		/* \s */
+  SQUID_CLASS_NONSPACE,		/* \S */
+  SQUID_CLASS_DIGIT,		/* \d */
+  SQUID_CLASS_WORD,		/* \w */
+  SQUID_CLASS_NUMBER,		/* [\d\.] */
+  SQUID_CLASS_HEX,		/* [\dA-F] */
+  SQUID_CLASS_UNKNOWN,		/* [\d\?] */
+  SQUID_CLASS_UNKNOWN_BAR	/* [\d|\?] */
+} squid_class_t;
+
+static inline int
+_ccze_squid_class (squid_class_t class, char c)
+{
+  switch (class)
+    {
+    case SQUID_CLASS_SPACE:
+      return SQUID_SPACE (c);
+    case SQUID_CLASS_NONSPACE:
+      return !SQUID_SPACE (c);
+    case SQUID_CLASS_DIGIT:
+      return SQUID_DIGIT (c);
+    case SQUID_CLASS_WORD:
+      return SQUID_WORD (c);
+    case SQUID_CLASS_NUMBER:
+      return SQUID_DIGIT (c) || c == '.';
+    case SQUID_CLASS_HEX:
+      return SQUID_HEX (c);
+    case SQUID_CLASS_UNKNOWN:
+      return SQUID_DIGIT (c) || c == '?';
+    case SQUID_CLASS_UNKNOWN_BAR:
+      return SQUID_DIGIT (c) || c == '?' || c == '|';
+    }
+  return 0;
+}
+
+/* The splitter walks the line with a cursor, recording each field as
+   a pair of offsets, like pcre does. */
+typedef struct
+{
+  const char *str, *p, *end;
+  int *offsets;
+  int field;
+} squid_scan_t;
+
+static void
+_ccze_squid_scan_start (squid_scan_t *scan)
+{
+  scan->offsets[scan->field * 2] = scan->p - scan->str;
+}
+
+static void
+_ccze_squid_scan_end (squid_scan_t *scan)
+{
+  scan->offsets[scan->field * 2 + 1] = scan->p - scan->str;
+  scan->field++;
+}
+
+/* Skip at least MIN (and if MAX is not 0, at most MAX) characters of
+   CLASS. Returns the number skipped, or -1 if they are not there. */
+static int
+_ccze_squid_scan (squid_scan_t *scan, squid_class_t class, int min, int max)
+{
+  int n = 0;
+
+  while (scan->p + n < scan->end && _ccze_squid_class (class, scan->p[n]) &&
+	 (!max || n < max))
+    n++;
+  if (n < min)
+    return -1;
+  scan->p += n;
+  return n;
+}
+
+/* Skip the character C. */
+static int
+_ccze_squid_scan_char (squid_scan_t *scan, char c)
+{
+  if (scan->p >= scan->end || *scan->p != c)
+    return -1;
+  scan->p++;
+  return 1;
+}
+
+/* A field of CLASS: at least one of them, with an optional leading
+   '-' if SIGNED. */
+static int
+_ccze_squid_scan_field (squid_scan_t *scan, squid_class_t class, int sign)
+{
+  _ccze_squid_scan_start (scan);
+  if (sign && scan->p < scan->end && *scan->p == '-')
+    scan->p++;
+  if (_ccze_squid_scan (scan, class, 1, 0) < 0)
+    return -1;
+  _ccze_squid_scan_end (scan);
+  return 0;
+}
+
+/* The rest of the line, up to a newline, as (.*) has it. */
+static void
+_ccze_squid_scan_rest (squid_scan_t *scan)
+{
+  const char *nl = memchr (scan->p, '\n', scan->end - scan->p);
+
+  _ccze_squid_scan_start (scan);
+  scan->p = (nl) ? nl : scan->end;
+  _ccze_squid_scan_end (scan);
+}
+
+#define SQUID_SCAN(x) do { if ((x) < 0) return -1; } while (0)
+
+/* ^(\d{9,10}\.\d{3})(\s+)(\d+)\s(\S+)\s(\w+)\/(\d{3})\s(\d+)\s(\w+)\s
+   (\S+)\s(\S+)\s(\w+)\/([\d\.]+|-)\s(.*) */
+static int
+_ccze_squid_access_split (const char *str, size_t length, int *offsets)
+{
+  squid_scan_t scan = {str, str, str + length, offsets, 1};
+
+  _ccze_squid_scan_start (&scan);
+  SQUID_SCAN (_ccze_squid_scan (&scan, SQUID_CLASS_DIGIT, 9, 0));
+  if (scan.p - str > 10)
+    return -1;
+  SQUID_SCAN (_ccze_squid_scan_char (&scan, '.'));
+  SQUID_SCAN (_ccze_squid_scan (&scan, SQUID_CLASS_DIGIT, 3, 3));
+  _ccze_squid_scan_end (&scan);
+  SQUID_SCAN (_ccze_squid_scan_field (&scan, SQUID_CLASS_SPACE, 0));
+  SQUID_SCAN (_ccze_squid_scan_field (&scan, SQUID_CLASS_DIGIT, 0));
+  SQUID_SCAN (_ccze_squid_scan (&scan, SQUID_CLASS_SPACE, 1, 1));
+  SQUID_SCAN (_ccze_squid_scan_field (&scan, SQUID_CLASS_NONSPACE, 0));
+  SQUID_SCAN (_ccze_squid_scan (&scan, SQUID_CLASS_SPACE, 1, 1));
+  SQUID_SCAN (_ccze_squid_scan_field (&scan, SQUID_CLASS_WORD, 0));
+  SQUID_SCAN (_ccze_squid_scan_char (&scan, '/'));
+  _ccze_squid_scan_start (&scan);
+  SQUID_SCAN (_ccze_squid_scan (&scan, SQUID_CLASS_DIGIT, 3, 3));
+  _ccze_squid_scan_end (&scan);
+  SQUID_SCAN (_ccze_squid_scan (&scan, SQUID_CLASS_SPACE, 1, 1));
+  SQUID_SCAN (_ccze_squid_scan_field (&scan, SQUID_CLASS_DIGIT, 0));
+  SQUID_SCAN (_ccze_squid_scan (&scan, SQUID_CLASS_SPACE, 1, 1));
+  SQUID_SCAN (_ccze_squid_scan_field (&scan, SQUID_CLASS_WORD, 0));
+  SQUID_SCAN (_ccze_squid_scan (&scan, SQUID_CLASS_SPACE, 1, 1));
+  SQUID_SCAN (_ccze_squid_scan_field (&scan, SQUID_CLASS_NONSPACE, 0));
+  SQUID_SCAN (_ccze_squid_scan (&scan, SQUID_CLASS_SPACE, 1, 1));
+  SQUID_SCAN (_ccze_squid_scan_field (&scan, SQUID_CLASS_NONSPACE, 0));
+  SQUID_SCAN (_ccze_squid_scan (&scan, SQUID_CLASS_SPACE, 1, 1));
+  SQUID_SCAN (_ccze_squid_scan_field (&scan, SQUID_CLASS_WORD, 0));
+  SQUID_SCAN (_ccze_squid_scan_char (&scan, '/'));
+  if (scan.p < scan.end && *scan.p == '-')
+    {
+      _ccze_squid_scan_start (&scan);
+      scan.p++;
+      _ccze_squid_scan_end (&scan);
+    }
+  else
+    SQUID_SCAN (_ccze_squid_scan_field (&scan, SQUID_CLASS_NUMBER, 0));
+  SQUID_SCAN (_ccze_squid_scan (&scan, SQUID_CLASS_SPACE, 1, 1));
+  _ccze_squid_scan_rest (&scan);
+  return scan.field;
+}
+
+/* ^([\d\.]+)\s(\w+)\s(\-?[\dA-F]+)\s+(\S+)\s([\dA-F]+)(\s+)(\d{3}|\?)
+   (\s+)(\-?[\d\?]+)(\s+)(\-?[\d\?]+)(\s+)(\-?[\d\?]+)\s(\S+)\s
+   (\-?[\d|\?]+)\/(\-?[\d|\?]+)\s(\S+)\s(.*) */
+static int
+_ccze_squid_store_split (const char *str, size_t length, int *offsets)
+{
+  squid_scan_t scan = {str, str, str + length, offsets, 1};
+  int i;
+
+  SQUID_SCAN (_ccze_squid_scan_field (&scan, SQUID_CLASS_NUMBER, 0));
+  SQUID_SCAN (_ccze_squid_scan (&scan, SQUID_CLASS_SPACE, 1, 1));
+  SQUID_SCAN (_ccze_squid_scan_field (&scan, SQUID_CLASS_WORD, 0));
+  SQUID_SCAN (_ccze_squid_scan (&scan, SQUID_CLASS_SPACE, 1, 1));
+  SQUID_SCAN (_ccze_squid_scan_field (&scan, SQUID_CLASS_HEX, 1));
+  SQUID_SCAN (_ccze_squid_scan (&scan, SQUID_CLASS_SPACE, 1, 0));
+  SQUID_SCAN (_ccze_squid_scan_field (&scan, SQUID_CLASS_NONSPACE, 0));
+  SQUID_SCAN (_ccze_squid_scan (&scan, SQUID_CLASS_SPACE, 1, 1));
+  SQUID_SCAN (_ccze_squid_scan_field (&scan, SQUID_CLASS_HEX, 0));
+  SQUID_SCAN (_ccze_squid_scan_field (&scan, SQUID_CLASS_SPACE, 0));
+  _ccze_squid_scan_start (&scan);
+  if (_ccze_squid_scan_char (&scan, '?') < 0)
+    SQUID_SCAN (_ccze_squid_scan (&scan, SQUID_CLASS_DIGIT, 3, 3));
+  _ccze_squid_scan_end (&scan);
+  for (i = 0; i < 3; i++)
+    {
+      SQUID_SCAN (_ccze_squid_scan_field (&scan, SQUID_CLASS_SPACE, 0));
+      SQUID_SCAN (_ccze_squid_scan_field (&scan, SQUID_CLASS_UNKNOWN, 1));
+    }
+  SQUID_SCAN (_ccze_squid_scan (&scan, SQUID_CLASS_SPACE, 1, 1));
+  SQUID_SCAN (_ccze_squid_scan_field (&scan, SQUID_CLASS_NONSPACE, 0));
+  SQUID_SCAN (_ccze_squid_scan (&scan, SQUID_CLASS_SPACE, 1, 1));
+  SQUID_SCAN (_ccze_squid_scan_field (&scan, SQUID_CLASS_UNKNOWN_BAR, 1));
+  SQUID_SCAN (_ccze_squid_scan_char (&scan, '/'));
+  SQUID_SCAN (_ccze_squid_scan_field (&scan, SQUID_CLASS_UNKNOWN_BAR, 1));
+  SQUID_SCAN (_ccze_squid_scan (&scan, SQUID_CLASS_SPACE, 1, 1));
+  SQUID_SCAN (_ccze_squid_scan_field (&scan, SQUID_CLASS_NONSPACE, 0));
+  SQUID_SCAN (_ccze_squid_scan (&scan, SQUID_CLASS_SPACE, 1, 1));
+  _ccze_squid_scan_rest (&scan);
+  return scan.field;
+}
+
+/* Field I of LINE, as split into OFFSETS, NUL terminated. */
 static char *
-ccze_squid_access_log_process (const char *str, int *offsets, int match)
+_ccze_squid_field (char *line, int *offsets, int i, char *save)
 {
-  char *date, *espace, *elaps, *host, *action, *httpc, *gsize;
-  char *method, *uri, *ident, *hierar, *fhost, *ctype;
+  *save = line[offsets[i * 2 + 1]];
+  line[offsets[i * 2 + 1]] = '\0';
+  return line + offsets[i * 2];
+}
 
-  pcre_get_substring (str, offsets, match, 1, (const char **)&date);
-  pcre_get_substring (str, offsets, match, 2, (const char **)&espace);
-  pcre_get_substring (str, offsets, match, 3, (const char **)&elaps);
-  pcre_get_substring (str, offsets, match, 4, (const char **)&host);
-  pcre_get_substring (str, offsets, match, 5, (const char **)&action);
-  pcre_get_substring (str, offsets, match, 6, (const char **)&httpc);
-  pcre_get_substring (str, offsets, match, 7, (const char **)&gsize);
-  pcre_get_substring (str, offsets, match, 8, (const char **)&method);
-  pcre_get_substring (str, offsets, match, 9, (const char **)&uri);
-  pcre_get_substring (str, offsets, match, 10, (const char **)&ident);
-  pcre_get_substring (str, offsets, match, 11, (const char **)&hierar);
-  pcre_get_substring (str, offsets, match, 12, (const char **)&fhost);
-  pcre_get_substring (str, offsets, match, 13, (const char **)&ctype);
-
-  ccze_print_date (date);
-  ccze_addstr (CCZE_COLOR_DEFAULT, espace);
-  ccze_addstr (CCZE_COLOR_GETTIME, elaps);
+static void
+_ccze_squid_field_done (char *line, int *offsets, int i, char save)
+{
+  line[offsets[i * 2 + 1]] = save;
+}
+
+static void
+_ccze_squid_addfield (ccze_color_t col, char *line, int *offsets, int i)
+{
+  char save;
+
+  ccze_addstr (col, _ccze_squid_field (line, offsets, i, &save));
+  _ccze_squid_field_done (line, offsets, i, save);
+}
+
+static void
+_ccze_squid_datefield (char *line, int *offsets, int i)
+{
+  char save;
+
+  ccze_print_date (_ccze_squid_field (line, offsets, i, &save));
+  _ccze_squid_field_done (line, offsets, i, save);
+}
+
+/* Field I, colored by CODES. */
+static void
+_ccze_squid_codefield (ccze_colormap_t *codes, char *line, int *offsets,
+		       int i)
+{
+  char save, *code = _ccze_squid_field (line, offsets, i, &save);
+
+  ccze_addstr (ccze_colormap_lookup (codes, code), code);
+  _ccze_squid_field_done (line, offsets, i, save);
+}
+
+static void
+_ccze_squid_methodfield (char *line, int *offsets, int i)
+{
+  char save, *method = _ccze_squid_field (line, offsets, i, &save);
+
+  ccze_addstr (ccze_http_action (method), method);
+  _ccze_squid_field_done (line, offsets, i, save);
+}
+
+static char *
+ccze_squid_access_log_process (char *line, int *offsets)
+{
+  _ccze_squid_datefield (line, offsets, 1);
+  _ccze_squid_addfield (CCZE_COLOR_DEFAULT, line, offsets, 2);
+  _ccze_squid_addfield (CCZE_COLOR_GETTIME, line, offsets, 3);
   ccze_space ();
 
-  ccze_addstr (CCZE_COLOR_HOST, host);
+  _ccze_squid_addfield (CCZE_COLOR_HOST, line, offsets, 4);
   ccze_space ();
 
-  ccze_addstr (_ccze_proxy_action (action), action);
+  _ccze_squid_codefield (squid_action_codes, line, offsets, 5);
   ccze_addstr (CCZE_COLOR_DEFAULT, "/");
-  ccze_addstr (CCZE_COLOR_HTTPCODES, httpc);
+  _ccze_squid_addfield (CCZE_COLOR_HTTPCODES, line, offsets, 6);
   ccze_space ();
 
-  ccze_addstr (CCZE_COLOR_GETSIZE, gsize);
+  _ccze_squid_addfield (CCZE_COLOR_GETSIZE, line, offsets, 7);
   ccze_space ();
 
-  ccze_addstr (ccze_http_action (method), method);
+  _ccze_squid_methodfield (line, offsets, 8);
   ccze_space ();
 
-  ccze_addstr (CCZE_COLOR_URI, uri);
+  _ccze_squid_addfield (CCZE_COLOR_URI, line, offsets, 9);
   ccze_space ();
 
-  ccze_addstr (CCZE_COLOR_IDENT, ident);
+  _ccze_squid_addfield (CCZE_COLOR_IDENT, line, offsets, 10);
   ccze_space ();
 
-  ccze_addstr (_ccze_proxy_hierarch (hierar), hierar);
+  _ccze_squid_codefield (squid_hierarchy_codes, line, offsets, 11);
   ccze_addstr (CCZE_COLOR_DEFAULT, "/");
-  ccze_addstr (CCZE_COLOR_HOST, fhost);
+  _ccze_squid_addfield (CCZE_COLOR_HOST, line, offsets, 12);
   ccze_space ();
 
-  ccze_addstr (CCZE_COLOR_CTYPE, ctype);
+  _ccze_squid_addfield (CCZE_COLOR_CTYPE, line, offsets, 13);
 
   ccze_newline ();
 
-  free (date);
-  free (espace);
-  free (elaps);
-  free (host);
-  free (action);
-  free (httpc);
-  free (gsize);
-  free (method);
-  free (uri);
-  free (ident);
-  free (hierar);
-  free (fhost);
-  free (ctype);
-  
   return NULL;
 }
 
@@ -168,80 +451,38 @@ ccze_squid_cache_log_process (const char *str, int *offsets, int match)
 }
 
 static char *
-ccze_squid_store_log_process (const char *str, int *offsets, int match)
+ccze_squid_store_log_process (char *line, int *offsets)
 {
-  char *date, *tag, *swapnum, *swapname, *swapsum, *space1, *hcode;
-  char *hdate, *lmdate, *expire, *ctype, *size, *read, *method;
-  char *uri, *space2, *space3, *space4;
-    
-  pcre_get_substring (str, offsets, match, 1, (const char **)&date);
-  pcre_get_substring (str, offsets, match, 2, (const char **)&tag);
-  pcre_get_substring (str, offsets, match, 3, (const char **)&swapnum);
-  pcre_get_substring (str, offsets, match, 4, (const char **)&swapname);
-  pcre_get_substring (str, offsets, match, 5, (const char **)&swapsum);
-  pcre_get_substring (str, offsets, match, 6, (const char **)&space1);
-  pcre_get_substring (str, offsets, match, 7, (const char **)&hcode);
-  pcre_get_substring (str, offsets, match, 8, (const char **)&space2);
-  pcre_get_substring (str, offsets, match, 9, (const char **)&hdate);
-  pcre_get_substring (str, offsets, match, 10, (const char **)&space3);
-  pcre_get_substring (str, offsets, match, 11, (const char **)&lmdate);
-  pcre_get_substring (str, offsets, match, 12, (const char **)&space4);
-  pcre_get_substring (str, offsets, match, 13, (const char **)&expire);
-  pcre_get_substring (str, offsets, match, 14, (const char **)&ctype);
-  pcre_get_substring (str, offsets, match, 15, (const char **)&size);
-  pcre_get_substring (str, offsets, match, 16, (const char **)&read);
-  pcre_get_substring (str, offsets, match, 17, (const char **)&method);
-  pcre_get_substring (str, offsets, match, 18, (const char **)&uri);
-
-  ccze_print_date (date);
+  _ccze_squid_datefield (line, offsets, 1);
   ccze_space();
-  ccze_addstr (_ccze_proxy_tag (tag), tag);
+  _ccze_squid_codefield (squid_tag_codes, line, offsets, 2);
   ccze_space();
-  ccze_addstr (CCZE_COLOR_SWAPNUM, swapnum);
+  _ccze_squid_addfield (CCZE_COLOR_SWAPNUM, line, offsets, 3);
   ccze_space();
-  ccze_addstr (CCZE_COLOR_SWAPNUM, swapname);
+  _ccze_squid_addfield (CCZE_COLOR_SWAPNUM, line, offsets, 4);
   ccze_space();
-  ccze_addstr (CCZE_COLOR_SWAPNUM, swapsum);
-  ccze_addstr (CCZE_COLOR_DEFAULT, space1);
-  ccze_addstr (CCZE_COLOR_HTTPCODES, hcode);
-  ccze_addstr (CCZE_COLOR_DEFAULT, space2);
-  ccze_print_date (hdate);
-  ccze_addstr (CCZE_COLOR_DEFAULT, space3);
-  ccze_print_date (lmdate);
-  ccze_addstr (CCZE_COLOR_DEFAULT, space4);
-  ccze_print_date (expire);
+  _ccze_squid_addfield (CCZE_COLOR_SWAPNUM, line, offsets, 5);
+  _ccze_squid_addfield (CCZE_COLOR_DEFAULT, line, offsets, 6);
+  _ccze_squid_addfield (CCZE_COLOR_HTTPCODES, line, offsets, 7);
+  _ccze_squid_addfield (CCZE_COLOR_DEFAULT, line, offsets, 8);
+  _ccze_squid_datefield (line, offsets, 9);
+  _ccze_squid_addfield (CCZE_COLOR_DEFAULT, line, offsets, 10);
+  _ccze_squid_datefield (line, offsets, 11);
+  _ccze_squid_addfield (CCZE_COLOR_DEFAULT, line, offsets, 12);
+  _ccze_squid_datefield (line, offsets, 13);
   ccze_space();
-  ccze_addstr (CCZE_COLOR_CTYPE, ctype);
+  _ccze_squid_addfield (CCZE_COLOR_CTYPE, line, offsets, 14);
   ccze_space();
-  ccze_addstr (CCZE_COLOR_GETSIZE, size);
+  _ccze_squid_addfield (CCZE_COLOR_GETSIZE, line, offsets, 15);
   ccze_addstr (CCZE_COLOR_DEFAULT, "/");
-  ccze_addstr (CCZE_COLOR_GETSIZE, read);
+  _ccze_squid_addfield (CCZE_COLOR_GETSIZE, line, offsets, 16);
   ccze_space();
-  ccze_addstr (ccze_http_action (method), method);
+  _ccze_squid_methodfield (line, offsets, 17);
   ccze_space();
-  ccze_addstr (CCZE_COLOR_URI, uri);
+  _ccze_squid_addfield (CCZE_COLOR_URI, line, offsets, 18);
 
   ccze_newline ();
 
-  free (date);
-  free (tag);
-  free (swapnum);
-  free (swapname);
-  free (swapsum);
-  free (space1);
-  free (hcode);
-  free (hdate);
-  free (lmdate);
-  free (expire);
-  free (ctype);
-  free (size);
-  free (read);
-  free (method);
-  free (uri);
-  free (space2);
-  free (space3);
-  free (space4);
-  
   return NULL;
 }
 
@@ -251,34 +492,42 @@ ccze_squid_setup (void)
   const char *error;
   int errptr;
 
-  reg_squid_access = pcre_compile
-    ("^(\\d{9,10}\\.\\d{3})(\\s+)(\\d+)\\s(\\S+)\\s(\\w+)\\/(\\d{3})"
-     "\\s(\\d+)\\s(\\w+)\\s(\\S+)\\s(\\S+)\\s(\\w+)\\/([\\d\\.]+|-)\\s(.*)",
-     0, &error, &errptr, NULL);
-  hints_squid_access = pcre_study (reg_squid_access, 0, &error);
+  squid_action_codes = _ccze_squid_codes ("squid_action", squid_actions,
+					   _ccze_proxy_action);
+  squid_hierarchy_codes = _ccze_squid_codes ("squid_hierarchy",
+					      squid_hierarchies,
+					      _ccze_proxy_hierarch);
+  squid_tag_codes = _ccze_squid_codes ("squid_tag", squid_tags,
+				       _ccze_proxy_tag);
 
   reg_squid_cache = pcre_compile
     ("^(\\d{4}\\/\\d{2}\\/\\d{2}\\s(\\d{2}:){2}\\d{2}\\|)\\s(.*)$", 0,
      &error, &errptr, NULL);
   hints_squid_cache = pcre_study (reg_squid_cache, 0, &error);
-
-  reg_squid_store = pcre_compile
-    ("^([\\d\\.]+)\\s(\\w+)\\s(\\-?[\\dA-F]+)\\s+(\\S+)\\s([\\dA-F]+)"
-     "(\\s+)(\\d{3}|\\?)(\\s+)(\\-?[\\d\\?]+)(\\s+)(\\-?[\\d\\?]+)(\\s+)"
-     "(\\-?[\\d\\?]+)\\s(\\S+)\\s(\\-?[\\d|\\?]+)\\/(\\-?[\\d|\\?]+)\\s"
-     "(\\S+)\\s(.*)", 0, &error, &errptr, NULL);
-  hints_squid_store = pcre_study (reg_squid_store, 0, &error);
 }
 
 static void
 ccze_squid_shutdown (void)
 {
-  free (reg_squid_access);
-  free (hints_squid_access);
   free (reg_squid_cache);
   free (hints_squid_cache);
-  free (reg_squid_store);
-  free (hints_squid_store);
+  free (squid_line);
+  squid_line = NULL;
+  squid_line_alloc = 0;
+}
+
+/* A copy of STR, for the fields to be cut out of. */
+static char *
+_ccze_squid_line (const char *str, size_t length)
+{
+  if (length + 1 > squid_line_alloc)
+    {
+      squid_line_alloc = length + 1;
+      squid_line = (char *)ccze_realloc (squid_line, squid_line_alloc);
+    }
+  memcpy (squid_line, str, length);
+  squid_line[length] = '\0';
+  return squid_line;
 }
 
 static int
@@ -286,20 +535,20 @@ ccze_squid_handle (const char *str, size_t length, char **rest)
 {
   int match, offsets[99];
 
-  if ((match = pcre_exec (reg_squid_access, hints_squid_access, str,
-			  length, 0, 0, offsets, 99)) >= 0)
+  if (_ccze_squid_access_split (str, length, offsets) >= 0)
     {
-      *rest = ccze_squid_access_log_process (str, offsets, match);
+      *rest = ccze_squid_access_log_process
+	(_ccze_squid_line (str, length), offsets);
       return 1;
     }
-  
-  if ((match = pcre_exec (reg_squid_store, hints_squid_store, str,
-			  length, 0, 0, offsets, 99)) >= 0)
+
+  if (_ccze_squid_store_split (str, length, offsets) >= 0)
     {
-      *rest = ccze_squid_store_log_process (str, offsets, match);
+      *rest = ccze_squid_store_log_process
+	(_ccze_squid_line (str, length), offsets);
       return 1;
     }
-  
+
   if ((match = pcre_exec (reg_squid_cache, hints_squid_cache, str,
 			  length, 0, 0, offsets, 99)) >= 0)
     {
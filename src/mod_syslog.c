@@ -19,6 +19,7 @@
  * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
  */
 
+
 #include <ccze.h>
 #include <string.h>
 #include <stdlib.h>
@@ -29,106 +30,408 @@ static void ccze_syslog_setup (void);
 static void ccze_syslog_shutdown (void);
 static int ccze_syslog_handle (const char *str, size_t length, char **rest);
 
-static pcre *reg_syslog;
-static pcre_extra *hints_syslog;
+/* The header is scanned by hand, in a single pass over a copy of the
+   line, which gets the end of every field NUL-terminated. Three kinds
+   of headers are known:
+
+     Oct 17 12:34:56 host process[pid]: message
+     2026-10-17T12:34:56.123456+02:00 host process[pid]: message
+     <165>1 2026-10-17T12:34:56Z host app procid msgid [sd] message
+
+   the first two of which may also have the <priority> before them.
+   The first one is taken exactly the way the regular expression
+
+     ^(\S*\s{1,2}\d{1,2}\s\d\d:\d\d:\d\d)\s(\S+)\s((\S+:?)\s(.*))$
+
+   used to take it, with pcre's idea of a space and a digit. */
+#define SYSLOG_SPACE(c) ((c) == ' ' || ((c) >= '\t' && (c) <= '\r'))
+#define SYSLOG_DIGIT(c) ((c) >= '0' && (c) <= '9')
+
+typedef struct
+{
+  int pri;
+  char *version;
+  char *date, *host, *process, *pid, *msgid;
+  /* The structured data of RFC 5424 messages, and its end. */
+  char *sd, *sd_end;
+  char *msg;
+} syslog_header_t;
 
+static char *syslog_line;
+static size_t syslog_line_alloc;
+
+/* The end of the word at P. */
 static char *
-ccze_syslog_process (const char *str, int *offsets, int match)
+_ccze_syslog_word (char *p)
 {
-  char *date = NULL, *host = NULL, *send = NULL, *process = NULL;
-  char *msg = NULL, *pid = NULL, *tmp = NULL, *toret;
-  
-  pcre_get_substring (str, offsets, match, 1, (const char **)&date);
-  pcre_get_substring (str, offsets, match, 2, (const char **)&host);
-  pcre_get_substring (str, offsets, match, 3, (const char **)&send);
-  
-  if ((strstr (send, "last message repeated") && strstr (send, "times")) ||
-      (strstr (send, "-- MARK --")))
-    msg = strdup (send);
-  else
+  while (*p && !SYSLOG_SPACE (*p))
+    p++;
+  return p;
+}
+
+static int
+_ccze_syslog_digits (const char *p, int n)
+{
+  int i;
+
+  for (i = 0; i < n; i++)
+    if (!SYSLOG_DIGIT (p[i]))
+      return 0;
+  return 1;
+}
+
+/* The end of the traditional date at P, or NULL. */
+static char *
+_ccze_syslog_date (char *p)
+{
+  int n;
+
+  p = _ccze_syslog_word (p);
+  for (n = 0; n < 3 && SYSLOG_SPACE (p[n]); n++)
+    ;
+  if (n == 0 || n == 3)
+    return NULL;
+  p += n;
+  for (n = 0; n < 3 && SYSLOG_DIGIT (p[n]); n++)
+    ;
+  if (n == 0 || n == 3 || !SYSLOG_SPACE (p[n]))
+    return NULL;
+  p += n + 1;
+  if (!_ccze_syslog_digits (p, 2) || p[2] != ':' ||
+      !_ccze_syslog_digits (p + 3, 2) || p[5] != ':' ||
+      !_ccze_syslog_digits (p + 6, 2))
+    return NULL;
+  return p + 8;
+}
+
+/* The end of the RFC 3339 timestamp at P, or NULL. */
+static char *
+_ccze_syslog_rfc3339 (char *p)
+{
+  if (!_ccze_syslog_digits (p, 4) || p[4] != '-' ||
+      !_ccze_syslog_digits (p + 5, 2) || p[7] != '-' ||
+      !_ccze_syslog_digits (p + 8, 2) || (p[10] != 'T' && p[10] != 't') ||
+      !_ccze_syslog_digits (p + 11, 2) || p[13] != ':' ||
+      !_ccze_syslog_digits (p + 14, 2) || p[16] != ':' ||
+      !_ccze_syslog_digits (p + 17, 2))
+    return NULL;
+  p += 19;
+  if (*p == '.' && SYSLOG_DIGIT (p[1]))
+    for (p++; SYSLOG_DIGIT (*p); p++)
+      ;
+  if (*p == 'Z' || *p == 'z')
+    return p + 1;
+  if ((*p == '+' || *p == '-') && _ccze_syslog_digits (p + 1, 2) &&
+      p[3] == ':' && _ccze_syslog_digits (p + 4, 2))
+    return p + 6;
+  return NULL;
+}
+
+/* NUL-terminate the word at P, which must be followed by a space.
+   Returns what comes after that space, or NULL. */
+static char *
+_ccze_syslog_field (char *p)
+{
+  char *end = _ccze_syslog_word (p);
+
+  if (end == p || !SYSLOG_SPACE (*end))
+    return NULL;
+  *end = '\0';
+  return end + 1;
+}
+
+/* The "process[pid]: message" after the host. */
+static int
+_ccze_syslog_tag (syslog_header_t *h, char *p)
+{
+  char *msg, *b;
+
+  if ((strstr (p, "last message repeated") && strstr (p, "times")) ||
+      strstr (p, "-- MARK --"))
     {
-      pcre_get_substring (str, offsets, match, 4, (const char **)&process);
-      pcre_get_substring (str, offsets, match, 5, (const char **)&msg);
+      b = _ccze_syslog_word (p);
+      if (b == p || !SYSLOG_SPACE (*b))
+	return -1;
+      h->msg = p;
+      return 0;
     }
-      
-  if (process)
+
+  if (!(msg = _ccze_syslog_field (p)))
+    return -1;
+  h->process = p;
+  h->msg = msg;
+  if ((b = strchr (p, '[')))
     {
-      char *t;
-      if ((t = strchr (process, '[')))
-	{
-	  char *t2 = strchr (t, ']');
+      *b = '\0';
+      h->pid = b + 1;
+      if ((b = strchr (h->pid, ']')))
+	*b = '\0';
+    }
+  return 0;
+}
+
+/* The end of the structured data at P, or NULL. */
+static char *
+_ccze_syslog_sd_end (char *p)
+{
+  if (*p == '-')
+    return p + 1;
+  if (*p != '[')
+    return NULL;
+  while (*p == '[')
+    {
+      for (p++; *p && *p != ']'; p++)
+	if (*p == '"')
+	  {
+	    for (p++; *p && *p != '"'; p++)
+	      if (*p == '\\' && p[1])
+		p++;
+	    if (!*p)
+	      return NULL;
+	  }
+      if (!*p)
+	return NULL;
+      p++;
+    }
+  return p;
+}
+
+/* VERSION SP TIMESTAMP SP HOSTNAME SP APP-NAME SP PROCID SP MSGID SP
+   STRUCTURED-DATA [SP MSG], from RFC 5424. */
+static int
+_ccze_syslog_rfc5424 (syslog_header_t *h, char *p)
+{
+  char *end;
+
+  if (*p < '1' || *p > '9')
+    return -1;
+  h->version = p;
+  if (!(p = _ccze_syslog_field (p)) || p - h->version > 3)
+    return -1;
+
+  h->date = p;
+  if (*p == '-' && h->pri >= 0)
+    end = p + 1;
+  else if (!(end = _ccze_syslog_rfc3339 (p)))
+    return -1;
+  if (*end != ' ')
+    return -1;
+  *end = '\0';
+
+  h->host = end + 1;
+  if (!(p = _ccze_syslog_field (h->host)))
+    return -1;
+  h->process = p;
+  if (!(p = _ccze_syslog_field (p)))
+    return -1;
+  h->pid = p;
+  if (!(p = _ccze_syslog_field (p)))
+    return -1;
+  h->msgid = p;
+  if (!(p = _ccze_syslog_field (p)))
+    return -1;
 
-	  pid = strndup (&t[1], (size_t)(t2 - t - 1));
-	  tmp = strndup (process, (size_t)(t - process));
-	  free (process);
-	  process = tmp;
+  h->sd = p;
+  if (!(h->sd_end = _ccze_syslog_sd_end (p)) ||
+      (*h->sd_end && *h->sd_end != ' '))
+    return -1;
+  h->msg = (*h->sd_end) ? h->sd_end + 1 : h->sd_end;
+  if (!strncmp (h->msg, "\xef\xbb\xbf", 3))
+    h->msg += 3;
+  return 0;
+}
+
+/* Split LINE into H. Returns 1 if it looked like RFC 5424 but was not
+   - LINE is clobbered then, and is to be split again, with RFC5424
+   unset - or -1 if it is not a syslog line. */
+static int
+_ccze_syslog_split (syslog_header_t *h, char *line, int rfc5424)
+{
+  char *p = line, *end;
+  size_t len;
+
+  memset (h, 0, sizeof (*h));
+  if ((h->pri = ccze_syslog_pri (p, &len)) >= 0)
+    p += len;
+
+  if (rfc5424 && SYSLOG_DIGIT (p[0]) &&
+      (p[1] == ' ' || (SYSLOG_DIGIT (p[1]) && p[2] == ' ')))
+    return (_ccze_syslog_rfc5424 (h, p)) ? 1 : 0;
+
+  h->date = p;
+  if (!(end = _ccze_syslog_rfc3339 (p)))
+    end = _ccze_syslog_date (p);
+  if (!end || !SYSLOG_SPACE (*end))
+    return -1;
+  *end = '\0';
+
+  h->host = end + 1;
+  if (!(p = _ccze_syslog_field (h->host)))
+    return -1;
+  return _ccze_syslog_tag (h, p);
+}
+
+static void
+_ccze_syslog_pri (int pri)
+{
+  char num[12];
+  ccze_color_t col;
+
+  switch (pri & 7)
+    {
+    case 0: case 1: case 2: case 3:
+      col = CCZE_COLOR_ERROR;
+      break;
+    case 4:
+      col = CCZE_COLOR_WARNING;
+      break;
+    case 7:
+      col = CCZE_COLOR_DEBUG;
+      break;
+    default:
+      col = CCZE_COLOR_NUMBERS;
+      break;
+    }
+
+  snprintf (num, sizeof (num), "%d", pri);
+  ccze_addstr (CCZE_COLOR_PIDB, "<");
+  ccze_addstr (col, num);
+  ccze_addstr (CCZE_COLOR_PIDB, ">");
+}
+
+/* The SD-ELEMENTs, as [id name="value" ...]. */
+static void
+_ccze_syslog_sd (char *p, char *end)
+{
+  ccze_kv_t kv;
+  char *e, *q;
+
+  if (*p == '-')
+    {
+      ccze_addstr (CCZE_COLOR_DEFAULT, "-");
+      return;
+    }
+
+  while (p < end)
+    {
+      /* The closing bracket of the element, outside the quotes. */
+      for (e = p + 1; *e != ']'; e++)
+	if (*e == '"')
+	  for (e++; *e != '"'; e++)
+	    if (*e == '\\' && e[1])
+	      e++;
+      *e = '\0';
+
+      ccze_addstr (CCZE_COLOR_PIDB, "[");
+      q = p + 1 + strcspn (p + 1, " ");
+      if (*q)
+	{
+	  *q++ = '\0';
+	  ccze_addstr (CCZE_COLOR_KEYWORD, p + 1);
+	  do
+	    {
+	      ccze_space ();
+	      q = ccze_kv_next (q, ' ', &kv);
+	      ccze_kv_add (&kv, 1);
+	    } while (q);
 	}
+      else
+	ccze_addstr (CCZE_COLOR_KEYWORD, p + 1);
+      ccze_addstr (CCZE_COLOR_PIDB, "]");
+      p = e + 1;
     }
+}
+
+static char *
+ccze_syslog_process (syslog_header_t *h)
+{
+  if (h->pri >= 0)
+    _ccze_syslog_pri (h->pri);
 
-  ccze_addstr (CCZE_COLOR_DATE, date);
+  if (h->version)
+    {
+      ccze_addstr (CCZE_COLOR_VERSION, h->version);
+      ccze_space ();
+      ccze_addstr (CCZE_COLOR_DATE, h->date);
+      ccze_space ();
+      ccze_addstr (CCZE_COLOR_HOST, h->host);
+      ccze_space ();
+      ccze_addstr (CCZE_COLOR_PROC, h->process);
+      ccze_space ();
+      ccze_addstr ((strcmp (h->pid, "-")) ? CCZE_COLOR_PID :
+		   CCZE_COLOR_DEFAULT, h->pid);
+      ccze_space ();
+      ccze_addstr ((strcmp (h->msgid, "-")) ? CCZE_COLOR_UNIQN :
+		   CCZE_COLOR_DEFAULT, h->msgid);
+      ccze_space ();
+      _ccze_syslog_sd (h->sd, h->sd_end);
+      if (*h->sd_end)
+	ccze_space ();
+      return strdup (h->msg);
+    }
+
+  ccze_addstr (CCZE_COLOR_DATE, h->date);
   ccze_space ();
 
-  ccze_addstr (CCZE_COLOR_HOST, host);
+  ccze_addstr (CCZE_COLOR_HOST, h->host);
   ccze_space ();
   
-  if (process)
+  if (h->process)
     {
-      ccze_addstr (CCZE_COLOR_PROC, process);
-      if (pid)
+      ccze_addstr (CCZE_COLOR_PROC, h->process);
+      if (h->pid)
 	{
 	  ccze_addstr (CCZE_COLOR_PIDB, "[");
-	  ccze_addstr (CCZE_COLOR_PID, pid);
+	  ccze_addstr (CCZE_COLOR_PID, h->pid);
 	  ccze_addstr (CCZE_COLOR_PIDB, "]");
 	  ccze_addstr (CCZE_COLOR_PROC, ":");
 	}
       ccze_space ();
-      toret = strdup (msg);
     }
-  else
-    toret = strdup (send);
 
-  free (date);
-  free (host);
-  free (send);
-  free (process);
-  free (msg);
-  free (pid);
-
-  return toret;
+  return strdup (h->msg);
 }
 
 static void
 ccze_syslog_setup (void)
 {
-  const char *error;
-  int errptr;
-
-  reg_syslog = pcre_compile ("^(\\S*\\s{1,2}\\d{1,2}\\s\\d\\d:\\d\\d:\\d\\d)"
-			     "\\s(\\S+)\\s((\\S+:?)\\s(.*))$", 0, &error,
-			     &errptr, NULL);
-  hints_syslog = pcre_study (reg_syslog, 0, &error);
 }
 
 static void
 ccze_syslog_shutdown (void)
 {
-  free (reg_syslog);
-  free (hints_syslog);
+  free (syslog_line);
+  syslog_line = NULL;
+  syslog_line_alloc = 0;
 }
 
 static int
 ccze_syslog_handle (const char *str, size_t length, char **rest)
 {
-  int match, offsets[99];
-  
-  if ((match = pcre_exec (reg_syslog, hints_syslog, str, length,
-			  0, 0, offsets, 99)) >= 0)
+  syslog_header_t h;
+
+  if (length + 1 > syslog_line_alloc)
     {
-      *rest = ccze_syslog_process (str, offsets, match);
-      return 1;
+      syslog_line_alloc = length + 1;
+      syslog_line = (char *)ccze_realloc (syslog_line, syslog_line_alloc);
     }
-  
-  return 0;
+  memcpy (syslog_line, str, length);
+  syslog_line[length] = '\0';
+
+  switch (_ccze_syslog_split (&h, syslog_line, 1))
+    {
+    case 0:
+      break;
+    case 1:
+      memcpy (syslog_line, str, length);
+      if (!_ccze_syslog_split (&h, syslog_line, 0))
+	break;
+      /* Fall through. */
+    default:
+      return 0;
+    }
+  *rest = ccze_syslog_process (&h);
+  return 1;
 }
 
 CCZE_DEFINE_PLUGIN (syslog, FULL, "Generic syslog(8) log coloriser.");
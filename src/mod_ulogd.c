@@ -34,28 +34,15 @@ static pcre *reg_ulogd;
 static char *
 ccze_ulogd_process (const char *msg)
 {
-  char *word, *tmp, *field, *value;
-  char *msg2 = xstrdup (msg);
-  
-  word = xstrdup (ccze_strbrk (msg2, ' '));
+  char *msg2 = strdup (msg), *p = msg2;
+  ccze_kv_t kv;
+
   do
     {
-      if ((tmp = strchr (word, '=')) != NULL)
-	{
-	  field = strndup (word, tmp - word);
-	  value = strdup (tmp + 1);
-	  ccze_addstr (CCZE_COLOR_FIELD, field);
-	  ccze_addstr (CCZE_COLOR_DEFAULT, "=");
-	  ccze_wordcolor_process_one (value, 1);
-	  free (field);
-	  ccze_space ();
-	}
-      else
-	{
-	  ccze_addstr (CCZE_COLOR_FIELD, word);
-	  ccze_space ();
-	}
-    } while ((word = xstrdup (ccze_strbrk (NULL, ' '))) != NULL);
+      p = ccze_kv_next (p, ' ', &kv);
+      ccze_kv_add (&kv, 1);
+      ccze_space ();
+    } while (p);
   free (msg2);
   
   return NULL;